@@ -0,0 +1,33 @@
+#pragma once
+
+#ifndef __KERNEL__
+#error "This is a kernel header, and should not be included in userspace"
+#endif
+
+#include <stdint.h>
+
+struct thread;
+
+/// @brief Per-thread CPU accounting, kept in TSC cycles
+struct thread_accounting {
+    uint64_t user_cycles;
+    uint64_t kernel_cycles;
+    uint32_t voluntary_switches;
+    uint32_t involuntary_switches;
+    uint32_t wakeups;
+    uint64_t total_wakeup_latency;
+    uint64_t max_wakeup_latency;
+    uint32_t page_faults;
+
+    /// TSC at the last transition between user mode, kernel mode and switched out
+    uint64_t last_timestamp;
+    /// TSC when the thread became runnable, 0 once it got the CPU
+    uint64_t runnable_since;
+};
+
+__attribute__((nonnull)) void accounting_enter_kernel(struct thread *thread);
+__attribute__((nonnull)) void accounting_leave_kernel(struct thread *thread);
+__attribute__((nonnull)) void accounting_switch(struct thread *prev, struct thread *next, bool involuntary);
+__attribute__((nonnull)) void accounting_wakeup(struct thread *thread);
+__attribute__((nonnull)) void accounting_page_fault(struct thread *thread);
+__attribute__((nonnull)) uint64_t accounting_kernel_cycles(const struct thread *thread, bool running);
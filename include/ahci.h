@@ -0,0 +1,9 @@
+#pragma once
+
+#ifndef __KERNEL__
+#error "This is a kernel header, and should not be included in userspace"
+#endif
+
+struct pci_device;
+
+__attribute__((nonnull)) void ahci_init(struct pci_device *device);
@@ -6,6 +6,7 @@
 
 #include <stdint.h>
 
-int ata_read_sectors(uint32_t lba, int total, void *buffer);
-__attribute__((nonnull)) int ata_write_sectors(uint32_t lba, int total, void *buffer);
-int ata_get_sector_size(void);
+struct pci_device;
+
+void ata_init(void);
+__attribute__((nonnull)) void ata_pci_init(struct pci_device *device);
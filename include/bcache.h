@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef __KERNEL__
+#error "This is a kernel header, and should not be included in userspace"
+#endif
+
+#include <list.h>
+#include <sleeplock.h>
+#include <stdint.h>
+
+// Every disk has 512 byte sectors, the cache holds one sector per buffer
+#define BCACHE_SECTOR_SIZE 512
+
+struct disk;
+
+/// @brief A cached sector
+struct buffer {
+    const struct disk *disk;
+    uint32_t lba;
+    uint8_t *data;
+    /// The data matches the sector, or is newer when dirty
+    bool valid;
+    /// Changed in memory and not written back yet
+    bool dirty;
+    /// Read ahead of its use, nobody has asked for it yet
+    bool readahead;
+    /// Holders of the buffer, it can only be recycled when nobody holds it
+    int refcount;
+    /// Held by whoever reads or changes the data
+    struct sleeplock lock;
+    struct list_elem hash_elem;
+    /// Buffers nobody holds, least recently used first
+    struct list_elem lru_elem;
+};
+
+struct bcache_stats {
+    uint32_t hits;
+    uint32_t misses;
+    /// Dirty buffers written to their disk
+    uint32_t writebacks;
+    /// Buffers recycled for another sector
+    uint32_t evictions;
+    uint32_t dirty;
+    /// Sectors read by bcache_prefetch()
+    uint32_t readahead;
+    /// Sectors read ahead that were then asked for
+    uint32_t readahead_hits;
+};
+
+void bcache_init(void);
+__attribute__((nonnull)) struct buffer *bcache_get(const struct disk *disk, uint32_t lba);
+__attribute__((nonnull)) void bcache_release(struct buffer *buffer);
+__attribute__((nonnull)) void bcache_mark_dirty(struct buffer *buffer);
+__attribute__((nonnull)) int bcache_read(const struct disk *disk, uint32_t lba, int total, void *out);
+__attribute__((nonnull)) int bcache_prefetch(const struct disk *disk, uint32_t lba, int total);
+__attribute__((nonnull)) int bcache_write(const struct disk *disk, uint32_t lba, int total, const void *in);
+int bcache_flush(const struct disk *disk);
+__attribute__((nonnull)) void bcache_get_stats(struct bcache_stats *stats);
+void bcache_print_stats(void);
@@ -0,0 +1,67 @@
+#pragma once
+
+#ifndef __KERNEL__
+#error "This is a kernel header, and should not be included in userspace"
+#endif
+
+#include <diskstat.h>
+#include <list.h>
+#include <spinlock.h>
+#include <stdint.h>
+#include <wait_queue.h>
+
+struct disk;
+
+/// @brief A read, a write or a flush waiting in the queue of its disk
+/// @remark Requests in a queue never overlap, the buffer cache locks a sector for as long as it is being transferred
+struct block_request {
+    const struct disk *disk;
+    uint32_t lba;
+    int total;
+    void *buffer;
+    bool write;
+    /// A barrier: the requests queued before it are done and flushed to the medium before the ones queued after it
+    bool flush;
+    /// Barriers queued before this request, requests are only sorted and merged with those of the same epoch
+    uint32_t epoch;
+    /// Jiffies after which the request goes ahead of the LBA order
+    uint32_t deadline;
+    bool done;
+    int result;
+    /// Element of the queue sorted by LBA
+    struct list_elem elem;
+    /// Element of the queue in submission order
+    struct list_elem fifo_elem;
+};
+
+/// @brief Requests of a disk waiting for the driver
+struct block_queue {
+    const struct disk *disk;
+    spinlock_t lock;
+    /// Sorted by LBA, served in C-LOOK order
+    struct list sorted;
+    /// Oldest first, to find expired requests
+    struct list fifo;
+    /// A thread is sending requests to the driver
+    bool dispatching;
+    /// LBA right after the last command, where the C-LOOK sweep resumes
+    uint32_t position;
+    /// Barriers queued so far
+    uint32_t epoch;
+    /// Writes were sent since the last flush, a barrier without them needs no command
+    bool unflushed;
+    /// Holds the sectors of merged requests, BLOCK_MAX_SECTORS long
+    uint8_t *bounce;
+    /// Submitters wait here for their request, keyed by the request
+    struct wait_queue waiters;
+    struct disk_stat stats;
+};
+
+__attribute__((nonnull)) struct block_queue *block_queue_create(const struct disk *disk);
+__attribute__((nonnull)) void block_submit(struct block_request *request);
+__attribute__((nonnull)) int block_wait(struct block_request *request);
+__attribute__((nonnull)) int block_read(const struct disk *disk, uint32_t lba, int total, void *buffer);
+__attribute__((nonnull)) int block_write(const struct disk *disk, uint32_t lba, int total, void *buffer);
+__attribute__((nonnull)) int block_flush(const struct disk *disk);
+__attribute__((nonnull)) void block_get_stats(const struct disk *disk, struct disk_stat *stats);
+void block_print_stats(void);
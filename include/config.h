@@ -17,6 +17,27 @@
 
 #define MAX_PATH_LENGTH 108
 #define MAX_FILE_SYSTEMS 10
+#define MAX_DISKS 8
+// Sectors kept in the block buffer cache, 512 bytes each
+#define BCACHE_BUFFERS 1024
+#define BCACHE_HASH_BUCKETS 256
+// Clusters read ahead of a sequential reader. The window starts small and grows as what was read ahead gets used
+#define FAT16_READAHEAD_MIN 2
+#define FAT16_READAHEAD_MAX 32
+// Readahead requests queued at once, readahead is skipped while they are all in flight
+#define FAT16_READAHEAD_REQUESTS 8
+// Sectors the block layer merges into one command
+#define BLOCK_MAX_SECTORS 128
+// Milliseconds a request waits before it goes ahead of the LBA order
+#define BLOCK_READ_DEADLINE 50
+#define BLOCK_WRITE_DEADLINE 500
+// Dirty buffers written back together, the block layer sorts and merges them
+#define BCACHE_WRITEBACK_BATCH 32
+// Milliseconds between two passes of the writeback thread, which puts every dirty sector on the medium
+#define DISK_WRITEBACK_INTERVAL 5000
+// Names kept in the directory entry cache, including the ones that do not exist
+#define DCACHE_ENTRIES 256
+#define DCACHE_HASH_BUCKETS 64
 #define MAX_FILE_DESCRIPTORS 512
 
 #define MAX_FMT_STR 10'240
@@ -26,17 +47,43 @@
 // Must be aligned to 4096 bytes page size
 #define USER_STACK_SIZE (1024 * 512)
 
+// Every thread has its own kernel stack. Must be aligned to 4096 bytes page size
+#define KERNEL_STACK_SIZE (1024 * 64)
+
 #define KERNEL_CODE_SELECTOR 0x08
 #define KERNEL_DATA_SELECTOR 0x10
 #define USER_CODE_SELECTOR 0x1B
 #define USER_DATA_SELECTOR 0x23
 #define TSS_SELECTOR 0x28
+// Loaded in %gs in user mode, its base is moved to the running thread's TLS block on every switch
+#define USER_TLS_SELECTOR 0x33
 
 #define USER_STACK_TOP 0x3FF'000
 #define USER_STACK_BOTTOM (USER_STACK_TOP - USER_STACK_SIZE)
 
+// Every thread of a process gets a slot in this region: its TLS block, a read-only guard page and,
+// for all but the main thread, a user stack. Sizes must be aligned to 4096 bytes page size
+#define USER_THREADS_ADDRESS 0x800'000
+#define USER_TLS_SIZE 4096
+#define USER_THREAD_STACK_SIZE (1024 * 64)
+#define MAX_THREADS_PER_PROCESS 64
+#define FUTEX_HASH_BUCKETS 64
+
+// Count acquisitions, contention and hold times of every spinlock, ps prints them. Set to 0 to compile it out
+#define SPINLOCK_STATS 1
+
+// Move disk sectors with bus master DMA when the IDE controller supports it. Set to 0 to keep every transfer in PIO
+#define ATA_DMA 1
+
 #define MAX_PROGRAM_ALLOCATIONS 1024
-#define MAX_PROCESSES 256
+// Default soft limit, in bytes, of the memory a process allocates with malloc(). The hard limit starts unlimited
+#define PROCESS_DATA_LIMIT (32 * 1024 * 1024)
+#define MAX_PROCESSES 1024
+// Process ids go from 1 to PID_MAX - 1, 0 belongs to the kernel threads
+#define PID_MAX 32768
+#define PID_HASH_BUCKETS 256
+// Milliseconds before the pid of a reaped process can be handed out again
+#define PID_REUSE_DELAY 1000
 
 #define MAX_SYSCALLS 1024
 #define KEYBOARD_BUFFER_SIZE 1024
@@ -0,0 +1,52 @@
+#pragma once
+
+#ifndef __KERNEL__
+#error "This is a kernel header, and should not be included in userspace"
+#endif
+
+#include <list.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest name a dentry holds, longer names are never cached
+#define DCACHE_NAME_LENGTH 32
+// What a file system keeps about the inode a name resolves to, like a FAT directory entry
+#define DCACHE_DATA_SIZE 32
+
+enum DCACHE_RESULT {
+    DCACHE_MISS,
+    DCACHE_HIT,
+    /// The name is known not to exist in the directory
+    DCACHE_NEGATIVE,
+};
+
+/// @brief A name looked up in a directory, and what it resolved to
+struct dentry {
+    uint32_t device;
+    /// Identifies the directory the name is in, chosen by the file system
+    uint32_t parent;
+    char name[DCACHE_NAME_LENGTH];
+    bool negative;
+    uint8_t data[DCACHE_DATA_SIZE];
+    bool used;
+    struct list_elem hash_elem;
+    /// Least recently used first
+    struct list_elem lru_elem;
+};
+
+struct dcache_stats {
+    uint32_t hits;
+    uint32_t negative_hits;
+    uint32_t misses;
+    /// Dentries recycled for another name
+    uint32_t evictions;
+};
+
+void dcache_init(void);
+__attribute__((nonnull(3))) enum DCACHE_RESULT dcache_lookup(uint32_t device, uint32_t parent, const char *name,
+                                                             void *data, size_t size);
+__attribute__((nonnull(3))) void dcache_add(uint32_t device, uint32_t parent, const char *name, const void *data,
+                                            size_t size);
+__attribute__((nonnull)) void dcache_invalidate(uint32_t device, uint32_t parent, const char *name);
+__attribute__((nonnull)) void dcache_get_stats(struct dcache_stats *stats);
+void dcache_print_stats(void);
@@ -9,18 +9,45 @@ typedef unsigned int DISK_TYPE;
 
 #define DISK_TYPE_PHYSICAL 0
 
+struct disk;
+struct block_queue;
+
+/// @brief Implemented by every block device driver
+struct disk_operations {
+    int (*read)(const struct disk *disk, uint32_t lba, int total, void *buffer);
+    /// Done once the drive has the data, which may still be in its volatile cache
+    int (*write)(const struct disk *disk, uint32_t lba, int total, void *buffer);
+    /// Put every completed write on the medium
+    int (*flush)(const struct disk *disk);
+};
+
 struct disk {
     int id;
     DISK_TYPE type;
+    /// Driver that registered the disk
+    const char *name;
     uint16_t sector_size;
+    /// Capacity in sectors, 0 if the driver does not know it
+    uint32_t sectors;
+    const struct disk_operations *ops;
+    /// Owned by the driver
+    void *private;
+    /// Requests waiting for the driver
+    struct block_queue *queue;
     struct file_system *fs;
     void *fs_private;
 };
 
 void disk_init(void);
+void disk_mount_root(void);
+__attribute__((nonnull(1, 2))) struct disk *disk_register(const char *name, const struct disk_operations *ops,
+                                                         void *private, uint16_t sector_size, uint32_t sectors);
 struct disk *disk_get(int index);
-int disk_read_block(uint32_t lba, int total, void *buffer);
-int disk_read_sector(uint32_t sector, uint8_t *buffer);
-__attribute__((nonnull)) int disk_write_block(uint32_t lba, int total, void *buffer);
-__attribute__((nonnull)) int disk_write_sector(uint32_t sector, uint8_t *buffer);
-__attribute__((nonnull)) int disk_write_sector_offset(const void *data, int size, int offset, int sector);
+__attribute__((nonnull)) int disk_sync(const struct disk *disk);
+int disk_sync_all(void);
+__attribute__((nonnull)) int disk_read_block(const struct disk *disk, uint32_t lba, int total, void *buffer);
+__attribute__((nonnull)) int disk_read_sector(const struct disk *disk, uint32_t sector, uint8_t *buffer);
+__attribute__((nonnull)) int disk_write_block(const struct disk *disk, uint32_t lba, int total, void *buffer);
+__attribute__((nonnull)) int disk_write_sector(const struct disk *disk, uint32_t sector, uint8_t *buffer);
+__attribute__((nonnull)) int disk_write_sector_offset(const struct disk *disk, const void *data, int size, int offset,
+                                                      int sector);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+/// @brief Request queue counters of a disk, as returned by diskstat()
+struct disk_stat {
+    /// Reads and writes submitted to the queue
+    uint32_t requests;
+    /// Requests that joined a neighbour instead of becoming a command of their own
+    uint32_t merged;
+    /// Commands sent to the driver
+    uint32_t commands;
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    /// Requests sent out of LBA order because they waited past their deadline
+    uint32_t expired;
+    /// Barriers, and the cache flushes they sent to the drive
+    uint32_t barriers;
+    uint32_t flushes;
+    /// Requests waiting for the driver, and the most that ever waited at once
+    uint32_t depth;
+    uint32_t max_depth;
+};
+
+#ifndef __KERNEL__
+__attribute__((nonnull)) int diskstat(int disk, struct disk_stat *stat);
+#endif
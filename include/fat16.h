@@ -6,10 +6,46 @@
 
 #include <vfs.h>
 
+/// @brief Sequential access detection of an open file
+struct fat_readahead {
+    /// One of POSIX_FADV_NORMAL, POSIX_FADV_RANDOM or POSIX_FADV_SEQUENTIAL
+    int advice;
+    /// Where the next read starts if the file is read sequentially
+    uint32_t next_offset;
+    /// The file is read ahead up to here, in bytes
+    uint32_t end;
+    /// Clusters read ahead at once
+    uint32_t window;
+    /// Bytes read ahead that the reader then asked for, and bytes it skipped. They decide how large the window can grow
+    uint32_t hits;
+    uint32_t misses;
+};
+
+/// @brief Clusters of a file that follow each other on the disk
+struct fat_extent {
+    /// Index in the file of the first cluster of the extent
+    uint32_t file_cluster;
+    uint32_t cluster;
+    uint32_t count;
+};
+
+/// @brief The cluster chain of an open file as a list of extents, sorted by file_cluster. It is read from the FAT
+/// the first time it is needed, and dropped when the chain changes
+struct fat_extent_cache {
+    struct fat_extent *extents;
+    int count;
+    /// Clusters in the chain
+    uint32_t clusters;
+};
+
 struct fat_file_descriptor {
     struct fat_item *item;
     uint32_t position;
     struct disk *disk;
+    struct fat_readahead readahead;
+    struct fat_extent_cache extents;
+    /// The size of the file changed and its directory entry is written on close or fsync
+    bool entry_dirty;
 };
 
 
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <posix.h>
+
+/// @brief How a program is going to read a file, the kernel reads ahead accordingly
+enum POSIX_FADVISE {
+    /// Read ahead once the file is read sequentially, more as what was read ahead gets used
+    POSIX_FADV_NORMAL,
+    /// The file is read in no particular order, never read ahead
+    POSIX_FADV_RANDOM,
+    /// The file is read from start to end, read ahead as much as possible right away
+    POSIX_FADV_SEQUENTIAL,
+    /// The range is going to be read soon, start reading it now
+    POSIX_FADV_WILLNEED,
+};
+
+#ifndef __KERNEL__
+int posix_fadvise(int fd, off_t offset, off_t length, int advice);
+#endif
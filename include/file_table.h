@@ -0,0 +1,34 @@
+#pragma once
+
+#ifndef __KERNEL__
+#error "This is a kernel header, and should not be included in userspace"
+#endif
+
+#include <config.h>
+#include <stdint.h>
+
+#define FILE_TABLE_INLINE_SLOTS 32
+
+struct file;
+
+/// @brief The open files of a process, indexed by file descriptor. Forked children share the table of the parent
+/// until one of them opens or closes a file, and then get a copy of their own.
+struct file_table {
+    int refcount;
+    /// Number of descriptors the table holds before it has to grow, at most MAX_FILE_DESCRIPTORS
+    int size;
+    struct file **files;
+    /// One bit per descriptor, set when it is in use, so the lowest free descriptor is found a word at a time
+    uint32_t *used;
+    /// Small tables live in the same heap block as the table itself
+    struct file *inline_files[FILE_TABLE_INLINE_SLOTS];
+    uint32_t inline_used[FILE_TABLE_INLINE_SLOTS / 32];
+};
+
+struct file_table *file_table_create(void);
+__attribute__((nonnull)) struct file_table *file_table_share(struct file_table *table);
+struct file_table *file_table_unshare(struct file_table *table);
+__attribute__((nonnull)) int file_table_put(struct file_table *table);
+__attribute__((nonnull)) int file_table_install(struct file_table *table, struct file *file);
+__attribute__((nonnull)) struct file *file_table_get(const struct file_table *table, int fd);
+__attribute__((nonnull)) void file_table_remove(struct file_table *table, int fd);
@@ -0,0 +1,15 @@
+#pragma once
+
+#ifndef __KERNEL__
+#error "This is a kernel header, and should not be included in userspace"
+#endif
+
+/// Size of the FXSAVE/FXRSTOR area. It must be 16 byte aligned
+#define FPU_STATE_SIZE 512
+
+struct thread;
+
+void fpu_init(void);
+void fpu_switch(const struct thread *next);
+__attribute__((nonnull)) int fpu_copy_state(struct thread *dest, const struct thread *src);
+__attribute__((nonnull)) void fpu_release(struct thread *thread);
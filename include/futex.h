@@ -0,0 +1,20 @@
+#pragma once
+
+enum FUTEX_OPERATION {
+    /// Sleep while the word at the address still holds the expected value
+    FUTEX_WAIT,
+    /// Wake up to the given number of threads sleeping on the address
+    FUTEX_WAKE,
+};
+
+#ifdef __KERNEL__
+#include <stdint.h>
+
+struct thread;
+
+void futex_init(void);
+__attribute__((nonnull)) int futex_wait(struct thread *thread, void *virtual_address, int value);
+__attribute__((nonnull)) int futex_wake(struct thread *thread, void *virtual_address, int count);
+#else
+__attribute__((nonnull)) int futex(int *address, int operation, int value);
+#endif
@@ -23,6 +23,7 @@ struct gdt_ptr {
 void gdt_init(void);
 
 void gdt_set_gate(int num, uint32_t base, uint32_t limit, uint8_t access, uint8_t granularity);
+void gdt_set_tls_base(uint32_t base);
 
 // External assembly functions
 extern void gdt_flush(uint32_t);
@@ -30,3 +30,4 @@ __attribute__((nonnull)) void *heap_malloc(const struct heap *heap, size_t size)
 __attribute__((nonnull)) void *heap_realloc(const struct heap *heap, void *ptr, size_t size);
 __attribute__((nonnull)) void heap_free(const struct heap *heap, void *ptr);
 __attribute__((nonnull)) uint32_t heap_count_free_blocks(const struct heap *heap);
+__attribute__((nonnull)) uint32_t heap_number_of_blocks(const struct heap *heap, void *ptr);
@@ -55,6 +55,7 @@ typedef void (*INTERRUPT_CALLBACK_FUNCTION)(int interrupt, const struct interrup
 __attribute__((nonnull)) void register_syscall(int syscall, SYSCALL_HANDLER_FUNCTION handler);
 __attribute__((nonnull)) int idt_register_interrupt_callback(int interrupt,
                                                              INTERRUPT_CALLBACK_FUNCTION interrupt_callback);
+__attribute__((nonnull)) void idt_exception_handler(int interrupt, const struct interrupt_frame *frame);
 
 /*
  * Page fault error code
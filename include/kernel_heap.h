@@ -11,4 +11,5 @@ void *kmalloc(size_t size);
 __attribute__((nonnull)) void kfree(void *ptr);
 void *kzalloc(size_t size);
 __attribute__((nonnull)) void *krealloc(void *ptr, const size_t size);
+size_t ksize(const void *ptr);
 void kernel_heap_print_stats();
@@ -0,0 +1,12 @@
+#pragma once
+
+#ifndef __KERNEL__
+#error "This is a kernel header, and should not be included in userspace"
+#endif
+
+struct thread;
+
+void kthread_init(void);
+__attribute__((nonnull(1, 2))) struct thread *kthread_create(const char *name, void (*function)(void *arg), void *arg);
+__attribute__((nonnull)) bool kthread_is_kernel_thread(const struct thread *thread);
+[[noreturn]] void kthread_exit(void);
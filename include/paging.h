@@ -4,6 +4,7 @@
 #error "This is a kernel header, and should not be included in userspace"
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 
 // https://wiki.osdev.org/Paging
@@ -51,6 +52,7 @@ struct page_directory {
 
 struct page_directory *paging_create_directory(uint8_t flags);
 __attribute__((nonnull)) void paging_free_directory(struct page_directory *page_directory);
+__attribute__((nonnull)) size_t paging_directory_size(const struct page_directory *page_directory);
 __attribute__((nonnull)) void paging_switch_directory(const struct page_directory *directory);
 // Defined in paging.asm
 void enable_paging(void);
@@ -69,6 +71,8 @@ __attribute__((nonnull)) void *paging_align_address(void *address);
 __attribute__((nonnull)) void *paging_align_to_lower_page(void *address);
 __attribute__((nonnull)) void *paging_get_physical_address(const struct page_directory *directory,
                                                            void *virtual_address);
+extern struct page_directory *kernel_page_directory;
+
 void paging_init(void);
 void kernel_page(void);
 __attribute__((nonnull)) int paging_kernel_map(void *virtual_address, void *physical_address, int flags);
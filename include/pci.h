@@ -117,6 +117,9 @@ struct pci_header {
     uint8_t max_latency;
 } __attribute__((packed));
 
+// Matches any vendor or device in the driver table
+#define PCI_ANY_ID 0xFFFF
+
 #define PCI_BAR_MEM 0x0
 #define PCI_BAR_IO 0x1
 #define PCI_BAR_NONE 0x3
@@ -0,0 +1,11 @@
+#pragma once
+
+#ifndef __KERNEL__
+#error "This is a kernel header, and should not be included in userspace"
+#endif
+
+/// Process id of the kernel threads, it is never handed out
+#define PID_KERNEL 0
+
+int pid_alloc(void);
+void pid_free(int pid);
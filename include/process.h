@@ -1,7 +1,9 @@
 #pragma once
 
 #include <config.h>
-#include <thread.h>
+#include <list.h>
+#include <resource.h>
+#include <stdint.h>
 
 #define PROCESS_FILE_TYPE_ELF 0
 #define PROCESS_FILE_TYPE_BINARY 1
@@ -18,7 +20,10 @@ enum PROCESS_STATE {
     SLEEPING
 };
 enum PROCESS_SIGNAL { NONE, SIGKILL, SIGSTOP, SIGCONT, SIGTERM, SIGWAKEUP };
-enum SLEEP_REASON { SLEEP_REASON_NONE, SLEEP_REASON_STDIN };
+enum SLEEP_REASON { SLEEP_REASON_NONE, SLEEP_REASON_STDIN, SLEEP_REASON_JOIN, SLEEP_REASON_WAIT_QUEUE };
+
+// struct thread uses the enums above
+#include <thread.h>
 
 struct command_argument {
     char argument[512];
@@ -26,11 +31,26 @@ struct command_argument {
     char current_directory[MAX_PATH_LENGTH];
 };
 
+struct file_table;
+
 struct process_allocation {
     void *ptr;
     size_t size;
 };
 
+/// @brief Kernel heap held by a process, in bytes
+struct process_memory {
+    uint32_t stack;
+    /// The program file kept in memory
+    uint32_t image;
+    /// Allocations mapped into the process and the table that tracks them
+    uint32_t allocations;
+    uint32_t page_tables;
+    /// Kernel stacks, TLS blocks, FPU state and user stacks of the threads
+    uint32_t threads;
+    uint32_t total;
+};
+
 struct process_arguments {
     int argc;
     char **argv;
@@ -45,25 +65,44 @@ struct process {
     char file_name[MAX_PATH_LENGTH];
     struct page_directory *page_directory;
     struct process *parent;
-    // TODO: Abstract this into a separate data structure for linked lists
-    struct process *next;
-    struct list_elem elem;
-    struct process *children;
+    /// Element in the parent's children list
+    struct list_elem sibling_elem;
+    /// Element in the bucket of the pid hash
+    struct list_elem hash_elem;
+    /// Element in the parent's zombies list
+    struct list_elem zombie_elem;
+    struct list children;
+    int child_count;
+    /// Children that exited and have not been reaped yet, oldest first
+    struct list zombies;
+    /// The main thread
     struct thread *thread;
+    /// All the threads of the process, including the main thread
+    struct list threads;
+    int next_tid;
+    /// Bitmap of the used slots in the USER_THREADS_ADDRESS region
+    uint64_t thread_slots;
     enum PROCESS_STATE state;
-    enum PROCESS_SIGNAL signal;
-    enum SLEEP_REASON sleep_reason;
-    int wait_pid;
     int exit_code;
-    uint32_t sleep_until;
-    struct process_allocation allocations[MAX_PROGRAM_ALLOCATIONS];
+    /// Kernel heap blocks mapped into the process, grown on demand up to MAX_PROGRAM_ALLOCATIONS
+    struct process_allocation *allocations;
+    int allocation_count;
+    int allocation_capacity;
+    /// Heap blocks of all the allocations, charged against RLIMIT_DATA
+    uint32_t allocated_bytes;
+    struct rlimit limits[RLIMIT_COUNT];
+    /// Picked by the OOM killer while it could not be freed, or being torn down by one of its threads.
+    /// Its threads exit before going back to user mode
+    bool killed;
+    /// Thread tearing the process down in exit() or exec(), the other threads are stopped before they are freed
+    struct thread *exiting_thread;
     PROCESS_FILE_TYPE file_type;
     union {
         void *pointer;
         struct elf_file *elf_file;
     };
 
-    struct file *file_descriptors[MAX_FILE_DESCRIPTORS];
+    struct file_table *files;
     void *stack;
     uint32_t size;
 
@@ -92,11 +131,22 @@ __attribute__((nonnull)) int process_inject_arguments(struct process *process,
 __attribute__((nonnull)) int process_zombify(struct process *process);
 __attribute__((nonnull)) int process_set_current_directory(struct process *process, const char directory[static 1]);
 __attribute__((nonnull)) int process_wait_pid(struct process *process, int pid);
+__attribute__((nonnull)) int process_get_thread_count(struct process *process);
+__attribute__((nonnull)) struct thread *process_find_thread(struct process *process, int tid);
+__attribute__((nonnull)) void process_stop_threads(struct process *process);
+__attribute__((nonnull)) void process_free_threads(struct process *process);
 __attribute__((nonnull)) struct process *find_child_process_by_pid(const struct process *parent, int pid);
-__attribute__((nonnull)) struct process *find_child_process_by_state(const struct process *parent,
-                                                                     enum PROCESS_STATE state);
+__attribute__((nonnull)) struct process *find_child_process_by_state(struct process *parent, enum PROCESS_STATE state);
 __attribute__((nonnull)) int process_add_child(struct process *parent, struct process *child);
-__attribute__((nonnull)) int process_remove_child(struct process *parent, const struct process *child);
+__attribute__((nonnull)) int process_remove_child(struct process *parent, struct process *child);
+__attribute__((nonnull)) int process_get_child_count(const struct process *process);
+__attribute__((nonnull)) void process_init_lists(struct process *process);
+__attribute__((nonnull)) void process_init_limits(struct process *process);
+__attribute__((nonnull)) int process_set_limit(struct process *process, int resource, const struct rlimit *limit);
+__attribute__((nonnull)) void process_get_memory_usage(struct process *process, struct process_memory *usage);
+[[noreturn]] __attribute__((nonnull)) void process_exit(struct process *process);
+__attribute__((nonnull)) int process_kill(struct process *process, int exit_code);
+__attribute__((nonnull)) void process_release(struct process *process);
 __attribute__((nonnull)) struct process *process_clone(struct process *process);
 __attribute__((nonnull)) int process_load_data(const char file_name[static 1], struct process *process);
 __attribute__((nonnull)) int process_map_memory(struct process *process);
@@ -107,4 +157,4 @@ __attribute__((nonnull)) void process_command_argument_free(struct command_argum
 
 struct file *process_get_file_descriptor(const struct process *process, uint32_t index);
 int process_new_file_descriptor(struct process *process, struct file **desc_out);
-void process_free_file_descriptor(struct process *process, struct file *desc);
+int process_free_file_descriptor(struct process *process, struct file *desc);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+#define PROCSTAT_NAME_LENGTH 32
+
+/// @brief CPU usage of a thread, as returned by procstat(). Times are in TSC cycles
+struct thread_stat {
+    int pid;
+    int tid;
+    /// Program of the process, "kernel" for kernel threads
+    char name[PROCSTAT_NAME_LENGTH];
+    /// 'R' running or ready, 'S' sleeping, 'W' waiting for a child, 'Z' zombie
+    char state;
+    bool kernel_thread;
+
+    uint64_t user_cycles;
+    uint64_t kernel_cycles;
+    /// The thread blocked or yielded
+    uint32_t voluntary_switches;
+    /// The thread was preempted at the end of its time slice
+    uint32_t involuntary_switches;
+    /// Times the thread was made runnable after sleeping, and how long it then waited for the CPU
+    uint32_t wakeups;
+    uint64_t total_wakeup_latency;
+    uint64_t max_wakeup_latency;
+    uint32_t page_faults;
+    /// Kernel heap held by the process of the thread, in bytes
+    uint32_t memory;
+};
+
+/// @brief System wide counters returned together with the thread stats
+struct cpu_stat {
+    /// TSC when the stats were taken, differences between two samples give the elapsed cycles
+    uint64_t timestamp;
+    /// Cycles spent in the idle loop
+    uint64_t idle_cycles;
+    uint32_t uptime_ms;
+    /// Number of threads, can be larger than the number returned if the buffer was too small
+    int threads;
+};
+
+#ifndef __KERNEL__
+__attribute__((nonnull)) int procstat(struct cpu_stat *cpu, struct thread_stat *threads, int max);
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+#ifdef __KERNEL__
+#error "This is a user-space header file. It should not be included in the kernel."
+#endif
+
+#include <stddef.h>
+
+typedef int pthread_t;
+typedef struct {
+    int reserved;
+} pthread_attr_t;
+
+__attribute__((nonnull(1, 3))) int pthread_create(pthread_t *thread, const pthread_attr_t *attr,
+                                                  void *(*start_routine)(void *), void *arg);
+[[noreturn]] void pthread_exit(void *retval);
+int pthread_join(pthread_t thread, void **retval);
+pthread_t pthread_self(void);
+void *pthread_tls(void);
+size_t pthread_tls_size(void);
+
+/// 0: unlocked, 1: locked, 2: locked and some thread may be sleeping on it
+typedef struct {
+    int state;
+} pthread_mutex_t;
+
+typedef struct {
+    int reserved;
+} pthread_mutexattr_t;
+
+typedef struct {
+    /// Bumped on every signal, waiters sleep on it
+    int sequence;
+    /// Threads inside pthread_cond_wait(), signaling an empty condition does not enter the kernel
+    int waiters;
+} pthread_cond_t;
+
+typedef struct {
+    int reserved;
+} pthread_condattr_t;
+
+#define PTHREAD_MUTEX_INITIALIZER {0}
+#define PTHREAD_COND_INITIALIZER {0, 0}
+
+__attribute__((nonnull(1))) int pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr);
+__attribute__((nonnull)) int pthread_mutex_destroy(pthread_mutex_t *mutex);
+__attribute__((nonnull)) int pthread_mutex_lock(pthread_mutex_t *mutex);
+__attribute__((nonnull)) int pthread_mutex_trylock(pthread_mutex_t *mutex);
+__attribute__((nonnull)) int pthread_mutex_unlock(pthread_mutex_t *mutex);
+
+__attribute__((nonnull(1))) int pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr);
+__attribute__((nonnull)) int pthread_cond_destroy(pthread_cond_t *cond);
+__attribute__((nonnull)) int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
+__attribute__((nonnull)) int pthread_cond_signal(pthread_cond_t *cond);
+__attribute__((nonnull)) int pthread_cond_broadcast(pthread_cond_t *cond);
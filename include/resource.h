@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+#define RLIM_INFINITY 0xFFFF'FFFFU
+
+enum RLIMIT_RESOURCE {
+    /// Kernel heap held by the process: stack, program image, allocations, page tables and threads
+    RLIMIT_RSS,
+    /// Memory allocated with malloc(), including the loaded program segments
+    RLIMIT_DATA,
+    RLIMIT_COUNT,
+};
+
+/// @brief Memory limits of a process, in bytes
+struct rlimit {
+    /// The enforced limit, an allocation that would go over it fails
+    uint32_t rlim_cur;
+    /// Ceiling for rlim_cur. It can be lowered, but never raised again
+    uint32_t rlim_max;
+};
+
+#ifndef __KERNEL__
+__attribute__((nonnull)) int getrlimit(int resource, struct rlimit *limit);
+__attribute__((nonnull)) int setrlimit(int resource, const struct rlimit *limit);
+#endif
@@ -2,6 +2,7 @@
 
 #include <config.h>
 #include <process.h>
+#include <procstat.h>
 
 struct process_info {
     uint16_t pid;
@@ -10,23 +11,25 @@ struct process_info {
     enum PROCESS_STATE state;
     enum PROCESS_STATE wait_state;
     int exit_code;
+    /// Kernel heap held by the process, in bytes
+    uint32_t memory;
 };
 
 __attribute__((nonnull)) struct process *scheduler_set_process(int pid, struct process *process);
 void scheduler_switch_to_any(void);
 struct process *scheduler_get_process(int pid);
 struct process *scheduler_get_current_process(void);
-__attribute__((nonnull)) void scheduler_unlink_process(const struct process *process);
+__attribute__((nonnull)) void scheduler_unlink_process(struct process *process);
 int scheduler_get_free_pid(void);
 __attribute__((nonnull)) void scheduler_unqueue_thread(struct thread *thread);
 __attribute__((nonnull)) void scheduler_queue_thread(struct thread *thread);
-__attribute__((nonnull)) void scheduler_add_to_zombie_list(struct process *thread);
-__attribute__((nonnull)) void scheduler_remove_from_zombie_list(struct process *thread);
 void schedule(void);
+void scheduler_request_reschedule(void);
+void scheduler_preempt(void);
 void scheduler_run_first_thread(void);
 struct thread *scheduler_get_current_thread(void);
 __attribute__((nonnull)) void scheduler_save_current_thread(const struct interrupt_frame *interrupt_frame);
-__attribute__((nonnull)) int scheduler_switch_thread(struct thread *thread);
+int scheduler_switch_thread(struct thread *thread);
 
 void set_user_mode_segments(void);
 int scheduler_switch_current_thread_page(void);
@@ -36,6 +39,10 @@ void scheduler_init(void);
 void scheduler_start(void);
 
 __attribute__((nonnull)) int scheduler_get_processes(struct process_info **proc_info, int *count);
+__attribute__((nonnull(1))) void scheduler_for_each_process(void (*function)(struct process *process, void *data),
+                                                             void *data);
+__attribute__((nonnull)) int scheduler_get_thread_stats(struct cpu_stat *cpu, struct thread_stat *threads, int max);
 struct thread *scheduler_get_thread_sleeping_for_keyboard(void);
-__attribute__((nonnull)) void scheduler_remove_current_thread(const struct thread *thread);
-__attribute__((noreturn, naked)) void scheduler_idle_thread(void);
+__attribute__((nonnull)) void scheduler_remove_current_thread(struct thread *thread);
+void scheduler_finish_switch(void);
+[[noreturn]] void scheduler_idle_thread(void);
@@ -0,0 +1,18 @@
+#pragma once
+
+#ifdef __KERNEL__
+#error "This is a user-space header file. It should not be included in the kernel."
+#endif
+
+typedef struct {
+    int value;
+    /// Threads sleeping in sem_wait(), sem_post() only enters the kernel when there are any
+    int waiters;
+} sem_t;
+
+__attribute__((nonnull)) int sem_init(sem_t *sem, int pshared, unsigned int value);
+__attribute__((nonnull)) int sem_destroy(sem_t *sem);
+__attribute__((nonnull)) int sem_wait(sem_t *sem);
+__attribute__((nonnull)) int sem_trywait(sem_t *sem);
+__attribute__((nonnull)) int sem_post(sem_t *sem);
+__attribute__((nonnull)) int sem_getvalue(sem_t *sem, int *value);
@@ -18,4 +18,5 @@
 
 void init_serial(void);
 int serial_printf(const char fmt[static 1], ...);
-void serial_put(char a);
\ No newline at end of file
+void serial_put(char a);
+void serial_write(const char *str);
\ No newline at end of file
@@ -0,0 +1,3 @@
+#pragma once
+
+int serial_tty_init(void);
@@ -1,12 +1,27 @@
 #pragma once
 
+#ifndef __KERNEL__
+#error "This is a kernel header, and should not be included in userspace"
+#endif
+
 #include <spinlock.h>
 #include <stdint.h>
+#include <wait_queue.h>
+
+struct thread;
 
+/// @brief Mutex that puts waiters to sleep instead of spinning, it can be held across blocking operations
 struct sleeplock {
-    uint32_t locked;
+    bool locked;
+    /// Protects the fields of the lock
     spinlock_t lk;
+    struct wait_queue waiters;
 
-    char *name;
-    int pid;
+    const char *name;
+    struct thread *holder;
 };
+
+__attribute__((nonnull(1))) void sleeplock_init(struct sleeplock *lock, const char *name);
+__attribute__((nonnull)) void sleeplock_acquire(struct sleeplock *lock);
+__attribute__((nonnull)) void sleeplock_release(struct sleeplock *lock);
+__attribute__((nonnull)) bool sleeplock_holding(struct sleeplock *lock);
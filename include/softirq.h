@@ -0,0 +1,33 @@
+#pragma once
+
+#ifndef __KERNEL__
+#error "This is a kernel header, and should not be included in userspace"
+#endif
+
+#include <stdint.h>
+
+/// Deferred interrupt work. Lower numbers run first
+enum SOFTIRQ {
+    SOFTIRQ_TIMER,
+    SOFTIRQ_NET_RX,
+    SOFTIRQ_COUNT,
+};
+
+typedef void (*SOFTIRQ_HANDLER)(void);
+
+struct softirq_stats {
+    const char *name;
+    /// Times the softirq was raised, raising a pending softirq again is counted too
+    uint32_t raised;
+    /// Times the handler ran
+    uint32_t runs;
+    uint64_t total_cycles;
+    uint64_t max_cycles;
+};
+
+__attribute__((nonnull)) void softirq_register(enum SOFTIRQ softirq, const char *name, SOFTIRQ_HANDLER handler);
+void softirq_raise(enum SOFTIRQ softirq);
+void softirq_run(void);
+bool softirq_is_running(void);
+const struct softirq_stats *softirq_get_stats(enum SOFTIRQ softirq);
+void softirq_print_stats(void);
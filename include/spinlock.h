@@ -1,15 +1,46 @@
 #pragma once
+#include <config.h>
 #include <stdint.h>
 
-typedef uint32_t spinlock_t;
+struct spinlock_stats {
+    uint32_t acquisitions;
+    /// Acquisitions that found the lock taken and had to spin
+    uint32_t contended;
+    uint64_t spins;
+    uint64_t total_hold_cycles;
+    uint64_t max_hold_cycles;
+};
+
+/// @brief Ticket lock, waiters get the lock in the order they asked for it
+typedef struct spinlock {
+    /// Ticket handed to the next caller of spin_lock()
+    uint16_t next;
+    /// Ticket allowed to hold the lock
+    uint16_t owner;
+    const char *name;
+#if SPINLOCK_STATS
+    struct spinlock_stats stats;
+    uint64_t acquired_at;
+    bool registered;
+    /// Next lock in the list read by spinlock_print_stats()
+    struct spinlock *stats_next;
+#endif
+} spinlock_t;
+
+#define SPINLOCK_INITIALIZER(lock_name) {.name = (lock_name)}
 
 #define lock(lk, code)                                                                                                 \
     {                                                                                                                  \
-        acquire_lock(&lk);                                                                                             \
+        spin_lock(&lk);                                                                                                \
         code;                                                                                                          \
-        release_lock(&lk);                                                                                             \
+        spin_unlock(&lk);                                                                                              \
     }
 
-__attribute__((nonnull)) void spinlock_init(spinlock_t *lock);
+__attribute__((nonnull)) void spinlock_init(spinlock_t *lock, const char *name);
 __attribute__((nonnull)) void spin_lock(spinlock_t *lock);
+__attribute__((nonnull)) bool spin_trylock(spinlock_t *lock);
 __attribute__((nonnull)) void spin_unlock(spinlock_t *lock);
+__attribute__((nonnull)) bool spin_is_locked(spinlock_t *lock);
+__attribute__((nonnull)) uint32_t spin_lock_irqsave(spinlock_t *lock);
+__attribute__((nonnull)) void spin_unlock_irqrestore(spinlock_t *lock, uint32_t flags);
+void spinlock_print_stats(void);
@@ -55,6 +55,7 @@ extern FILE *stdout;
 extern FILE *stderr;
 
 int print(const char str[static 1], uint32_t size);
+void clear_screen(void);
 int mkdir(const char *path);
 DIR *opendir(const char *path);
 int getkey(void);
@@ -32,6 +32,16 @@ enum SysCalls {
     SYSCALL_YIELD,
     SYSCALL_PS,      // TODO: I should use a device file for this instead
     SYSCALL_MEMSTAT, // TODO: I should use a device file for this instead
+    SYSCALL_THREAD_CREATE,
+    SYSCALL_THREAD_EXIT,
+    SYSCALL_THREAD_JOIN,
+    SYSCALL_FUTEX,
+    SYSCALL_PROCSTAT,
+    SYSCALL_RLIMIT,
+    SYSCALL_FADVISE,
+    SYSCALL_DISKSTAT,
+    SYSCALL_SYNC,
+    SYSCALL_FSYNC,
 };
 
 #ifdef __KERNEL__
@@ -68,6 +78,16 @@ void *sys_sleep(struct interrupt_frame *frame);
 void *sys_yield(struct interrupt_frame *frame);
 void *sys_ps(struct interrupt_frame *frame);
 void *sys_memstat(struct interrupt_frame *frame);
+void *sys_thread_create(struct interrupt_frame *frame);
+[[noreturn]] void *sys_thread_exit(struct interrupt_frame *frame);
+void *sys_thread_join(struct interrupt_frame *frame);
+void *sys_futex(struct interrupt_frame *frame);
+void *sys_procstat(struct interrupt_frame *frame);
+void *sys_rlimit(struct interrupt_frame *frame);
+void *sys_fadvise(struct interrupt_frame *frame);
+void *sys_diskstat(struct interrupt_frame *frame);
+void *sys_sync(struct interrupt_frame *frame);
+void *sys_fsync(struct interrupt_frame *frame);
 
 void *get_pointer_argument(int index);
 int get_integer_argument(int index);
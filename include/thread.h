@@ -4,10 +4,12 @@
 #error "This is a kernel header, and should not be included in userspace"
 #endif
 
+#include <accounting.h>
 #include <idt.h>
 #include <list.h>
 #include <paging.h>
 #include <process.h>
+#include <wait_queue.h>
 
 #define THREAD_MAGIC 0x1eaadf71
 
@@ -29,15 +31,70 @@ struct registers {
 
 
 struct thread {
+    /// User mode state, saved every time the thread enters the kernel from user mode
     struct registers registers;
-    // struct registers kernel_state;
+    /// Bottom of the thread's kernel stack (KERNEL_STACK_SIZE bytes)
+    void *kernel_stack;
+    /// Saved kernel stack pointer while the thread is switched out
+    uint32_t kernel_esp;
     struct process *process;
-    // struct list_elem allelem;           /**< List element for all threads list. */
+    /// Thread id, unique within the process. The main thread is 0
+    int tid;
+
+    /// Scheduling state. The state of the process only tells if it is alive (RUNNING) or a ZOMBIE
+    enum PROCESS_STATE state;
+    enum PROCESS_SIGNAL signal;
+    enum SLEEP_REASON sleep_reason;
+    uint32_t sleep_until;
+    /// The child pid the thread is blocked on in waitpid(), -1 for any child
+    int wait_pid;
+
+    /// Index of the thread's slot in the USER_THREADS_ADDRESS region
+    int slot;
+    /// Physical address of the TLS block, mapped at tls_address in the process page directory
+    void *tls;
+    uint32_t tls_address;
+    /// Physical address of the user stack of a secondary thread, mapped at user_stack_address.
+    /// The main thread uses process->stack
+    void *user_stack;
+    uint32_t user_stack_address;
+
+    /// Value passed to thread_exit(), valid once the thread is a ZOMBIE
+    int exit_code;
+    /// Thread blocked in thread_join() waiting for this thread
+    struct thread *joiner;
+    /// Entry on the wait queue the thread sleeps on, if any
+    struct wait_queue_entry *wait_entry;
+    /// Sleeplocks held and disk requests in flight. The OOM killer cannot tear the thread down meanwhile
+    int uninterruptible;
+    /// FXSAVE area, allocated the first time the thread uses the FPU
+    void *fpu_state;
+    struct thread_accounting accounting;
+    /// Function run by a kernel thread, nullptr for user threads
+    void (*kernel_function)(void *arg);
+    void *kernel_argument;
+
+    /// Scheduler queue element
     struct list_elem elem;
+    /// Element of process->threads
+    struct list_elem process_elem;
     unsigned magic;
 };
 
+/// @brief Thread control block at the start of every TLS block, readable by user mode through %gs
+struct thread_control_block {
+    /// Linear address of the TLS block itself
+    uint32_t self;
+    int tid;
+};
+
 __attribute__((nonnull)) struct thread *thread_create(struct process *process);
+__attribute__((nonnull)) struct thread *thread_clone(struct process *process, const struct thread *src);
+__attribute__((nonnull)) struct thread *thread_spawn(struct process *process, uint32_t entry, uint32_t start_routine,
+                                                     uint32_t arg);
+__attribute__((nonnull)) void thread_free_user_memory(struct thread *thread);
+[[noreturn]] __attribute__((nonnull)) void thread_exit(struct thread *thread, int exit_code);
+__attribute__((nonnull)) int thread_join(struct thread *current, int tid, int *exit_code);
 __attribute__((nonnull)) int thread_free(struct thread *thread);
 __attribute__((nonnull)) void restore_general_purpose_registers(struct registers *registers);
 __attribute__((nonnull)) int copy_string_from_thread(const struct thread *thread, const void *virtual, void *physical,
@@ -48,4 +105,8 @@ __attribute__((nonnull)) int thread_page_thread(const struct thread *thread);
 __attribute__((nonnull)) void thread_save_state(struct thread *thread, const struct interrupt_frame *frame);
 __attribute__((nonnull)) void thread_copy_registers(struct thread *dest, const struct thread *src);
 __attribute__((nonnull)) void thread_switch(struct registers *registers);
+__attribute__((nonnull)) void thread_context_switch(uint32_t *old_esp, uint32_t new_esp);
+__attribute__((nonnull)) void thread_release(struct thread *thread);
+__attribute__((nonnull)) void thread_init_kernel_stack(struct thread *thread, void (*entry)(struct thread *thread));
+__attribute__((nonnull)) uint32_t thread_kernel_stack_top(const struct thread *thread);
 __attribute__((nonnull)) bool thread_is_valid(const struct thread *thread);
@@ -5,4 +5,6 @@ int close(int fd);
 __attribute__((nonnull)) int read(void *ptr, unsigned int size, unsigned int nmemb, int fd);
 int write(int fd, const char *buffer, size_t size);
 int lseek(int fd, int offset, int whence);
+int fsync(int fd);
+void sync(void);
 
@@ -36,12 +36,15 @@ struct dir_entries;
 
 typedef int (*FS_RESOLVE_FUNCTION)(struct disk *disk);
 typedef int (*FS_GET_ROOT_DIRECTORY_FUNCTION)(const struct disk *disk, struct dir_entries *directory);
+typedef int (*FS_SYNC_FUNCTION)(const struct disk *disk);
 typedef int (*FS_MKDIR_FUNCTION)(const char *path);
 
 struct file_system {
     // file_system should return zero from resolve if the disk is using its file system
     FS_RESOLVE_FUNCTION resolve;
     FS_GET_ROOT_DIRECTORY_FUNCTION get_root_directory;
+    /// Write what the file system keeps in memory to the buffer cache, before the disk is synced
+    FS_SYNC_FUNCTION sync;
     struct inode_operations *ops;
 
     char name[20];
@@ -53,6 +56,8 @@ struct file {
     enum FS_TYPE fs_type;
     enum INODE_TYPE type;
     int index;
+    /// File tables holding the file, a forked child shares the files of its parent
+    int refcount;
     off_t offset;
     uint32_t size;
     struct file_system *fs;
@@ -113,6 +118,8 @@ struct inode_operations {
     int (*stat)(void *descriptor, struct stat *stat);
     int (*close)(void *descriptor);
     int (*ioctl)(void *descriptor, int request, void *arg);
+    int (*fadvise)(void *descriptor, uint32_t offset, uint32_t length, int advice);
+    int (*fsync)(void *descriptor);
 
     int (*create_file)(struct inode *dir, const char *name, struct inode_operations *ops);
     int (*create_device)(struct inode *dir, const char *name, struct inode_operations *ops);
@@ -134,6 +141,7 @@ __attribute__((nonnull)) int vfs_write(int fd, const char *buffer, size_t size);
 int vfs_seek(int fd, int offset, enum FILE_SEEK_MODE whence);
 __attribute__((nonnull)) int vfs_stat(int fd, struct stat *stat);
 int vfs_close(int fd);
+__attribute__((nonnull)) int vfs_file_put(struct file *file);
 __attribute__((nonnull)) void vfs_insert_file_system(struct file_system *filesystem);
 __attribute__((nonnull)) struct file_system *vfs_resolve(struct disk *disk);
 int vfs_getdents(const uint32_t fd, void *buffer, int count);
@@ -142,3 +150,5 @@ int vfs_find_mount_point(const char *prefix);
 struct mount_point *vfs_get_mount_point(int index);
 int vfs_mkdir(const char *path);
 int vfs_lseek(int fd, int offset, enum FILE_SEEK_MODE whence);
+int vfs_fadvise(int fd, uint32_t offset, uint32_t length, int advice);
+int vfs_fsync(int fd);
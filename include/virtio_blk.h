@@ -0,0 +1,13 @@
+#pragma once
+
+#ifndef __KERNEL__
+#error "This is a kernel header, and should not be included in userspace"
+#endif
+
+#define VIRTIO_VEND 0x1AF4 // Vendor ID for Red Hat, Inc. virtio devices
+// Transitional block device, it still offers the legacy I/O port interface
+#define VIRTIO_BLK_DEV 0x1001
+
+struct pci_device;
+
+__attribute__((nonnull)) void virtio_blk_init(struct pci_device *device);
@@ -0,0 +1,32 @@
+#pragma once
+
+#ifndef __KERNEL__
+#error "This is a kernel header, and should not be included in userspace"
+#endif
+
+#include <list.h>
+#include <stdint.h>
+
+struct thread;
+
+/// @brief Threads blocked until some event happens. Sleeping and waking must be done with interrupts disabled
+struct wait_queue {
+    struct list waiters;
+};
+
+/// @brief A thread sleeping on a wait queue. It lives on the sleeping thread's kernel stack
+struct wait_queue_entry {
+    struct thread *thread;
+    /// Lets several kinds of waiters share one queue, only waiters with a matching key are woken
+    uintptr_t key;
+    bool woken;
+    struct list_elem elem;
+};
+
+__attribute__((nonnull)) void wait_queue_init(struct wait_queue *queue);
+__attribute__((nonnull)) void wait_queue_sleep(struct wait_queue *queue);
+__attribute__((nonnull)) void wait_queue_sleep_keyed(struct wait_queue *queue, uintptr_t key);
+__attribute__((nonnull)) int wait_queue_wake(struct wait_queue *queue, int count);
+__attribute__((nonnull)) int wait_queue_wake_keyed(struct wait_queue *queue, uintptr_t key, int count);
+__attribute__((nonnull)) void wait_queue_remove(struct thread *thread);
+__attribute__((nonnull)) bool wait_queue_empty(struct wait_queue *queue);
@@ -0,0 +1,57 @@
+#pragma once
+
+#ifndef __KERNEL__
+#error "This is a kernel header, and should not be included in userspace"
+#endif
+
+#include <list.h>
+#include <stdint.h>
+#include <wait_queue.h>
+
+#define WORKQUEUE_NAME_LENGTH 16
+
+struct work;
+typedef void (*WORK_FUNCTION)(struct work *work);
+
+/// @brief A piece of deferred work, embedded in the structure the function works on. The function runs in the
+/// worker thread with interrupts disabled, and may sleep
+struct work {
+    WORK_FUNCTION function;
+    /// The work is queued and has not started yet. Queuing pending work again is a no-op
+    bool pending;
+    /// TSC when the work was queued
+    uint64_t queued_at;
+    struct list_elem elem;
+};
+
+struct workqueue_stats {
+    uint32_t queued;
+    uint32_t executed;
+    /// Works waiting to run
+    uint32_t depth;
+    uint32_t max_depth;
+    uint64_t total_cycles;
+    uint64_t max_cycles;
+    /// Longest time between queuing a work and starting it
+    uint64_t max_latency_cycles;
+};
+
+/// @brief A list of works run one after the other by a dedicated kernel thread
+struct workqueue {
+    char name[WORKQUEUE_NAME_LENGTH];
+    struct list works;
+    /// The worker sleeps here while there is nothing to do
+    struct wait_queue idle;
+    struct thread *worker;
+    struct workqueue_stats stats;
+    /// Element of the list of all workqueues
+    struct list_elem elem;
+};
+
+extern struct workqueue *system_workqueue;
+
+void workqueue_init(void);
+__attribute__((nonnull)) void work_init(struct work *work, WORK_FUNCTION function);
+__attribute__((nonnull)) struct workqueue *workqueue_create(const char *name);
+__attribute__((nonnull)) bool workqueue_queue(struct workqueue *queue, struct work *work);
+void workqueue_print_stats(void);
@@ -80,6 +80,54 @@ static inline uint32_t read_cr2(void)
     return val;
 }
 
+// Control register flags
+#define CR0_MP 0x00000002
+#define CR0_EM 0x00000004
+#define CR0_TS 0x00000008
+#define CR0_NE 0x00000020
+#define CR4_OSFXSR 0x00000200
+#define CR4_OSXMMEXCPT 0x00000400
+
+// CPUID leaf 1 feature flags
+#define CPUID_EDX_FPU 0x00000001
+#define CPUID_EDX_FXSR 0x0100'0000
+#define CPUID_EDX_SSE 0x0200'0000
+
+static inline uint32_t read_cr0(void)
+{
+    uint32_t val;
+    asm volatile("movl %%cr0,%0" : "=r"(val));
+    return val;
+}
+
+static inline void write_cr0(uint32_t val)
+{
+    asm volatile("movl %0,%%cr0" : : "r"(val));
+}
+
+static inline uint32_t read_cr4(void)
+{
+    uint32_t val;
+    asm volatile("movl %%cr4,%0" : "=r"(val));
+    return val;
+}
+
+static inline void write_cr4(uint32_t val)
+{
+    asm volatile("movl %0,%%cr4" : : "r"(val));
+}
+
+/// @brief Clear CR0.TS, so that FPU instructions no longer trap
+static inline void clts(void)
+{
+    asm volatile("clts");
+}
+
+static inline void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
+{
+    asm volatile("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(0));
+}
+
 static inline void lcr3(uint32_t val)
 {
     asm volatile("movl %0,%%cr3" : : "r"(val));
@@ -0,0 +1,469 @@
+#include <assert.h>
+#include <bcache.h>
+#include <block.h>
+#include <config.h>
+#include <disk.h>
+#include <kernel.h>
+#include <kernel_heap.h>
+#include <memory.h>
+#include <printf.h>
+#include <serial.h>
+#include <spinlock.h>
+#include <status.h>
+#include <termcolors.h>
+#include <wait_queue.h>
+
+// Sectors read from the disk with one request when a read misses on consecutive sectors
+#define BCACHE_MAX_RUN 128
+
+static struct buffer *buffers;
+static struct list hash_table[BCACHE_HASH_BUCKETS];
+/// Buffers nobody holds, the front is recycled first
+static struct list lru;
+/// Protects the hash table, the LRU list, the reference counts and the stats
+static spinlock_t bcache_lock = SPINLOCK_INITIALIZER("bcache");
+/// Threads waiting for a buffer to be released when every buffer is held
+static struct wait_queue bcache_waiters;
+static struct bcache_stats stats;
+/// Where bcache_prefetch() reads runs of sectors before copying them into their buffers
+static uint8_t prefetch_buffer[BCACHE_MAX_RUN * BCACHE_SECTOR_SIZE];
+static struct sleeplock prefetch_lock;
+
+static uint32_t bcache_hash(const struct disk *disk, const uint32_t lba)
+{
+    return (lba + (uint32_t)disk->id * 0x9E37'79B1U) % BCACHE_HASH_BUCKETS;
+}
+
+void bcache_init()
+{
+    buffers             = kzalloc(BCACHE_BUFFERS * sizeof(struct buffer));
+    uint8_t *const data = kzalloc(BCACHE_BUFFERS * BCACHE_SECTOR_SIZE);
+
+    for (int i = 0; i < BCACHE_HASH_BUCKETS; i++) {
+        list_init(&hash_table[i]);
+    }
+    list_init(&lru);
+    wait_queue_init(&bcache_waiters);
+    sleeplock_init(&prefetch_lock, "bcache_prefetch");
+
+    for (int i = 0; i < BCACHE_BUFFERS; i++) {
+        struct buffer *buffer = &buffers[i];
+        buffer->data          = data + i * BCACHE_SECTOR_SIZE;
+        sleeplock_init(&buffer->lock, "buffer");
+        list_push_back(&lru, &buffer->lru_elem);
+    }
+}
+
+static struct buffer *bcache_find(const struct disk *disk, const uint32_t lba)
+{
+    struct list *bucket = &hash_table[bcache_hash(disk, lba)];
+    for (auto elem = list_begin(bucket); elem != list_end(bucket); elem = list_next(elem)) {
+        auto const buffer = list_entry(elem, struct buffer, hash_elem);
+        if (buffer->disk == disk && buffer->lba == lba) {
+            return buffer;
+        }
+    }
+
+    return nullptr;
+}
+
+/// @brief Write dirty buffers back to their disks. They are queued together, so the block layer can sort them and
+/// merge the ones that follow each other
+/// @warning The buffer locks must be held
+/// @return the first error, the buffers that could not be written stay dirty
+static int bcache_write_back(struct buffer **batch, const int count)
+{
+    ASSERT(count <= BCACHE_WRITEBACK_BATCH);
+    struct block_request requests[BCACHE_WRITEBACK_BATCH];
+
+    for (int i = 0; i < count; i++) {
+        requests[i] = (struct block_request){
+            .disk   = batch[i]->disk,
+            .lba    = batch[i]->lba,
+            .total  = 1,
+            .buffer = batch[i]->data,
+            .write  = true,
+        };
+        block_submit(&requests[i]);
+    }
+
+    int res = ALL_OK;
+    for (int i = 0; i < count; i++) {
+        const int written = block_wait(&requests[i]);
+        if (written != ALL_OK) {
+            warningf("Failed to write back sector %lu of disk %d\n", batch[i]->lba, batch[i]->disk->id);
+            if (res == ALL_OK) {
+                res = written;
+            }
+            continue;
+        }
+
+        spin_lock(&bcache_lock);
+        batch[i]->dirty = false;
+        stats.dirty--;
+        stats.writebacks++;
+        spin_unlock(&bcache_lock);
+    }
+
+    return res;
+}
+
+/// @brief Hold and lock the buffer of the sector, recycling the least recently used one on a miss
+/// @param prefetch the lookup reads ahead, it does not count as a hit or a miss
+/// @return the locked buffer, its data is only there if it is valid
+static struct buffer *bcache_lookup(const struct disk *disk, const uint32_t lba, const bool prefetch)
+{
+    spin_lock(&bcache_lock);
+
+    for (;;) {
+        struct buffer *buffer = bcache_find(disk, lba);
+        if (buffer) {
+            if (buffer->refcount++ == 0) {
+                list_remove(&buffer->lru_elem);
+            }
+            if (!prefetch) {
+                stats.hits++;
+            }
+            spin_unlock(&bcache_lock);
+
+            sleeplock_acquire(&buffer->lock);
+            if (!prefetch && buffer->readahead) {
+                spin_lock(&bcache_lock);
+                buffer->readahead = false;
+                stats.readahead_hits++;
+                spin_unlock(&bcache_lock);
+            }
+            return buffer;
+        }
+
+        if (list_empty(&lru)) {
+            // Interrupts are off, the release cannot slip in between the unlock and the sleep
+            spin_unlock(&bcache_lock);
+            wait_queue_sleep(&bcache_waiters);
+            spin_lock(&bcache_lock);
+            continue;
+        }
+
+        buffer = list_entry(list_pop_front(&lru), struct buffer, lru_elem);
+        buffer->refcount = 1;
+
+        if (buffer->dirty) {
+            // Write back the oldest dirty buffers along with the victim, one command per run of sectors is cheaper
+            // than one per eviction. They stay hashed under their sector while they are written back, so readers of
+            // those sectors wait for them instead of reading stale data from the disk
+            struct buffer *batch[BCACHE_WRITEBACK_BATCH];
+            int count      = 0;
+            batch[count++] = buffer;
+            for (auto elem = list_begin(&lru); elem != list_end(&lru) && count < BCACHE_WRITEBACK_BATCH;) {
+                auto const dirty = list_entry(elem, struct buffer, lru_elem);
+                elem             = list_next(elem);
+                if (dirty->dirty) {
+                    list_remove(&dirty->lru_elem);
+                    dirty->refcount = 1;
+                    batch[count++]  = dirty;
+                }
+            }
+            spin_unlock(&bcache_lock);
+
+            // Nobody held them, this does not sleep
+            for (int i = 0; i < count; i++) {
+                sleeplock_acquire(&batch[i]->lock);
+            }
+            bcache_write_back(batch, count);
+            for (int i = 0; i < count; i++) {
+                sleeplock_release(&batch[i]->lock);
+            }
+
+            spin_lock(&bcache_lock);
+            // A buffer that cannot be written back goes last, the others get recycled first
+            for (int i = 0; i < count; i++) {
+                if (--batch[i]->refcount == 0) {
+                    if (batch[i]->dirty) {
+                        list_push_back(&lru, &batch[i]->lru_elem);
+                    } else {
+                        list_push_front(&lru, &batch[i]->lru_elem);
+                    }
+                }
+            }
+            wait_queue_wake(&bcache_waiters, count);
+            // The sector may have been cached by someone else in the meantime, so look again
+            continue;
+        }
+
+        if (buffer->disk) {
+            list_remove(&buffer->hash_elem);
+            stats.evictions++;
+        }
+        buffer->disk      = disk;
+        buffer->lba       = lba;
+        buffer->valid     = false;
+        buffer->readahead = false;
+        list_push_back(&hash_table[bcache_hash(disk, lba)], &buffer->hash_elem);
+        if (!prefetch) {
+            stats.misses++;
+        }
+        spin_unlock(&bcache_lock);
+
+        // Nobody held the buffer, this does not sleep
+        sleeplock_acquire(&buffer->lock);
+        return buffer;
+    }
+}
+
+/// @brief Hold and lock the buffer of the sector, reading the sector if it is not cached
+/// @return the locked buffer, nullptr if the sector cannot be read
+struct buffer *bcache_get(const struct disk *disk, const uint32_t lba)
+{
+    struct buffer *buffer = bcache_lookup(disk, lba, false);
+    if (buffer->valid) {
+        return buffer;
+    }
+
+    if (block_read(disk, lba, 1, buffer->data) != ALL_OK) {
+        bcache_release(buffer);
+        return nullptr;
+    }
+    buffer->valid = true;
+
+    return buffer;
+}
+
+/// @brief Unlock the buffer and let go of it
+void bcache_release(struct buffer *buffer)
+{
+    sleeplock_release(&buffer->lock);
+
+    spin_lock(&bcache_lock);
+    ASSERT(buffer->refcount > 0, "Releasing a buffer that is not held");
+    if (--buffer->refcount == 0) {
+        list_push_back(&lru, &buffer->lru_elem);
+        wait_queue_wake(&bcache_waiters, 1);
+    }
+    spin_unlock(&bcache_lock);
+}
+
+/// @brief The data of the locked buffer changed, it is written back when recycled or flushed
+void bcache_mark_dirty(struct buffer *buffer)
+{
+    ASSERT(buffer->valid, "Dirtying a buffer without data");
+
+    spin_lock(&bcache_lock);
+    if (!buffer->dirty) {
+        buffer->dirty = true;
+        stats.dirty++;
+    }
+    spin_unlock(&bcache_lock);
+}
+
+/// @brief Read the sectors the run holds with one request, straight into the caller's memory, and cache them
+static int bcache_fill_run(const struct disk *disk, struct buffer **run, const int count, uint8_t *out,
+                           const bool prefetch)
+{
+    const int res = block_read(disk, run[0]->lba, count, out);
+
+    for (int i = 0; i < count; i++) {
+        if (res == ALL_OK) {
+            memcpy(run[i]->data, out + i * BCACHE_SECTOR_SIZE, BCACHE_SECTOR_SIZE);
+            run[i]->valid     = true;
+            run[i]->readahead = prefetch;
+        }
+        bcache_release(run[i]);
+    }
+
+    return res;
+}
+
+/// @brief Read sectors through the cache. Consecutive sectors that are not cached are read with one request
+int bcache_read(const struct disk *disk, const uint32_t lba, const int total, void *out)
+{
+    auto data = (uint8_t *)out;
+    int i     = 0;
+
+    while (i < total) {
+        struct buffer *buffer = bcache_lookup(disk, lba + i, false);
+        if (buffer->valid) {
+            memcpy(data + i * BCACHE_SECTOR_SIZE, buffer->data, BCACHE_SECTOR_SIZE);
+            bcache_release(buffer);
+            i++;
+            continue;
+        }
+
+        // Buffers are locked in increasing sector order, so two runs cannot deadlock
+        struct buffer *run[BCACHE_MAX_RUN];
+        int count    = 0;
+        run[count++] = buffer;
+        while (i + count < total && count < BCACHE_MAX_RUN) {
+            struct buffer *next = bcache_lookup(disk, lba + i + count, false);
+            if (next->valid) {
+                bcache_release(next);
+                break;
+            }
+            run[count++] = next;
+        }
+
+        const int res = bcache_fill_run(disk, run, count, data + i * BCACHE_SECTOR_SIZE, false);
+        if (res != ALL_OK) {
+            return res;
+        }
+        i += count;
+    }
+
+    return ALL_OK;
+}
+
+/// @brief Read sectors into the cache ahead of their use, the ones already cached are skipped
+/// @return the error of the first run that could not be read, the following runs are still read
+int bcache_prefetch(const struct disk *disk, const uint32_t lba, const int total)
+{
+    int res = ALL_OK;
+    int i   = 0;
+
+    sleeplock_acquire(&prefetch_lock);
+
+    while (i < total) {
+        struct buffer *run[BCACHE_MAX_RUN];
+        int count = 0;
+        while (i + count < total && count < BCACHE_MAX_RUN) {
+            struct buffer *buffer = bcache_lookup(disk, lba + i + count, true);
+            if (buffer->valid) {
+                bcache_release(buffer);
+                break;
+            }
+            run[count++] = buffer;
+        }
+
+        if (count == 0) {
+            i++;
+            continue;
+        }
+
+        const int filled = bcache_fill_run(disk, run, count, prefetch_buffer, true);
+        if (filled == ALL_OK) {
+            spin_lock(&bcache_lock);
+            stats.readahead += count;
+            spin_unlock(&bcache_lock);
+        } else if (res == ALL_OK) {
+            res = filled;
+        }
+        i += count;
+    }
+
+    sleeplock_release(&prefetch_lock);
+
+    return res;
+}
+
+/// @brief Write sectors into the cache, they reach the disk when they are recycled or flushed
+int bcache_write(const struct disk *disk, const uint32_t lba, const int total, const void *in)
+{
+    auto data = (const uint8_t *)in;
+
+    for (int i = 0; i < total; i++) {
+        // The whole sector is replaced, there is no need to read it first
+        struct buffer *buffer = bcache_lookup(disk, lba + i, false);
+        memcpy(buffer->data, data + i * BCACHE_SECTOR_SIZE, BCACHE_SECTOR_SIZE);
+        buffer->valid = true;
+        bcache_mark_dirty(buffer);
+        bcache_release(buffer);
+    }
+
+    return ALL_OK;
+}
+
+/// @brief Write back the batch and let go of its buffers
+static int bcache_flush_batch(struct buffer **batch, const int count)
+{
+    const int res = bcache_write_back(batch, count);
+    for (int i = 0; i < count; i++) {
+        bcache_release(batch[i]);
+    }
+
+    return res;
+}
+
+/// @brief Write back the dirty buffers of the disk, or of every disk when it is nullptr
+/// @return the first error, the other buffers are still written back
+int bcache_flush(const struct disk *disk)
+{
+    int res = ALL_OK;
+    struct buffer *batch[BCACHE_WRITEBACK_BATCH];
+    int count = 0;
+
+    for (int i = 0; i < BCACHE_BUFFERS; i++) {
+        struct buffer *buffer = &buffers[i];
+
+        spin_lock(&bcache_lock);
+        if (!buffer->dirty || (disk && buffer->disk != disk)) {
+            spin_unlock(&bcache_lock);
+            continue;
+        }
+        const bool held = buffer->refcount > 0;
+        if (buffer->refcount++ == 0) {
+            list_remove(&buffer->lru_elem);
+        }
+        spin_unlock(&bcache_lock);
+
+        if (held && count > 0) {
+            // The holder may be waiting for a buffer of the batch, so the batch goes first
+            const int written = bcache_flush_batch(batch, count);
+            res               = res == ALL_OK ? written : res;
+            count             = 0;
+        }
+
+        // Sleeps only when the buffer is held
+        sleeplock_acquire(&buffer->lock);
+        if (!buffer->dirty) {
+            bcache_release(buffer);
+            continue;
+        }
+        batch[count++] = buffer;
+
+        if (held || count == BCACHE_WRITEBACK_BATCH) {
+            const int written = bcache_flush_batch(batch, count);
+            res               = res == ALL_OK ? written : res;
+            count             = 0;
+        }
+    }
+
+    if (count > 0) {
+        const int written = bcache_flush_batch(batch, count);
+        res               = res == ALL_OK ? written : res;
+    }
+
+    return res;
+}
+
+void bcache_get_stats(struct bcache_stats *out)
+{
+    spin_lock(&bcache_lock);
+    *out = stats;
+    spin_unlock(&bcache_lock);
+}
+
+void bcache_print_stats(void)
+{
+    struct bcache_stats snapshot;
+    bcache_get_stats(&snapshot);
+
+    const uint32_t lookups = snapshot.hits + snapshot.misses;
+    printf(KBBLU "\n %-12s%-12s%-12s%-12s%-12s%-12s%-12s%-12s%-12s\n" KWHT,
+           "Buffers",
+           "Hits",
+           "Misses",
+           "Hit rate",
+           "Evictions",
+           "Writebacks",
+           "Dirty",
+           "Readahead",
+           "RA hits");
+    printf(" %-12u%-12lu%-12lu%-11lu%%%-12lu%-12lu%-12lu%-12lu%-12lu\n",
+           BCACHE_BUFFERS,
+           snapshot.hits,
+           snapshot.misses,
+           lookups ? snapshot.hits * 100 / lookups : 0,
+           snapshot.evictions,
+           snapshot.writebacks,
+           snapshot.dirty,
+           snapshot.readahead,
+           snapshot.readahead_hits);
+}
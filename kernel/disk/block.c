@@ -0,0 +1,367 @@
+#include <assert.h>
+#include <block.h>
+#include <config.h>
+#include <disk.h>
+#include <kernel.h>
+#include <kernel_heap.h>
+#include <memory.h>
+#include <printf.h>
+#include <scheduler.h>
+#include <softirq.h>
+#include <status.h>
+#include <termcolors.h>
+#include <thread.h>
+
+// Requests of every disk go through an elevator before they reach the driver. Submitters queue their requests sorted
+// by LBA, and the first one to wait while the disk is idle sends them to the driver until the queue is empty. Runs of
+// contiguous requests in the same direction become a single command, and the queue is swept in C-LOOK order unless
+// the oldest request waited past its deadline. Nothing is sorted or merged across a barrier.
+
+struct block_queue *block_queue_create(const struct disk *disk)
+{
+    struct block_queue *queue = kzalloc(sizeof(struct block_queue));
+    if (!queue) {
+        return nullptr;
+    }
+
+    queue->bounce = kzalloc(BLOCK_MAX_SECTORS * disk->sector_size);
+    if (!queue->bounce) {
+        kfree(queue);
+        return nullptr;
+    }
+
+    queue->disk = disk;
+    spinlock_init(&queue->lock, "block_queue");
+    list_init(&queue->sorted);
+    list_init(&queue->fifo);
+    wait_queue_init(&queue->waiters);
+
+    return queue;
+}
+
+static bool block_lba_less(const struct list_elem *a, const struct list_elem *b, void *aux)
+{
+    return list_entry(a, struct block_request, elem)->lba < list_entry(b, struct block_request, elem)->lba;
+}
+
+/// @brief Queue the request without waiting for it, block_wait() sends it to the driver
+void block_submit(struct block_request *request)
+{
+    struct block_queue *queue = request->disk->queue;
+
+    request->done     = false;
+    request->result   = ALL_OK;
+    request->deadline = scheduler_get_jiffies() + (request->write ? BLOCK_WRITE_DEADLINE : BLOCK_READ_DEADLINE);
+
+    spin_lock(&queue->lock);
+    request->epoch = queue->epoch;
+    if (request->flush) {
+        // Barriers only wait their turn in submission order
+        queue->epoch++;
+        queue->stats.barriers++;
+    } else {
+        list_insert_ordered(&queue->sorted, &request->elem, block_lba_less, nullptr);
+        queue->stats.requests++;
+    }
+    list_push_back(&queue->fifo, &request->fifo_elem);
+
+    queue->stats.depth++;
+    if (queue->stats.depth > queue->stats.max_depth) {
+        queue->stats.max_depth = queue->stats.depth;
+    }
+    spin_unlock(&queue->lock);
+}
+
+/// @brief The request to send next: a barrier once everything before it is done, the oldest request if it waited
+/// past its deadline, otherwise the first one of its epoch at or after the position of the last command, wrapping
+/// around to the lowest LBA
+/// @warning The queue lock must be held and the queue must not be empty
+static struct block_request *block_pick(struct block_queue *queue)
+{
+    auto const oldest = list_entry(list_front(&queue->fifo), struct block_request, fifo_elem);
+    if (oldest->flush) {
+        return oldest;
+    }
+    if ((int32_t)(scheduler_get_jiffies() - oldest->deadline) >= 0) {
+        queue->stats.expired++;
+        return oldest;
+    }
+
+    struct block_request *lowest = nullptr;
+    for (auto elem = list_begin(&queue->sorted); elem != list_end(&queue->sorted); elem = list_next(elem)) {
+        auto const request = list_entry(elem, struct block_request, elem);
+        if (request->epoch != oldest->epoch) {
+            continue;
+        }
+        if (request->lba >= queue->position) {
+            return request;
+        }
+        if (!lowest) {
+            lowest = request;
+        }
+    }
+
+    return lowest;
+}
+
+/// @brief Move the picked request and its contiguous neighbours going the same direction to the run, in LBA order
+/// @warning The queue lock must be held
+/// @return the number of sectors of the run
+static int block_take_run(struct block_queue *queue, struct block_request *picked, struct list *run)
+{
+    struct block_request *first = picked;
+    struct block_request *last  = picked;
+    int total                   = picked->total;
+
+    while (list_prev(&first->elem) != list_head(&queue->sorted)) {
+        auto const previous = list_entry(list_prev(&first->elem), struct block_request, elem);
+        if (previous->write != picked->write || previous->epoch != picked->epoch ||
+            previous->lba + previous->total != first->lba || total + previous->total > BLOCK_MAX_SECTORS) {
+            break;
+        }
+        first = previous;
+        total += previous->total;
+    }
+
+    while (list_next(&last->elem) != list_end(&queue->sorted)) {
+        auto const next = list_entry(list_next(&last->elem), struct block_request, elem);
+        if (next->write != picked->write || next->epoch != picked->epoch || last->lba + last->total != next->lba ||
+            total + next->total > BLOCK_MAX_SECTORS) {
+            break;
+        }
+        last = next;
+        total += next->total;
+    }
+
+    struct list_elem *elem      = &first->elem;
+    struct list_elem *const end = list_next(&last->elem);
+    while (elem != end) {
+        auto const request = list_entry(elem, struct block_request, elem);
+        elem               = list_remove(elem);
+        list_remove(&request->fifo_elem);
+        list_push_back(run, &request->elem);
+        queue->stats.depth--;
+    }
+
+    return total;
+}
+
+/// @brief Send one run to the driver. A run of several requests goes through the bounce buffer
+static int block_transfer(const struct block_queue *queue, struct list *run, const int total)
+{
+    const struct disk *disk = queue->disk;
+    auto const first        = list_entry(list_front(run), struct block_request, elem);
+
+    if (list_next(&first->elem) == list_end(run)) {
+        return first->write ? disk->ops->write(disk, first->lba, first->total, first->buffer)
+                            : disk->ops->read(disk, first->lba, first->total, first->buffer);
+    }
+
+    if (first->write) {
+        uint8_t *to = queue->bounce;
+        for (auto elem = list_begin(run); elem != list_end(run); elem = list_next(elem)) {
+            auto const request = list_entry(elem, struct block_request, elem);
+            memcpy(to, request->buffer, request->total * disk->sector_size);
+            to += request->total * disk->sector_size;
+        }
+        return disk->ops->write(disk, first->lba, total, queue->bounce);
+    }
+
+    const int res = disk->ops->read(disk, first->lba, total, queue->bounce);
+    if (res == ALL_OK) {
+        const uint8_t *from = queue->bounce;
+        for (auto elem = list_begin(run); elem != list_end(run); elem = list_next(elem)) {
+            auto const request = list_entry(elem, struct block_request, elem);
+            memcpy(request->buffer, from, request->total * disk->sector_size);
+            from += request->total * disk->sector_size;
+        }
+    }
+
+    return res;
+}
+
+static void block_complete(struct block_queue *queue, struct block_request *request, const int result)
+{
+    request->result = result;
+    request->done   = true;
+    wait_queue_wake_keyed(&queue->waiters, (uintptr_t)request, 1);
+}
+
+/// @brief Have the drive put the writes it completed on the medium
+/// @warning The queue lock must be held, it is dropped while the drive flushes
+static void block_dispatch_barrier(struct block_queue *queue, struct block_request *barrier)
+{
+    list_remove(&barrier->fifo_elem);
+    queue->stats.depth--;
+
+    int res = ALL_OK;
+    if (queue->unflushed && queue->disk->ops->flush) {
+        queue->unflushed = false;
+        queue->stats.flushes++;
+        spin_unlock(&queue->lock);
+        res = queue->disk->ops->flush(queue->disk);
+        spin_lock(&queue->lock);
+        if (res != ALL_OK) {
+            queue->unflushed = true;
+        }
+    }
+
+    block_complete(queue, barrier, res);
+}
+
+/// @brief Send the queued requests to the driver until the queue is empty
+static void block_dispatch(struct block_queue *queue)
+{
+    spin_lock(&queue->lock);
+
+    while (!list_empty(&queue->fifo)) {
+        auto const picked = block_pick(queue);
+        if (picked->flush) {
+            block_dispatch_barrier(queue, picked);
+            continue;
+        }
+
+        struct list run;
+        list_init(&run);
+
+        const bool write   = picked->write;
+        const int total    = block_take_run(queue, picked, &run);
+        const uint32_t lba = list_entry(list_front(&run), struct block_request, elem)->lba;
+
+        queue->stats.merged += list_size(&run) - 1;
+        queue->stats.commands++;
+        if (write) {
+            queue->stats.sectors_written += total;
+            queue->unflushed = true;
+        } else {
+            queue->stats.sectors_read += total;
+        }
+        spin_unlock(&queue->lock);
+
+        const int res = block_transfer(queue, &run, total);
+
+        spin_lock(&queue->lock);
+        queue->position = lba + total;
+        while (!list_empty(&run)) {
+            block_complete(queue, list_entry(list_pop_front(&run), struct block_request, elem), res);
+        }
+    }
+
+    queue->dispatching = false;
+    spin_unlock(&queue->lock);
+}
+
+/// @brief Wait for a submitted request to be done. If the disk is idle, the caller sends the queue to the driver
+/// @return the result of the driver
+int block_wait(struct block_request *request)
+{
+    struct block_queue *queue = request->disk->queue;
+    auto const thread         = scheduler_get_current_thread();
+
+    spin_lock(&queue->lock);
+    while (!request->done) {
+        if (!queue->dispatching) {
+            queue->dispatching = true;
+            spin_unlock(&queue->lock);
+            block_dispatch(queue);
+            spin_lock(&queue->lock);
+            continue;
+        }
+
+        // Before the scheduler starts there is only one caller, and it always finds the disk idle
+        ASSERT(thread && !softirq_is_running(), "Waiting for a block request without a thread");
+
+        // The request lives on the stack of this thread, which must not be torn down before it is done
+        thread->uninterruptible++;
+        // Interrupts are off, the completion cannot slip in between the unlock and the sleep
+        spin_unlock(&queue->lock);
+        wait_queue_sleep_keyed(&queue->waiters, (uintptr_t)request);
+        spin_lock(&queue->lock);
+        thread->uninterruptible--;
+    }
+    spin_unlock(&queue->lock);
+
+    return request->result;
+}
+
+static int block_transfer_sync(const struct disk *disk, const uint32_t lba, const int total, void *buffer,
+                               const bool write)
+{
+    struct block_request request = {
+        .disk   = disk,
+        .lba    = lba,
+        .total  = total,
+        .buffer = buffer,
+        .write  = write,
+    };
+
+    block_submit(&request);
+    return block_wait(&request);
+}
+
+int block_read(const struct disk *disk, const uint32_t lba, const int total, void *buffer)
+{
+    return block_transfer_sync(disk, lba, total, buffer, false);
+}
+
+int block_write(const struct disk *disk, const uint32_t lba, const int total, void *buffer)
+{
+    return block_transfer_sync(disk, lba, total, buffer, true);
+}
+
+/// @brief Wait for the requests queued so far and put them on the medium
+int block_flush(const struct disk *disk)
+{
+    struct block_request request = {
+        .disk  = disk,
+        .flush = true,
+    };
+
+    block_submit(&request);
+    return block_wait(&request);
+}
+
+void block_get_stats(const struct disk *disk, struct disk_stat *stats)
+{
+    struct block_queue *queue = disk->queue;
+
+    spin_lock(&queue->lock);
+    *stats = queue->stats;
+    spin_unlock(&queue->lock);
+}
+
+void block_print_stats(void)
+{
+    printf(KBBLU "\n %-6s%-10s%-10s%-10s%-10s%-10s%-10s%-10s%-8s%-8s\n" KWHT,
+           "Disk",
+           "Requests",
+           "Merged",
+           "Commands",
+           "Read",
+           "Written",
+           "Expired",
+           "Flushes",
+           "Depth",
+           "Max");
+
+    for (int i = 0; i < MAX_DISKS; i++) {
+        const struct disk *disk = disk_get(i);
+        if (!disk) {
+            break;
+        }
+
+        struct disk_stat stats;
+        block_get_stats(disk, &stats);
+        printf(" %-6d%-10lu%-10lu%-10lu%-10lu%-10lu%-10lu%-10lu%-8lu%-8lu\n",
+               disk->id,
+               stats.requests,
+               stats.merged,
+               stats.commands,
+               stats.sectors_read,
+               stats.sectors_written,
+               stats.expired,
+               stats.flushes,
+               stats.depth,
+               stats.max_depth);
+    }
+}
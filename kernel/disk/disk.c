@@ -1,65 +1,179 @@
 #include <ata.h>
+#include <bcache.h>
+#include <block.h>
+#include <config.h>
 #include <debug.h>
 #include <disk.h>
 #include <kernel.h>
+#include <kernel_heap.h>
+#include <kthread.h>
 #include <memory.h>
+#include <printf.h>
+#include <scheduler.h>
+#include <serial.h>
+#include <status.h>
+#include <termcolors.h>
+#include <thread.h>
+#include <vfs.h>
 
 __attribute__((nonnull)) struct file_system *vfs_resolve(struct disk *disk);
-struct disk disk;
 
+/// Disk 0 holds the root file system
+static struct disk *disks[MAX_DISKS];
+static int disk_count;
+
+/// @brief Put the dirty sectors of every disk on the medium every DISK_WRITEBACK_INTERVAL milliseconds
+static void disk_writeback(void *arg)
+{
+    auto const thread = scheduler_get_current_thread();
+
+    while (true) {
+        thread->sleep_reason = SLEEP_REASON_NONE;
+        thread->sleep_until  = scheduler_get_jiffies() + DISK_WRITEBACK_INTERVAL;
+        thread->state        = SLEEPING;
+        // The scheduler wakes us up once the time has passed
+        while (thread->state == SLEEPING) {
+            schedule();
+        }
+
+        disk_sync_all();
+    }
+}
+
+/// @brief Register the legacy IDE disk before pci_scan() finds the other controllers, so it gets to be disk 0
 void disk_init()
 {
-    memset(&disk, 0, sizeof(disk));
-    disk.type = DISK_TYPE_PHYSICAL;
-    disk.id   = 0;
+    bcache_init();
+    ata_init();
 
-    disk.sector_size = ata_get_sector_size();
+    if (ISERR(kthread_create("writeback", disk_writeback, nullptr))) {
+        panic("Failed to create the writeback thread\n");
+    }
+}
 
-    // Validate the sector size
-    if (disk.sector_size != 512 && disk.sector_size != 1024 && disk.sector_size != 2048 && disk.sector_size != 4096) {
-        panic("Invalid sector size detected\n");
+/// @brief Look for the root file system on disk 0, once every controller registered its disks
+void disk_mount_root()
+{
+    if (!disks[0]) {
+        panic("No disk found\n");
         return;
     }
 
-    disk.fs = vfs_resolve(&disk);
+    disks[0]->fs = vfs_resolve(disks[0]);
+}
+
+/// @brief Write back the cached sectors of the disk and have the drive put them on the medium
+/// @return the first error, the flush is still sent when the write-back fails
+int disk_sync(const struct disk *disk)
+{
+    int synced = ALL_OK;
+    if (disk->fs && disk->fs->sync) {
+        synced = disk->fs->sync(disk);
+    }
+    const int written = bcache_flush(disk);
+    const int flushed = block_flush(disk);
+
+    if (synced != ALL_OK) {
+        return synced;
+    }
+    return written != ALL_OK ? written : flushed;
+}
+
+/// @brief disk_sync() every disk
+int disk_sync_all(void)
+{
+    int res = ALL_OK;
+    for (int i = 0; i < disk_count; i++) {
+        const int synced = disk_sync(disks[i]);
+        if (res == ALL_OK) {
+            res = synced;
+        }
+    }
+
+    return res;
+}
+
+/// @brief Make a block device available to the file systems
+/// @return the new disk, or nullptr if it cannot be used
+struct disk *disk_register(const char *name, const struct disk_operations *ops, void *private,
+                           const uint16_t sector_size, const uint32_t sectors)
+{
+    // Every disk goes through the buffer cache, which holds 512 byte sectors
+    if (sector_size != BCACHE_SECTOR_SIZE) {
+        warningf("Invalid sector size %u on %s\n", sector_size, name);
+        return nullptr;
+    }
+
+    if (disk_count == MAX_DISKS) {
+        warningf("No room for disk %s\n", name);
+        return nullptr;
+    }
+
+    struct disk *disk = kzalloc(sizeof(struct disk));
+    disk->id          = disk_count;
+    disk->type        = DISK_TYPE_PHYSICAL;
+    disk->name        = name;
+    disk->sector_size = sector_size;
+    disk->sectors     = sectors;
+    disk->ops         = ops;
+    disk->private     = private;
+    disk->queue       = block_queue_create(disk);
+    if (!disk->queue) {
+        warningf("Failed to allocate the request queue of %s\n", name);
+        kfree(disk);
+        return nullptr;
+    }
+
+    disks[disk_count++] = disk;
+
+    printf("[ " KBGRN "OK" KWHT " ] ");
+    printf("Disk %d: %s, %lu MiB\n", disk->id, name, (uint32_t)((uint64_t)sectors * sector_size / 1024 / 1024));
+
+    return disk;
 }
 
 struct disk *disk_get(const int index)
 {
-    if (index != 0) {
+    if (index < 0 || index >= disk_count) {
         return nullptr;
     }
 
-    return &disk;
+    return disks[index];
 }
 
-int disk_read_block(const uint32_t lba, const int total, void *buffer)
+int disk_read_block(const struct disk *disk, const uint32_t lba, const int total, void *buffer)
 {
-    return ata_read_sectors(lba, total, buffer);
+    return bcache_read(disk, lba, total, buffer);
 }
 
-int disk_read_sector(const uint32_t sector, uint8_t *buffer)
+int disk_read_sector(const struct disk *disk, const uint32_t sector, uint8_t *buffer)
 {
-    return ata_read_sectors(sector, 1, buffer);
+    return bcache_read(disk, sector, 1, buffer);
 }
 
-int disk_write_block(const uint32_t lba, const int total, void *buffer)
+int disk_write_block(const struct disk *disk, const uint32_t lba, const int total, void *buffer)
 {
-    return ata_write_sectors(lba, total, buffer);
+    return bcache_write(disk, lba, total, buffer);
 }
 
-int disk_write_sector(const uint32_t sector, uint8_t *buffer)
+int disk_write_sector(const struct disk *disk, const uint32_t sector, uint8_t *buffer)
 {
-    return ata_write_sectors(sector, 1, buffer);
+    return bcache_write(disk, sector, 1, buffer);
 }
 
-int disk_write_sector_offset(const void *data, const int size, const int offset, const int sector)
+int disk_write_sector_offset(const struct disk *disk, const void *data, const int size, const int offset,
+                             const int sector)
 {
-    ASSERT(size <= 512 - offset);
+    ASSERT(size <= disk->sector_size - offset);
+
+    struct buffer *buffer = bcache_get(disk, sector);
+    if (!buffer) {
+        return -EIO;
+    }
 
-    uint8_t buffer[512];
-    disk_read_sector(sector, buffer);
+    memcpy(&buffer->data[offset], data, size);
+    bcache_mark_dirty(buffer);
+    bcache_release(buffer);
 
-    memcpy(&buffer[offset], data, size);
-    return disk_write_sector(sector, buffer);
+    return ALL_OK;
 }
@@ -1,7 +1,10 @@
+#include <bcache.h>
 #include <debug.h>
 #include <disk.h>
 #include <kernel_heap.h>
+#include <memory.h>
 #include <serial.h>
+#include <status.h>
 #include <stream.h>
 
 struct disk_stream *disk_stream_create(const int disk_index)
@@ -28,76 +31,131 @@ int disk_stream_seek(struct disk_stream *stream, const uint32_t position)
     return 0;
 }
 
-int disk_stream_read(struct disk_stream *stream, void *out, const uint32_t size)
-{ // NOLINT(*-no-recursion)
-    ASSERT(stream->disk->sector_size > 0, "Invalid sector size");
-    const uint32_t sector = stream->position / stream->disk->sector_size;
-    const uint32_t offset = stream->position % stream->disk->sector_size;
-    uint32_t to_read      = size;
-    const bool overflow   = (offset + to_read) >= stream->disk->sector_size;
-    uint8_t buffer[stream->disk->sector_size];
-
-    if (overflow) {
-        to_read -= (offset + to_read) - stream->disk->sector_size;
+/// @brief Copy part of one sector, through the buffer cache
+static int disk_stream_read_partial(const struct disk_stream *stream, const uint32_t sector, const uint32_t offset,
+                                    uint8_t *out, const uint32_t size)
+{
+    struct buffer *buffer = bcache_get(stream->disk, sector);
+    if (!buffer) {
+        return -EIO;
     }
 
-    int res = disk_read_sector(sector, buffer);
-    if (res < 0) {
-        panic("Failed to read block\n");
-        return res;
-    }
+    memcpy(out, &buffer->data[offset], size);
+    bcache_release(buffer);
 
-    for (uint32_t i = 0; i < to_read; i++) {
-        *(uint8_t *)out = buffer[offset + i];
-        out             = (uint8_t *)out + 1;
-    }
+    return ALL_OK;
+}
 
-    stream->position += to_read;
-    if (overflow) {
-        res = disk_stream_read(stream, out, size - to_read);
+/// @brief Change part of one sector, through the buffer cache
+static int disk_stream_write_partial(const struct disk_stream *stream, const uint32_t sector, const uint32_t offset,
+                                     const uint8_t *in, const uint32_t size)
+{
+    struct buffer *buffer = bcache_get(stream->disk, sector);
+    if (!buffer) {
+        return -EIO;
     }
 
-    ASSERT((uint16_t *)out != nullptr, "Invalid out pointer");
+    memcpy(&buffer->data[offset], in, size);
+    bcache_mark_dirty(buffer);
+    bcache_release(buffer);
 
-    return res;
+    return ALL_OK;
 }
 
-int disk_stream_write(struct disk_stream *stream, const void *in, const uint32_t size)
+/// @brief Read from the current position. The unaligned head and tail are copied out of their sectors, the whole
+/// sectors in between are read with one request
+int disk_stream_read(struct disk_stream *stream, void *out, const uint32_t size)
 {
-    ASSERT(stream->disk->sector_size > 0, "Invalid sector size");
-    const uint32_t sector = stream->position / stream->disk->sector_size;
-    const uint32_t offset = stream->position % stream->disk->sector_size;
-    uint32_t to_write     = size;
-    const bool overflow   = (offset + to_write) >= stream->disk->sector_size;
-    uint8_t buffer[stream->disk->sector_size];
-
-    if (overflow) {
-        to_write -= (offset + to_write) - stream->disk->sector_size;
+    const uint32_t sector_size = stream->disk->sector_size;
+    ASSERT(sector_size > 0, "Invalid sector size");
+
+    auto data           = (uint8_t *)out;
+    uint32_t remaining  = size;
+    uint32_t sector     = stream->position / sector_size;
+    const uint32_t head = stream->position % sector_size;
+
+    if (head != 0 && remaining > 0) {
+        const uint32_t to_read = remaining < sector_size - head ? remaining : sector_size - head;
+        if (disk_stream_read_partial(stream, sector, head, data, to_read) != ALL_OK) {
+            panic("Failed to read block\n");
+            return -EIO;
+        }
+        data += to_read;
+        remaining -= to_read;
+        stream->position += to_read;
+        sector++;
+    }
+
+    const uint32_t sectors = remaining / sector_size;
+    if (sectors > 0) {
+        const int res = disk_read_block(stream->disk, sector, (int)sectors, data);
+        if (res < 0) {
+            panic("Failed to read block\n");
+            return res;
+        }
+        data += sectors * sector_size;
+        remaining -= sectors * sector_size;
+        stream->position += sectors * sector_size;
+        sector += sectors;
     }
 
-    int res = disk_read_sector(sector, buffer);
-    if (res < 0) {
-        warningf("Failed to read block\n");
-        return res;
+    if (remaining > 0) {
+        if (disk_stream_read_partial(stream, sector, 0, data, remaining) != ALL_OK) {
+            panic("Failed to read block\n");
+            return -EIO;
+        }
+        stream->position += remaining;
     }
 
-    for (uint32_t i = 0; i < to_write; i++) {
-        buffer[offset + i] = *(uint8_t *)in;
-        in                 = (uint8_t *)in + 1;
+    return ALL_OK;
+}
+
+/// @brief Write at the current position. Only the unaligned head and tail sectors need their old contents, the whole
+/// sectors in between are replaced with one request
+int disk_stream_write(struct disk_stream *stream, const void *in, const uint32_t size)
+{
+    const uint32_t sector_size = stream->disk->sector_size;
+    ASSERT(sector_size > 0, "Invalid sector size");
+
+    auto data           = (const uint8_t *)in;
+    uint32_t remaining  = size;
+    uint32_t sector     = stream->position / sector_size;
+    const uint32_t head = stream->position % sector_size;
+
+    if (head != 0 && remaining > 0) {
+        const uint32_t to_write = remaining < sector_size - head ? remaining : sector_size - head;
+        if (disk_stream_write_partial(stream, sector, head, data, to_write) != ALL_OK) {
+            warningf("Failed to write the start of sector %lu\n", sector);
+            return -EIO;
+        }
+        data += to_write;
+        remaining -= to_write;
+        stream->position += to_write;
+        sector++;
     }
 
-    res = disk_write_sector(sector, buffer);
-    if (res < 0) {
-        warningf("Failed to write block\n");
-        return res;
+    const uint32_t sectors = remaining / sector_size;
+    if (sectors > 0) {
+        const int res = disk_write_block(stream->disk, sector, (int)sectors, (void *)data);
+        if (res < 0) {
+            warningf("Failed to write block\n");
+            return res;
+        }
+        data += sectors * sector_size;
+        remaining -= sectors * sector_size;
+        stream->position += sectors * sector_size;
+        sector += sectors;
     }
 
-    stream->position += to_write;
-    if (overflow) {
-        res = disk_stream_write(stream, in, size - to_write);
+    if (remaining > 0) {
+        if (disk_stream_write_partial(stream, sector, 0, data, remaining) != ALL_OK) {
+            warningf("Failed to write the end of sector %lu\n", sector);
+            return -EIO;
+        }
+        stream->position += remaining;
     }
 
-    return res;
+    return ALL_OK;
 }
 
 void disk_stream_close(struct disk_stream *stream)
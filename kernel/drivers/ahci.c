@@ -0,0 +1,657 @@
+#include <ahci.h>
+#include <assert.h>
+#include <disk.h>
+#include <idt.h>
+#include <kernel.h>
+#include <kernel_heap.h>
+#include <memory.h>
+#include <paging.h>
+#include <pci.h>
+#include <printf.h>
+#include <scheduler.h>
+#include <serial.h>
+#include <softirq.h>
+#include <spinlock.h>
+#include <status.h>
+#include <stddef.h>
+#include <termcolors.h>
+#include <thread.h>
+#include <wait_queue.h>
+#include <x86.h>
+
+// https://wiki.osdev.org/AHCI
+// Serial ATA AHCI 1.3.1 Specification
+
+#define IRQ0 0x20
+
+#define AHCI_PROG_IF 0x01
+#define AHCI_MAX_PORTS 32
+#define AHCI_MAX_SLOTS 32
+#define AHCI_SECTOR_SIZE 512
+// Sectors moved by one command
+#define AHCI_MAX_SECTORS 256
+// A command spans at most this many pages
+#define AHCI_PRD_ENTRIES (AHCI_MAX_SECTORS * AHCI_SECTOR_SIZE / PAGING_PAGE_SIZE + 1)
+// The byte count of a PRD entry is 22 bits wide
+#define AHCI_PRD_MAX_SIZE (4 * 1024 * 1024)
+
+#define AHCI_CAP_SLOTS(cap) ((((cap) >> 8) & 0x1F) + 1)
+#define AHCI_CAP_NCQ (1U << 30)
+#define AHCI_GHC_INTERRUPT_ENABLE (1U << 1)
+#define AHCI_GHC_AHCI_ENABLE (1U << 31)
+
+#define AHCI_PORT_CMD_START (1U << 0)
+#define AHCI_PORT_CMD_CLO (1U << 3) // Command list override, clears BSY and DRQ
+#define AHCI_PORT_CMD_FIS_RECEIVE (1U << 4)
+#define AHCI_PORT_CMD_FIS_RUNNING (1U << 14)
+#define AHCI_PORT_CMD_LIST_RUNNING (1U << 15)
+
+#define AHCI_PORT_IS_D2H_REGISTER (1U << 0) // A non-queued command completed
+#define AHCI_PORT_IS_PIO_SETUP (1U << 1)
+#define AHCI_PORT_IS_SET_DEVICE_BITS (1U << 3) // Queued commands completed
+#define AHCI_PORT_IS_ERRORS 0x7D80'0000U       // TFES, HBFS, HBDS, IFS, OFS, IPMS, PRCS
+#define AHCI_PORT_IE (AHCI_PORT_IS_D2H_REGISTER | AHCI_PORT_IS_PIO_SETUP | AHCI_PORT_IS_SET_DEVICE_BITS | \
+                      AHCI_PORT_IS_ERRORS)
+
+#define AHCI_SSTS_DET_PRESENT 0x3
+#define AHCI_SSTS_IPM_ACTIVE 0x1
+#define AHCI_SIGNATURE_ATA 0x0000'0101
+
+#define AHCI_TFD_BUSY 0x80
+#define AHCI_TFD_DRQ 0x08
+
+#define AHCI_FIS_TYPE_REG_H2D 0x27
+#define AHCI_FIS_COMMAND 0x80
+#define AHCI_DEVICE_LBA 0x40
+
+#define AHCI_HEADER_WRITE (1U << 6)
+
+#define ATA_CMD_IDENTIFY 0xEC
+#define ATA_CMD_READ_DMA_EXT 0x25
+#define ATA_CMD_WRITE_DMA_EXT 0x35
+#define ATA_CMD_FLUSH_CACHE_EXT 0xEA
+#define ATA_CMD_READ_FPDMA_QUEUED 0x60
+#define ATA_CMD_WRITE_FPDMA_QUEUED 0x61
+
+struct ahci_port_registers {
+    uint32_t command_list;
+    uint32_t command_list_upper;
+    uint32_t fis;
+    uint32_t fis_upper;
+    uint32_t interrupt_status;
+    uint32_t interrupt_enable;
+    uint32_t command;
+    uint32_t reserved0;
+    uint32_t task_file;
+    uint32_t signature;
+    uint32_t sata_status;
+    uint32_t sata_control;
+    uint32_t sata_error;
+    /// Tags of the queued commands the drive has not completed
+    uint32_t sata_active;
+    /// Slots the HBA has not finished processing
+    uint32_t command_issue;
+    uint32_t sata_notification;
+    uint32_t fis_switch_control;
+    uint32_t reserved1[11];
+    uint32_t vendor[4];
+};
+
+struct ahci_hba_registers {
+    uint32_t capabilities;
+    uint32_t global_control;
+    /// One bit per port with a pending interrupt
+    uint32_t interrupt_status;
+    uint32_t ports_implemented;
+    uint32_t version;
+    uint32_t ccc_control;
+    uint32_t ccc_ports;
+    uint32_t em_location;
+    uint32_t em_control;
+    uint32_t capabilities2;
+    uint32_t handoff;
+    uint8_t reserved[0xA0 - 0x2C];
+    uint8_t vendor[0x100 - 0xA0];
+    struct ahci_port_registers ports[AHCI_MAX_PORTS];
+};
+
+static_assert(sizeof(struct ahci_port_registers) == 0x80, "AHCI port registers are 128 bytes");
+static_assert(sizeof(struct ahci_hba_registers) == 0x1100, "AHCI registers are 0x1100 bytes");
+
+/// @brief One of the 32 slots of a command list
+struct ahci_command_header {
+    /// Length of the command FIS in dwords, direction and flags
+    uint16_t flags;
+    uint16_t prdt_length;
+    /// Bytes transferred, written by the HBA
+    volatile uint32_t prd_byte_count;
+    uint32_t table;
+    uint32_t table_upper;
+    uint32_t reserved[4];
+};
+
+struct ahci_prd {
+    uint32_t address;
+    uint32_t address_upper;
+    uint32_t reserved;
+    /// Bytes in the region minus one
+    uint32_t byte_count;
+};
+
+/// @brief Register Host to Device FIS, carries an ATA command
+struct ahci_fis_h2d {
+    uint8_t type;
+    uint8_t flags;
+    uint8_t command;
+    uint8_t feature_low;
+    uint8_t lba0;
+    uint8_t lba1;
+    uint8_t lba2;
+    uint8_t device;
+    uint8_t lba3;
+    uint8_t lba4;
+    uint8_t lba5;
+    uint8_t feature_high;
+    uint8_t count_low;
+    uint8_t count_high;
+    uint8_t icc;
+    uint8_t control;
+    uint8_t reserved[4];
+};
+
+/// @brief Command FIS and PRD table of a slot, it must be 128 byte aligned
+struct ahci_command_table {
+    uint8_t fis[64];
+    uint8_t atapi[16];
+    uint8_t reserved[48];
+    struct ahci_prd prdt[AHCI_PRD_ENTRIES];
+} __attribute__((aligned(128)));
+
+/// @brief A command on a port. It lives on the stack of the thread that submitted it
+struct ahci_request {
+    uint8_t command;
+    uint32_t lba;
+    uint16_t count;
+    void *buffer;
+    uint32_t size;
+    bool write;
+    /// Issued as a native queued command, next to other queued commands
+    bool queued;
+    bool done;
+    int result;
+};
+
+struct ahci_port {
+    int number;
+    volatile struct ahci_port_registers *registers;
+    /// 1 KiB command list, followed by the 256 byte FIS receive area
+    struct ahci_command_header *command_list;
+    struct ahci_command_table *tables;
+    /// Slots in use at once, the queue depth of the drive with NCQ
+    int slots;
+    bool ncq;
+    /// Slots whose command the drive has not completed
+    uint32_t busy;
+    /// The command in flight is not queued, nothing else can be issued next to it
+    bool exclusive;
+    struct ahci_request *requests[AHCI_MAX_SLOTS];
+    spinlock_t lock;
+    /// Submitters sleep here keyed by their request, and keyed by the port while waiting for a slot
+    struct wait_queue waiters;
+};
+
+static volatile struct ahci_hba_registers *ahci_hba;
+static struct ahci_port *ahci_ports[AHCI_MAX_PORTS];
+
+static const struct disk_operations ahci_disk_operations;
+
+static uint32_t ahci_physical(void *address)
+{
+    return (uint32_t)paging_get_physical_address(kernel_page_directory, address);
+}
+
+static void ahci_port_stop(volatile struct ahci_port_registers *registers)
+{
+    registers->command &= ~(AHCI_PORT_CMD_START | AHCI_PORT_CMD_FIS_RECEIVE);
+    while (registers->command & (AHCI_PORT_CMD_LIST_RUNNING | AHCI_PORT_CMD_FIS_RUNNING)) {
+        pause();
+    }
+}
+
+static void ahci_port_start(volatile struct ahci_port_registers *registers)
+{
+    while (registers->command & AHCI_PORT_CMD_LIST_RUNNING) {
+        pause();
+    }
+    registers->command |= AHCI_PORT_CMD_FIS_RECEIVE;
+    registers->command |= AHCI_PORT_CMD_START;
+}
+
+/// @brief Get a failed port going again. Every command in flight is lost
+/// @warning port->lock must be held
+static void ahci_port_recover(const struct ahci_port *port)
+{
+    auto const registers = port->registers;
+
+    ahci_port_stop(registers);
+    registers->sata_error       = 0xFFFF'FFFF;
+    registers->interrupt_status = 0xFFFF'FFFF;
+
+    // The drive may still look busy with the failed command
+    if (registers->task_file & (AHCI_TFD_BUSY | AHCI_TFD_DRQ)) {
+        registers->command |= AHCI_PORT_CMD_CLO;
+        while (registers->command & AHCI_PORT_CMD_CLO) {
+            pause();
+        }
+    }
+
+    ahci_port_start(registers);
+}
+
+/// @brief Describe the buffer of the request in the PRD table of the slot, merging physically contiguous pages
+/// @return the number of entries
+static int ahci_build_prdt(struct ahci_command_table *table, const struct ahci_request *request)
+{
+    auto address       = (uint32_t)request->buffer;
+    uint32_t remaining = request->size;
+    int count          = 0;
+
+    while (remaining > 0) {
+        const uint32_t physical  = ahci_physical((void *)address);
+        const uint32_t page_left = PAGING_PAGE_SIZE - address % PAGING_PAGE_SIZE;
+        const uint32_t size      = remaining < page_left ? remaining : page_left;
+
+        struct ahci_prd *last    = count ? &table->prdt[count - 1] : nullptr;
+        const uint32_t last_size = last ? last->byte_count + 1 : 0;
+
+        if (last && last->address + last_size == physical && last_size + size <= AHCI_PRD_MAX_SIZE) {
+            last->byte_count += size;
+        } else {
+            ASSERT(count < AHCI_PRD_ENTRIES, "Too many PRD entries");
+            table->prdt[count++] = (struct ahci_prd){.address = physical, .byte_count = size - 1};
+        }
+
+        address += size;
+        remaining -= size;
+    }
+
+    return count;
+}
+
+/// @brief Fill the slot with the request and hand it to the HBA
+/// @warning port->lock must be held
+static void ahci_issue(struct ahci_port *port, const int slot, struct ahci_request *request)
+{
+    struct ahci_command_table *table = &port->tables[slot];
+    memset(table, 0, offsetof(struct ahci_command_table, prdt));
+
+    auto const fis = (struct ahci_fis_h2d *)table->fis;
+    fis->type      = AHCI_FIS_TYPE_REG_H2D;
+    fis->flags     = AHCI_FIS_COMMAND;
+    fis->command   = request->command;
+    fis->device    = AHCI_DEVICE_LBA;
+    fis->lba0      = request->lba & 0xFF;
+    fis->lba1      = request->lba >> 8 & 0xFF;
+    fis->lba2      = request->lba >> 16 & 0xFF;
+    fis->lba3      = request->lba >> 24 & 0xFF;
+
+    if (request->queued) {
+        // Queued commands carry the sector count in the features and their tag in the count
+        fis->feature_low  = request->count & 0xFF;
+        fis->feature_high = request->count >> 8;
+        fis->count_low    = slot << 3;
+    } else {
+        fis->count_low  = request->count & 0xFF;
+        fis->count_high = request->count >> 8;
+    }
+
+    struct ahci_command_header *header = &port->command_list[slot];
+    header->flags          = sizeof(struct ahci_fis_h2d) / sizeof(uint32_t) | (request->write ? AHCI_HEADER_WRITE : 0);
+    header->prdt_length    = request->size ? ahci_build_prdt(table, request) : 0;
+    header->prd_byte_count = 0;
+
+    port->requests[slot] = request;
+    port->busy |= 1U << slot;
+    port->exclusive = !request->queued;
+
+    if (request->queued) {
+        port->registers->sata_active = 1U << slot;
+    }
+    port->registers->command_issue = 1U << slot;
+}
+
+/// @brief Finish the commands the drive is done with and wake their submitters
+/// @warning port->lock must be held
+static void ahci_port_complete(struct ahci_port *port)
+{
+    auto const registers  = port->registers;
+    const uint32_t status = registers->interrupt_status;
+    registers->interrupt_status = status;
+
+    uint32_t finished = port->busy & ~(registers->command_issue | registers->sata_active);
+    int result        = ALL_OK;
+
+    if (status & AHCI_PORT_IS_ERRORS) {
+        warningf("AHCI port %d failed, status %#lx, task file %#lx\n", port->number, status, registers->task_file);
+        // Without reading the NCQ error log there is no telling which command failed, so they all do
+        finished = port->busy;
+        result   = -EIO;
+        ahci_port_recover(port);
+    }
+
+    if (!finished) {
+        return;
+    }
+
+    for (int slot = 0; slot < AHCI_MAX_SLOTS; slot++) {
+        if (!(finished & 1U << slot)) {
+            continue;
+        }
+
+        struct ahci_request *request = port->requests[slot];
+        port->requests[slot]         = nullptr;
+        request->result              = result;
+        request->done                = true;
+        wait_queue_wake_keyed(&port->waiters, (uintptr_t)request, 1);
+    }
+
+    port->busy &= ~finished;
+    wait_queue_wake_keyed(&port->waiters, (uintptr_t)port, AHCI_MAX_SLOTS);
+}
+
+/// @return a free slot the request can be issued in, -1 if it has to wait
+/// @warning port->lock must be held
+static int ahci_find_slot(const struct ahci_port *port, const struct ahci_request *request)
+{
+    // Queued and non-queued commands cannot be in flight together
+    if (port->busy && (port->exclusive || !request->queued)) {
+        return -1;
+    }
+
+    for (int slot = 0; slot < port->slots; slot++) {
+        if (!(port->busy & 1U << slot)) {
+            return slot;
+        }
+    }
+
+    return -1;
+}
+
+static void ahci_port_poll(struct ahci_port *port)
+{
+    const uint32_t flags = spin_lock_irqsave(&port->lock);
+    ahci_port_complete(port);
+    spin_unlock_irqrestore(&port->lock, flags);
+    pause();
+}
+
+/// @brief Issue the request as soon as a slot is free, and wait until the drive completed it
+static int ahci_submit(struct ahci_port *port, struct ahci_request *request)
+{
+    auto const thread = scheduler_get_current_thread();
+    // Before the scheduler starts, there is nobody to put to sleep
+    const bool can_sleep = thread && !softirq_is_running();
+
+    request->done   = false;
+    request->result = ALL_OK;
+
+    uint32_t flags = spin_lock_irqsave(&port->lock);
+    int slot       = ahci_find_slot(port, request);
+    while (slot < 0) {
+        spin_unlock_irqrestore(&port->lock, flags);
+        if (can_sleep) {
+            wait_queue_sleep_keyed(&port->waiters, (uintptr_t)port);
+        } else {
+            ahci_port_poll(port);
+        }
+        flags = spin_lock_irqsave(&port->lock);
+        slot  = ahci_find_slot(port, request);
+    }
+    ahci_issue(port, slot, request);
+    spin_unlock_irqrestore(&port->lock, flags);
+
+    if (!can_sleep) {
+        while (!request->done) {
+            ahci_port_poll(port);
+        }
+        return request->result;
+    }
+
+    // The request lives on this stack, the thread must not be torn down before the drive is done with it
+    thread->uninterruptible++;
+    while (!request->done) {
+        // Interrupts are off, the completion cannot slip in between the check and the sleep
+        wait_queue_sleep_keyed(&port->waiters, (uintptr_t)request);
+    }
+    thread->uninterruptible--;
+
+    return request->result;
+}
+
+static int ahci_flush(struct ahci_port *port)
+{
+    struct ahci_request request = {.command = ATA_CMD_FLUSH_CACHE_EXT};
+    return ahci_submit(port, &request);
+}
+
+static int ahci_transfer(struct ahci_port *port, uint32_t lba, int total, uint8_t *buffer, const bool write)
+{
+    int res = ALL_OK;
+
+    // The HBA needs word aligned buffers
+    uint8_t *bounce = nullptr;
+    if ((uintptr_t)buffer & 1) {
+        bounce = kmalloc(total * AHCI_SECTOR_SIZE);
+        if (!bounce) {
+            return -ENOMEM;
+        }
+        if (write) {
+            memcpy(bounce, buffer, total * AHCI_SECTOR_SIZE);
+        }
+    }
+
+    uint8_t *data = bounce ? bounce : buffer;
+    while (total > 0) {
+        const int count = total < AHCI_MAX_SECTORS ? total : AHCI_MAX_SECTORS;
+
+        struct ahci_request request = {
+            .lba    = lba,
+            .count  = count,
+            .buffer = data,
+            .size   = count * AHCI_SECTOR_SIZE,
+            .write  = write,
+            .queued = port->ncq,
+        };
+        if (port->ncq) {
+            request.command = write ? ATA_CMD_WRITE_FPDMA_QUEUED : ATA_CMD_READ_FPDMA_QUEUED;
+        } else {
+            request.command = write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+        }
+
+        res = ahci_submit(port, &request);
+        if (res != ALL_OK) {
+            goto out;
+        }
+
+        lba += count;
+        total -= count;
+        data += count * AHCI_SECTOR_SIZE;
+    }
+
+out:
+    if (bounce) {
+        if (!write && res == ALL_OK) {
+            memcpy(buffer, bounce, data - bounce);
+        }
+        kfree(bounce);
+    }
+
+    return res;
+}
+
+static void ahci_interrupt_handler(int interrupt, const struct interrupt_frame *frame)
+{
+    const uint32_t pending = ahci_hba->interrupt_status;
+
+    for (int i = 0; i < AHCI_MAX_PORTS; i++) {
+        if (!(pending & 1U << i) || !ahci_ports[i]) {
+            continue;
+        }
+
+        spin_lock(&ahci_ports[i]->lock);
+        ahci_port_complete(ahci_ports[i]);
+        spin_unlock(&ahci_ports[i]->lock);
+    }
+
+    // Port interrupts are cleared first, or the HBA raises the interrupt again
+    ahci_hba->interrupt_status = pending;
+}
+
+/// @brief Give the port its command list, FIS receive area and command tables, and start it
+static struct ahci_port *ahci_port_init(const int number, const int slots)
+{
+    volatile struct ahci_port_registers *registers = &ahci_hba->ports[number];
+
+    struct ahci_port *port = kzalloc(sizeof(struct ahci_port));
+    port->number           = number;
+    port->registers        = registers;
+    port->slots            = slots;
+    spinlock_init(&port->lock, "ahci");
+    wait_queue_init(&port->waiters);
+
+    ahci_port_stop(registers);
+
+    // One heap block is page aligned, more than the 1 KiB and 256 byte alignments both areas need
+    port->command_list = kzalloc(PAGING_PAGE_SIZE);
+    port->tables       = kzalloc(AHCI_MAX_SLOTS * sizeof(struct ahci_command_table));
+
+    registers->command_list       = ahci_physical(port->command_list);
+    registers->command_list_upper = 0;
+    registers->fis                = ahci_physical((uint8_t *)port->command_list + 1024);
+    registers->fis_upper          = 0;
+
+    for (int slot = 0; slot < AHCI_MAX_SLOTS; slot++) {
+        port->command_list[slot].table       = ahci_physical(&port->tables[slot]);
+        port->command_list[slot].table_upper = 0;
+    }
+
+    registers->sata_error       = 0xFFFF'FFFF;
+    registers->interrupt_status = 0xFFFF'FFFF;
+    registers->interrupt_enable = AHCI_PORT_IE;
+
+    ahci_port_start(registers);
+
+    return port;
+}
+
+/// @brief Identify the drive on the port and register it as a disk
+static void ahci_port_probe(struct ahci_port *port, const bool hba_ncq)
+{
+    uint16_t identify[AHCI_SECTOR_SIZE / 2];
+    struct ahci_request request = {
+        .command = ATA_CMD_IDENTIFY,
+        .buffer  = identify,
+        .size    = sizeof(identify),
+    };
+
+    if (ahci_submit(port, &request) != ALL_OK) {
+        warningf("AHCI port %d: identify failed\n", port->number);
+        return;
+    }
+
+    // Word 83 bit 10: 48-bit addresses
+    if (!(identify[83] & 1U << 10)) {
+        warningf("AHCI port %d: the drive does not support LBA48\n", port->number);
+        return;
+    }
+
+    // Words 100 to 103 hold the 48-bit sector count, disks are addressed with 32 bits
+    const bool huge        = identify[102] || identify[103];
+    const uint32_t sectors = huge ? 0xFFFF'FFFF : identify[100] | (uint32_t)identify[101] << 16;
+
+    // Word 76 bit 8: native command queuing, word 75: queue depth minus one
+    if (hba_ncq && identify[76] & 1U << 8) {
+        const int depth = (identify[75] & 0x1F) + 1;
+        port->ncq       = true;
+        port->slots     = depth < port->slots ? depth : port->slots;
+    } else {
+        port->slots = 1;
+    }
+
+    printf("[ " KBGRN "OK" KWHT " ] ");
+    printf("AHCI port %d: %s, queue depth %d\n", port->number, port->ncq ? "NCQ" : "no NCQ", port->slots);
+
+    disk_register("ahci", &ahci_disk_operations, port, AHCI_SECTOR_SIZE, sectors);
+}
+
+static int ahci_disk_read(const struct disk *disk, const uint32_t lba, const int total, void *buffer)
+{
+    return ahci_transfer(disk->private, lba, total, buffer, false);
+}
+
+static int ahci_disk_write(const struct disk *disk, const uint32_t lba, const int total, void *buffer)
+{
+    return ahci_transfer(disk->private, lba, total, buffer, true);
+}
+
+static int ahci_disk_flush(const struct disk *disk)
+{
+    return ahci_flush(disk->private);
+}
+
+static const struct disk_operations ahci_disk_operations = {
+    .read  = ahci_disk_read,
+    .write = ahci_disk_write,
+    .flush = ahci_disk_flush,
+};
+
+void ahci_init(struct pci_device *device)
+{
+    if (device->header.prog_if != AHCI_PROG_IF || ahci_hba) {
+        return;
+    }
+
+    // BAR5 holds the HBA registers, physical memory is identity mapped
+    const uint32_t abar = device->header.bars[5];
+    if ((abar & 0x1) != PCI_BAR_MEM) {
+        return;
+    }
+
+    ahci_hba = (volatile struct ahci_hba_registers *)(abar & ~0xF);
+    pci_enable_bus_mastering(device);
+
+    ahci_hba->global_control |= AHCI_GHC_AHCI_ENABLE;
+
+    const uint32_t capabilities = ahci_hba->capabilities;
+    const uint32_t implemented  = ahci_hba->ports_implemented;
+
+    idt_register_interrupt_callback(IRQ0 + device->header.irq, ahci_interrupt_handler);
+
+    for (int i = 0; i < AHCI_MAX_PORTS; i++) {
+        if (!(implemented & 1U << i)) {
+            continue;
+        }
+
+        const uint32_t status = ahci_hba->ports[i].sata_status;
+        if ((status & 0xF) != AHCI_SSTS_DET_PRESENT || (status >> 8 & 0xF) != AHCI_SSTS_IPM_ACTIVE) {
+            continue;
+        }
+
+        // ATAPI drives, port multipliers and enclosures are not disks
+        if (ahci_hba->ports[i].signature != AHCI_SIGNATURE_ATA) {
+            continue;
+        }
+
+        ahci_ports[i] = ahci_port_init(i, AHCI_CAP_SLOTS(capabilities));
+    }
+
+    ahci_hba->interrupt_status = 0xFFFF'FFFF;
+    ahci_hba->global_control |= AHCI_GHC_INTERRUPT_ENABLE;
+
+    // The identify commands are polled, there are no threads yet
+    for (int i = 0; i < AHCI_MAX_PORTS; i++) {
+        if (ahci_ports[i]) {
+            ahci_port_probe(ahci_ports[i], capabilities & AHCI_CAP_NCQ);
+        }
+    }
+}
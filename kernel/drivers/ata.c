@@ -1,138 +1,586 @@
+#include <assert.h>
 #include <ata.h>
+#include <disk.h>
+#include <idt.h>
 #include <io.h>
 #include <kernel.h>
+#include <kernel_heap.h>
+#include <list.h>
+#include <paging.h>
+#include <pci.h>
+#include <scheduler.h>
+#include <serial.h>
+#include <softirq.h>
 #include <spinlock.h>
 #include <status.h>
+#include <thread.h>
+#include <wait_queue.h>
+#include <x86.h>
 
-#define ATA_PRIMARY_IO 0x1F0                    // Primary IO port
-#define ATA_REG_DEVSEL 0x1F6                    // Device/Head register
-#define ATA_REG_STATUS 0x1F7                    // Status register
-#define ATA_REG_CMD 0x1F7                       // Status register
-#define ATA_REG_SEC_COUNT 0x1F2                 // Sector count register
-#define ATA_REG_LBA0 0x1F3                      // LBA low register
-#define ATA_REG_LBA1 0x1F4                      // LBA mid register
-#define ATA_REG_LBA2 0x1F5                      // LBA high register
-#define ATA_REG_FEATURES 0x1F1                  // Features register
-#define ATA_REG_CONTROL (ATA_PRIMARY_IO + 0x0C) // Control register
-#define ATA_REG_DATA ATA_PRIMARY_IO             // Data register
+// https://wiki.osdev.org/ATA_PIO_Mode
+// https://wiki.osdev.org/ATA/ATAPI_using_DMA
+
+#define ATA_PRIMARY_IO 0x1F0     // Primary IO port
+#define ATA_REG_DEVSEL 0x1F6     // Device/Head register
+#define ATA_REG_STATUS 0x1F7     // Status register, reading it acknowledges the interrupt
+#define ATA_REG_CMD 0x1F7        // Status register
+#define ATA_REG_SEC_COUNT 0x1F2  // Sector count register
+#define ATA_REG_LBA0 0x1F3       // LBA low register
+#define ATA_REG_LBA1 0x1F4       // LBA mid register
+#define ATA_REG_LBA2 0x1F5       // LBA high register
+#define ATA_REG_FEATURES 0x1F1   // Features register
+#define ATA_REG_CONTROL 0x3F6    // Device control register when written
+#define ATA_REG_ALT_STATUS 0x3F6 // Status register when read, without acknowledging the interrupt
+#define ATA_REG_DATA ATA_PRIMARY_IO
+
+#define ATA_IRQ 0x2E // IRQ 14, the primary channel
 
 #define ATA_CMD_IDENTIFY 0xEC    // Identify drive
 #define ATA_CMD_CACHE_FLUSH 0xE7 // Flush cache
 #define ATA_CMD_READ_PIO 0x20    // Read PIO
 #define ATA_CMD_WRITE_PIO 0x30   // Write PIO
+#define ATA_CMD_READ_DMA 0xC8    // Read DMA
+#define ATA_CMD_WRITE_DMA 0xCA   // Write DMA
 
 #define ATA_STATUS_ERR 0x01   // Error bit
 #define ATA_STATUS_DRQ 0x08   // Data request bit
-#define ATA_STATUS_BUSY 0x80  // Busy bit
 #define ATA_STATUS_FAULT 0x20 // Drive fault bit
+#define ATA_STATUS_BUSY 0x80  // Busy bit
 
 #define ATA_MASTER 0xE0 // Select master drive
 #define ATA_SLAVE 0xF0  // Select slave drive
 
-spinlock_t disk_lock = 0;
+#define ATA_SECTOR_SIZE 512
+// A sector count of 0 means 256 sectors
+#define ATA_MAX_SECTORS 256
+
+// Bus master registers of the primary channel, relative to BAR4 of the IDE controller
+#define ATA_BM_COMMAND 0x00
+#define ATA_BM_STATUS 0x02
+#define ATA_BM_PRDT 0x04
+
+#define ATA_BM_COMMAND_START 0x01
+#define ATA_BM_COMMAND_READ 0x08 // The controller writes to memory
+#define ATA_BM_STATUS_ERROR 0x02 // Write 1 to clear
+#define ATA_BM_STATUS_IRQ 0x04   // The drive raised its interrupt, write 1 to clear
+
+// Set in the last entry of the PRD table
+#define ATA_PRD_END 0x8000
+// A 256 sector transfer spans at most this many pages
+#define ATA_PRD_ENTRIES (ATA_MAX_SECTORS * ATA_SECTOR_SIZE / PAGING_PAGE_SIZE + 1)
+#define ATA_PRD_MAX_SIZE 0x10000
+
+/// @brief Physical Region Descriptor, one physically contiguous piece of a DMA transfer
+struct ata_prd {
+    uint32_t address;
+    /// Bytes in the region, 0 means 64 KiB
+    uint16_t size;
+    uint16_t flags;
+} __attribute__((packed));
+
+enum ATA_REQUEST_STATE {
+    ATA_REQUEST_QUEUED,
+    /// The command was sent, the drive interrupts once per sector
+    ATA_REQUEST_TRANSFER,
+    /// Waiting for the drive to flush its cache
+    ATA_REQUEST_FLUSH,
+    ATA_REQUEST_DONE,
+};
+
+/// @brief A transfer on the primary channel. It lives on the stack of the thread that submitted it
+struct ata_request {
+    uint32_t lba;
+    int total;
+    uint8_t *buffer;
+    bool write;
+    /// Flush the write cache of the drive instead of moving sectors
+    bool flush;
+    /// Moved by the bus master instead of the CPU
+    bool dma;
+    /// Sectors moved so far
+    int done;
+    int result;
+    enum ATA_REQUEST_STATE state;
+    struct list_elem elem;
+};
 
-int ata_get_sector_size()
+/// Requests in submission order. The one at the front owns the drive
+static struct list ata_queue;
+/// Protects the queue, it is also taken by the interrupt handler
+static spinlock_t ata_lock = SPINLOCK_INITIALIZER("ata");
+/// Submitters sleep here, keyed by their request
+static struct wait_queue ata_waiters;
+
+/// I/O base of the bus master registers, 0 when every transfer goes through PIO
+static uint16_t ata_bm_base;
+/// Describes the buffer of the request that owns the drive. A table must not cross a 64 KiB boundary
+static struct ata_prd *ata_prdt;
+
+static void ata_interrupt_handler(int interrupt, const struct interrupt_frame *frame);
+static uint32_t ata_identify(void);
+static const struct disk_operations ata_disk_operations;
+
+/// @brief Register the master drive of the primary channel as a disk, if there is one
+void ata_init()
 {
-    return 512;
+    list_init(&ata_queue);
+    wait_queue_init(&ata_waiters);
+
+    const uint32_t sectors = ata_identify();
+
+    idt_register_interrupt_callback(ATA_IRQ, ata_interrupt_handler);
+    // Let the drive raise IRQ 14
+    outb(ATA_REG_CONTROL, 0x00);
+
+    if (sectors) {
+        disk_register("ata", &ata_disk_operations, nullptr, ATA_SECTOR_SIZE, sectors);
+    }
 }
 
-int ata_wait_for_ready()
+/// @brief Set up bus master DMA on the IDE controller found by pci_scan(), which runs before ata_init()
+void ata_pci_init(struct pci_device *device)
 {
-    // Ignore the first four status reads
-    inb(ATA_REG_STATUS);
-    inb(ATA_REG_STATUS);
-    inb(ATA_REG_STATUS);
-    inb(ATA_REG_STATUS);
+#if ATA_DMA
+    // Bit 7 of the programming interface: the controller can be a bus master
+    if (!(device->header.prog_if & 0x80)) {
+        return;
+    }
+
+    const uint32_t bar = device->header.bars[4];
+    if ((bar & 0x1) != PCI_BAR_IO) {
+        return;
+    }
+
+    // One heap block is page aligned and much larger than the table, so it never crosses 64 KiB
+    ata_prdt = kzalloc(ATA_PRD_ENTRIES * sizeof(struct ata_prd));
+    pci_enable_bus_mastering(device);
+
+    // The primary channel uses the first 8 ports
+    ata_bm_base = bar & 0xFFFC;
+#endif
+}
+
+/// @brief Give the drive the 400ns it needs to update the status after a command or a sector
+static void ata_delay()
+{
+    inb(ATA_REG_ALT_STATUS);
+    inb(ATA_REG_ALT_STATUS);
+    inb(ATA_REG_ALT_STATUS);
+    inb(ATA_REG_ALT_STATUS);
+}
+
+static int ata_wait_for_ready()
+{
+    ata_delay();
+
+    uint8_t status = inb(ATA_REG_ALT_STATUS);
+    while (status & ATA_STATUS_BUSY) {
+        pause();
+        status = inb(ATA_REG_ALT_STATUS);
+    }
+
+    if (status & ATA_STATUS_ERR || status & ATA_STATUS_FAULT) {
+        warningf("ATA drive fault, status %#x\n", status);
+        return -EIO;
+    }
+
+    return ALL_OK;
+}
+
+/// @brief Ask the master drive who it is, with interrupts still off on the drive
+/// @return the number of sectors, 0 if there is no ATA drive
+static uint32_t ata_identify()
+{
+    outb(ATA_REG_DEVSEL, ATA_MASTER);
+    ata_delay();
+    outb(ATA_REG_SEC_COUNT, 0);
+    outb(ATA_REG_LBA0, 0);
+    outb(ATA_REG_LBA1, 0);
+    outb(ATA_REG_LBA2, 0);
+    outb(ATA_REG_CMD, ATA_CMD_IDENTIFY);
+    ata_delay();
 
     uint8_t status = inb(ATA_REG_STATUS);
+    // Nothing on the channel, or a floating bus
+    if (status == 0x00 || status == 0xFF) {
+        return 0;
+    }
 
-    // Wait for the BUSY bit to clear or the DRQ bit to be set
-    while ((status & ATA_STATUS_BUSY) && !(status & ATA_STATUS_DRQ)) {
-        if (status & ATA_STATUS_ERR || status & ATA_STATUS_FAULT) {
-            panic("Error: Drive fault\n");
-            spin_unlock(&disk_lock);
-            return -EIO;
-        }
+    while (status & ATA_STATUS_BUSY) {
+        pause();
+        status = inb(ATA_REG_STATUS);
+    }
 
+    // ATAPI and SATA devices leave their signature in the LBA registers
+    if (inb(ATA_REG_LBA1) || inb(ATA_REG_LBA2)) {
+        return 0;
+    }
+
+    while (!(status & (ATA_STATUS_DRQ | ATA_STATUS_ERR))) {
+        pause();
         status = inb(ATA_REG_STATUS);
     }
-    return ALL_OK;
+
+    if (status & ATA_STATUS_ERR) {
+        return 0;
+    }
+
+    uint16_t identify[ATA_SECTOR_SIZE / 2];
+    for (int i = 0; i < ATA_SECTOR_SIZE / 2; i++) {
+        identify[i] = inw(ATA_REG_DATA);
+    }
+
+    // Words 60 and 61 hold the number of sectors addressable with LBA28
+    return identify[60] | (uint32_t)identify[61] << 16;
 }
 
-int ata_read_sectors(const uint32_t lba, const int total, void *buffer)
+static void ata_read_data(struct ata_request *request)
 {
-    spin_lock(&disk_lock);
-    outb(ATA_REG_CONTROL, 0x02); // Disable interrupts. We are polling.
+    auto ptr = (uint16_t *)(request->buffer + request->done * ATA_SECTOR_SIZE);
+    for (int i = 0; i < ATA_SECTOR_SIZE / 2; i++) {
+        ptr[i] = inw(ATA_REG_DATA);
+    }
+    request->done++;
+}
 
-    outb(ATA_REG_DEVSEL, (lba >> 24 & 0x0F) | ATA_MASTER);
-    outb(ATA_REG_SEC_COUNT, total); // Number of sectors to read
-    outb(ATA_REG_LBA0, lba & 0xFF);
-    outb(ATA_REG_LBA1, lba >> 8);
-    outb(ATA_REG_LBA2, lba >> 16);
-    outb(ATA_REG_CMD, ATA_CMD_READ_PIO);
+static void ata_write_data(struct ata_request *request)
+{
+    const uint8_t *ptr = request->buffer + request->done * ATA_SECTOR_SIZE;
+    for (int i = 0; i < ATA_SECTOR_SIZE; i += 2) {
+        // Handle potential unaligned access
+        const uint16_t word = ptr[i] | (uint16_t)ptr[i + 1] << 8;
+        outw(ATA_REG_DATA, word);
+        // Tiny delay between writes
+        asm volatile("nop; nop; nop;");
+    }
+    request->done++;
+}
 
-    auto ptr = (uint16_t *)buffer;
-    for (int b = 0; b < total; b++) {
-        const int result = ata_wait_for_ready();
-        if (result != ALL_OK) {
-            return result;
-        }
-        // Read sector
-        for (int i = 0; i < 256; i++) {
-            ptr[i] = inw(ATA_PRIMARY_IO);
+/// @brief Describe the buffer of the request in the PRD table, page by page, merging physically contiguous pages
+/// @return false if the buffer cannot be transferred with DMA
+static bool ata_build_prdt(const struct ata_request *request)
+{
+    // The controller needs even addresses
+    if ((uint32_t)request->buffer & 1) {
+        return false;
+    }
+
+    auto address       = (uint32_t)request->buffer;
+    uint32_t remaining = request->total * ATA_SECTOR_SIZE;
+    int count          = 0;
+
+    while (remaining > 0) {
+        const uint32_t physical  = (uint32_t)paging_get_physical_address(kernel_page_directory, (void *)address);
+        const uint32_t page_left = PAGING_PAGE_SIZE - address % PAGING_PAGE_SIZE;
+        const uint32_t size      = remaining < page_left ? remaining : page_left;
+
+        struct ata_prd *last     = count ? &ata_prdt[count - 1] : nullptr;
+        const uint32_t last_size = last ? (last->size ? last->size : ATA_PRD_MAX_SIZE) : 0;
+
+        // A region must not cross a 64 KiB boundary
+        if (last && last->address + last_size == physical && physical % ATA_PRD_MAX_SIZE != 0 &&
+            last_size + size <= ATA_PRD_MAX_SIZE) {
+            last->size = (uint16_t)(last_size + size);
+        } else {
+            if (count == ATA_PRD_ENTRIES) {
+                return false;
+            }
+            ata_prdt[count++] = (struct ata_prd){.address = physical, .size = (uint16_t)size};
         }
-        ptr += 256; // Advance the buffer 256 words (512 bytes)
+
+        address += size;
+        remaining -= size;
     }
 
-    spin_unlock(&disk_lock);
+    ata_prdt[count - 1].flags = ATA_PRD_END;
+    return true;
+}
 
-    return ALL_OK;
+/// @brief Point the bus master at the PRD table, it starts once the drive got the command
+static void ata_dma_prepare(const struct ata_request *request)
+{
+    outl(ata_bm_base + ATA_BM_PRDT, (uint32_t)paging_get_physical_address(kernel_page_directory, ata_prdt));
+    outb(ata_bm_base + ATA_BM_COMMAND, request->write ? 0 : ATA_BM_COMMAND_READ);
+
+    const uint8_t status = inb(ata_bm_base + ATA_BM_STATUS);
+    outb(ata_bm_base + ATA_BM_STATUS, status | ATA_BM_STATUS_ERROR | ATA_BM_STATUS_IRQ);
+}
+
+/// @brief Stop the bus master once the drive raised its interrupt
+/// @return false while the transfer is still running
+static bool ata_dma_finish(struct ata_request *request)
+{
+    const uint8_t status = inb(ata_bm_base + ATA_BM_STATUS);
+    if (!(status & ATA_BM_STATUS_IRQ)) {
+        return false;
+    }
+
+    outb(ata_bm_base + ATA_BM_COMMAND, 0);
+    outb(ata_bm_base + ATA_BM_STATUS, status | ATA_BM_STATUS_ERROR | ATA_BM_STATUS_IRQ);
+
+    if (status & ATA_BM_STATUS_ERROR) {
+        warningf("ATA DMA %s at sector %lu failed\n", request->write ? "write" : "read", request->lba);
+        request->result = -EIO;
+    }
+
+    return true;
+}
+
+static uint8_t ata_command(const struct ata_request *request)
+{
+    if (request->dma) {
+        return request->write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA;
+    }
+
+    return request->write ? ATA_CMD_WRITE_PIO : ATA_CMD_READ_PIO;
 }
 
-int ata_write_sectors(const uint32_t lba, const int total, void *buffer)
+/// @brief Send the command of the request at the front of the queue
+static void ata_issue(struct ata_request *request)
 {
-    spin_lock(&disk_lock);
+    request->state = request->flush ? ATA_REQUEST_FLUSH : ATA_REQUEST_TRANSFER;
+    // Buffers the PRD table cannot describe fall back to PIO
+    request->dma = !request->flush && ata_bm_base && ata_build_prdt(request);
+
+    int res = ata_wait_for_ready();
+    if (res != ALL_OK) {
+        goto out;
+    }
 
-    outb(ATA_REG_CONTROL, 0x02); // Disable interrupts. We are polling.
+    outb(ATA_REG_DEVSEL, (request->lba >> 24 & 0x0F) | ATA_MASTER);
+    res = ata_wait_for_ready();
+    if (res != ALL_OK) {
+        goto out;
+    }
 
-    int result = ata_wait_for_ready();
-    if (result != ALL_OK) {
-        return result;
+    if (request->flush) {
+        outb(ATA_REG_CMD, ATA_CMD_CACHE_FLUSH);
+        goto out;
     }
 
-    outb(ATA_REG_DEVSEL, (lba >> 24 & 0x0F) | ATA_MASTER);
-    ata_wait_for_ready();
     outb(ATA_REG_FEATURES, 0);
-    outb(ATA_REG_SEC_COUNT, total); // Number of sectors to write
-    outb(ATA_REG_LBA0, lba & 0xFF);
-    outb(ATA_REG_LBA1, lba >> 8);
-    outb(ATA_REG_LBA2, lba >> 16);
-    outb(ATA_REG_CMD, ATA_CMD_WRITE_PIO);
-
-    result = ata_wait_for_ready();
-    if (result != ALL_OK) {
-        return result;
-    }
-
-    auto ptr = (char *)buffer;
-    for (int b = 0; b < total; b++) {
-        // Write the sector
-        for (int i = 0; i < 512; i += 2) {
-            // Handle potential unaligned access
-            uint16_t word = (uint8_t)ptr[i];
-            if (i + 1 < 512) {
-                word |= (uint16_t)(ptr[i + 1]) << 8;
+    outb(ATA_REG_SEC_COUNT, (uint8_t)request->total);
+    outb(ATA_REG_LBA0, request->lba & 0xFF);
+    outb(ATA_REG_LBA1, request->lba >> 8);
+    outb(ATA_REG_LBA2, request->lba >> 16);
+    if (request->dma) {
+        ata_dma_prepare(request);
+        outb(ATA_REG_CMD, ata_command(request));
+        outb(ata_bm_base + ATA_BM_COMMAND, (request->write ? 0 : ATA_BM_COMMAND_READ) | ATA_BM_COMMAND_START);
+        goto out;
+    }
+
+    outb(ATA_REG_CMD, ata_command(request));
+
+    if (request->write) {
+        // The drive asks for the first sector without interrupting, the next ones follow its interrupts
+        res = ata_wait_for_ready();
+        if (res != ALL_OK) {
+            goto out;
+        }
+        ata_write_data(request);
+    }
+
+out:
+    if (res != ALL_OK) {
+        request->result = res;
+        request->state  = ATA_REQUEST_DONE;
+    }
+}
+
+/// @brief Move the request along after the drive signalled it is no longer busy
+/// @return true once the request is finished
+static bool ata_advance(struct ata_request *request, const uint8_t status)
+{
+    if (status & ATA_STATUS_ERR || status & ATA_STATUS_FAULT) {
+        warningf("ATA %s of sector %lu failed, status %#x\n",
+                 request->flush ? "flush" : request->write ? "write" : "read",
+                 request->lba + request->done,
+                 status);
+        if (request->dma && request->state == ATA_REQUEST_TRANSFER) {
+            outb(ata_bm_base + ATA_BM_COMMAND, 0);
+        }
+        request->result = -EIO;
+        request->state  = ATA_REQUEST_DONE;
+        return true;
+    }
+
+    switch (request->state) {
+    case ATA_REQUEST_TRANSFER:
+        if (request->dma) {
+            // The whole transfer raises a single interrupt
+            if (!ata_dma_finish(request)) {
+                return false;
             }
-            outw(ATA_PRIMARY_IO, word);
-            // Tiny delay between writes
-            asm volatile("nop; nop; nop;");
+            request->done  = request->total;
+            request->state = ATA_REQUEST_DONE;
+        } else if (!request->write) {
+            if (!(status & ATA_STATUS_DRQ)) {
+                return false;
+            }
+            ata_read_data(request);
+            if (request->done == request->total) {
+                request->state = ATA_REQUEST_DONE;
+            }
+        } else if (request->done < request->total) {
+            ata_write_data(request);
+        } else {
+            // The data is in the drive cache, it reaches the medium at the next flush
+            request->state = ATA_REQUEST_DONE;
         }
-        outb(ATA_REG_CMD, ATA_CMD_CACHE_FLUSH);
-        ata_wait_for_ready();
-        ptr += 512; // Advance the buffer 512 bytes (one sector)
+        break;
+
+    case ATA_REQUEST_FLUSH:
+        request->state = ATA_REQUEST_DONE;
+        break;
+
+    default:
+        break;
     }
 
-    spin_unlock(&disk_lock);
+    return request->state == ATA_REQUEST_DONE;
+}
+
+/// @brief Take the finished request off the queue, wake its submitter and start the next one
+/// @warning ata_lock must be held
+static void ata_complete(struct ata_request *request)
+{
+    list_remove(&request->elem);
+    wait_queue_wake_keyed(&ata_waiters, (uintptr_t)request, 1);
 
-    return 0;
+    // A request that fails to start is finished right away
+    while (!list_empty(&ata_queue)) {
+        auto const next = list_entry(list_front(&ata_queue), struct ata_request, elem);
+        ata_issue(next);
+        if (next->state != ATA_REQUEST_DONE) {
+            break;
+        }
+        list_remove(&next->elem);
+        wait_queue_wake_keyed(&ata_waiters, (uintptr_t)next, 1);
+    }
 }
+
+static void ata_interrupt_handler(int interrupt, const struct interrupt_frame *frame)
+{
+    // Reading the status register acknowledges the interrupt on the drive
+    const uint8_t status = inb(ATA_REG_STATUS);
+    if (status & ATA_STATUS_BUSY) {
+        return;
+    }
+
+    spin_lock(&ata_lock);
+    if (!list_empty(&ata_queue)) {
+        auto const request = list_entry(list_front(&ata_queue), struct ata_request, elem);
+        if (ata_advance(request, status)) {
+            ata_complete(request);
+        }
+    }
+    spin_unlock(&ata_lock);
+}
+
+/// @brief Drive a request without interrupts, for when there is no thread to put to sleep
+static void ata_poll(struct ata_request *request)
+{
+    while (request->state != ATA_REQUEST_DONE) {
+        ata_delay();
+        const uint8_t status = inb(ATA_REG_STATUS);
+        if (status & ATA_STATUS_BUSY) {
+            pause();
+            continue;
+        }
+
+        const uint32_t flags = spin_lock_irqsave(&ata_lock);
+        if (ata_advance(request, status)) {
+            ata_complete(request);
+        }
+        spin_unlock_irqrestore(&ata_lock, flags);
+    }
+}
+
+/// @brief Queue the request and wait until the drive is done with it
+static int ata_submit(struct ata_request *request)
+{
+    auto const thread = scheduler_get_current_thread();
+    // Before the scheduler starts, there is nobody to put to sleep
+    const bool can_sleep = thread && !softirq_is_running();
+
+    const uint32_t flags = spin_lock_irqsave(&ata_lock);
+    ASSERT(can_sleep || list_empty(&ata_queue), "Polling behind queued requests");
+
+    request->state = ATA_REQUEST_QUEUED;
+    list_push_back(&ata_queue, &request->elem);
+    if (list_front(&ata_queue) == &request->elem) {
+        ata_issue(request);
+        if (request->state == ATA_REQUEST_DONE) {
+            ata_complete(request);
+        }
+    }
+    spin_unlock_irqrestore(&ata_lock, flags);
+
+    if (!can_sleep) {
+        ata_poll(request);
+        return request->result;
+    }
+
+    // The request lives on this stack, the thread must not be torn down before the drive is done with it
+    thread->uninterruptible++;
+    while (request->state != ATA_REQUEST_DONE) {
+        // Interrupts are off, the completion cannot slip in between the check and the sleep
+        wait_queue_sleep_keyed(&ata_waiters, (uintptr_t)request);
+    }
+    thread->uninterruptible--;
+
+    return request->result;
+}
+
+static int ata_transfer(uint32_t lba, int total, uint8_t *buffer, const bool write)
+{
+    while (total > 0) {
+        const int count = total < ATA_MAX_SECTORS ? total : ATA_MAX_SECTORS;
+
+        struct ata_request request = {
+            .lba    = lba,
+            .total  = count,
+            .buffer = buffer,
+            .write  = write,
+            .result = ALL_OK,
+        };
+
+        const int res = ata_submit(&request);
+        if (res != ALL_OK) {
+            return res;
+        }
+
+        lba += count;
+        total -= count;
+        buffer += count * ATA_SECTOR_SIZE;
+    }
+
+    return ALL_OK;
+}
+
+static int ata_disk_read(const struct disk *disk, const uint32_t lba, const int total, void *buffer)
+{
+    return ata_transfer(lba, total, buffer, false);
+}
+
+static int ata_disk_write(const struct disk *disk, const uint32_t lba, const int total, void *buffer)
+{
+    return ata_transfer(lba, total, buffer, true);
+}
+
+static int ata_disk_flush(const struct disk *disk)
+{
+    struct ata_request request = {
+        .flush  = true,
+        .result = ALL_OK,
+    };
+
+    return ata_submit(&request);
+}
+
+static const struct disk_operations ata_disk_operations = {
+    .read  = ata_disk_read,
+    .write = ata_disk_write,
+    .flush = ata_disk_flush,
+};
@@ -8,9 +8,13 @@
 #include <net/network.h>
 #include <printf.h>
 #include <serial.h>
+#include <softirq.h>
 #include <vga_buffer.h>
+#include <x86.h>
 
 #define IRQ0 0x20
+// Packets processed per network softirq run
+#define E1000_RX_BUDGET 32
 
 
 void e1000_receive();
@@ -208,18 +212,19 @@ void e1000_interrupt_handler(int interrupt, const struct interrupt_frame *frame)
         // - Bit 6 (0x40): Receive Timer Interrupt (RXT0) - Indicates that the receive timer has expired.
         // - Bit 7 (0x80): Receive Descriptor Written Back (RXO) - Indicates that a receive descriptor has been
         // written back.
+        // Reading ICR acknowledges the interrupt. The packets are processed later, in the network softirq.
         const uint32_t status = e1000_read_command(REG_ICR);
         if (status & E1000_LSC) {
             e1000_linkup();
         } else if (status & E1000_RXDMT0) {
             // triggered when the number of packets in the receive buffer is above the minimum threshold
-            e1000_receive();
+            softirq_raise(SOFTIRQ_NET_RX);
         } else if (status & E1000_RX0) {
             // triggered as soon as any packet is received
-            e1000_receive();
+            softirq_raise(SOFTIRQ_NET_RX);
         } else if (status & E1000_RXT0) {
             // triggered when a packet has been sitting in the receive buffer for a certain amount of time
-            e1000_receive();
+            softirq_raise(SOFTIRQ_NET_RX);
         }
 
         e1000_write_command(REG_IMS, E1000_IMS_ENABLE_MASK);
@@ -252,6 +257,7 @@ bool e1000_start()
     for (int i = 0; i < 0x80; i++)
         e1000_write_command(REG_MTA + i * 4, 0);
 
+    softirq_register(SOFTIRQ_NET_RX, "net_rx", e1000_receive);
     if (idt_register_interrupt_callback(IRQ0 + pci_device->header.irq, e1000_interrupt_handler) == 0) {
         e1000_enable_interrupt();
         e1000_rx_init();
@@ -263,10 +269,19 @@ bool e1000_start()
     return false;
 }
 
-/// @brief Process all available packets in the receive ring
+/// @brief Network softirq, processes the packets in the receive ring. At most E1000_RX_BUDGET packets are processed
+/// per run, if there are more the softirq is raised again instead of draining the whole ring at once.
 void e1000_receive()
 {
+    int budget = E1000_RX_BUDGET;
     while ((rx_descs[rx_cur]->status & E1000_RXD_STAT_DD)) {
+        if (budget-- == 0) {
+            cli();
+            softirq_raise(SOFTIRQ_NET_RX);
+            sti();
+            return;
+        }
+
         auto const buf     = (uint8_t *)(uint32_t)rx_descs[rx_cur]->addr;
         const uint16_t len = rx_descs[rx_cur]->length;
 
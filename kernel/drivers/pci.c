@@ -1,9 +1,12 @@
+#include <ahci.h>
+#include <ata.h>
 #include <e1000.h>
 #include <io.h>
 #include <kernel_heap.h>
 #include <pci.h>
 #include <printf.h>
 #include <vga_buffer.h>
+#include <virtio_blk.h>
 
 // https://wiki.osdev.org/PCI
 
@@ -141,9 +144,12 @@ struct pci_vendor vendors[] = {
 };
 
 struct pci_driver pci_drivers[] = {
-    {.class = 0x02, .subclass = 0x00, .vendor_id = INTEL_VEND, .device_id = E1000_DEV,     .init = &e1000_init},
-    {.class = 0x02, .subclass = 0x00, .vendor_id = INTEL_VEND, .device_id = E1000_I217,    .init = &e1000_init},
-    {.class = 0x02, .subclass = 0x00, .vendor_id = INTEL_VEND, .device_id = E1000_82577LM, .init = &e1000_init},
+    {.class = 0x02, .subclass = 0x00, .vendor_id = INTEL_VEND,  .device_id = E1000_DEV,      .init = &e1000_init     },
+    {.class = 0x02, .subclass = 0x00, .vendor_id = INTEL_VEND,  .device_id = E1000_I217,     .init = &e1000_init     },
+    {.class = 0x02, .subclass = 0x00, .vendor_id = INTEL_VEND,  .device_id = E1000_82577LM,  .init = &e1000_init     },
+    {.class = 0x01, .subclass = 0x01, .vendor_id = PCI_ANY_ID,  .device_id = PCI_ANY_ID,     .init = &ata_pci_init   },
+    {.class = 0x01, .subclass = 0x06, .vendor_id = PCI_ANY_ID,  .device_id = PCI_ANY_ID,     .init = &ahci_init      },
+    {.class = 0x01, .subclass = 0x00, .vendor_id = VIRTIO_VEND, .device_id = VIRTIO_BLK_DEV, .init = &virtio_blk_init},
 };
 
 uint16_t pci_config_read_word(const uint8_t bus, const uint8_t slot, const uint8_t func, const uint8_t offset)
@@ -213,8 +219,10 @@ const char *pci_find_vendor(const uint16_t vendor_id)
 void load_driver(const struct pci_header pci, const uint8_t bus, const uint8_t device, const uint8_t function)
 {
     for (uint16_t i = 0; i < sizeof(pci_drivers) / sizeof(struct pci_driver); i++) {
-        if (pci_drivers[i].class == pci.class && pci_drivers[i].subclass == pci.subclass &&
-            pci_drivers[i].vendor_id == pci.vendor_id && pci_drivers[i].device_id == pci.device_id) {
+        const struct pci_driver *driver = &pci_drivers[i];
+        if (driver->class == pci.class && driver->subclass == pci.subclass &&
+            (driver->vendor_id == PCI_ANY_ID || driver->vendor_id == pci.vendor_id) &&
+            (driver->device_id == PCI_ANY_ID || driver->device_id == pci.device_id)) {
 
             printf("[ " KBGRN "OK" KWHT " ] ");
             printf("Loading driver for %s\n", pci_find_name(pci.class, pci.subclass));
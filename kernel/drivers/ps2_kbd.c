@@ -8,8 +8,8 @@
 #include <spinlock.h>
 #include <string.h>
 
-spinlock_t keyboard_lock         = 0;
-spinlock_t keyboard_getchar_lock = 0;
+spinlock_t keyboard_lock         = SPINLOCK_INITIALIZER("keyboard");
+spinlock_t keyboard_getchar_lock = SPINLOCK_INITIALIZER("keyboard_getchar");
 int ps2_keyboard_init();
 void ps2_keyboard_interrupt_handler(int interrupt, const struct interrupt_frame *frame);
 
@@ -31,21 +31,21 @@ void kbd_led_handling(const unsigned char ledstatus)
 // Taken from xv6
 uint8_t keyboard_get_char()
 {
-    spin_lock(&keyboard_getchar_lock);
+    const uint32_t flags = spin_lock_irqsave(&keyboard_getchar_lock);
 
     static unsigned int shift;
     static uint8_t *charcode[4] = {normalmap, shiftmap, ctlmap, ctlmap};
 
     const unsigned int st = inb(KBD_STATUS_PORT);
     if ((st & KBD_DATA_IN_BUFFER) == 0) {
-        spin_unlock(&keyboard_getchar_lock);
+        spin_unlock_irqrestore(&keyboard_getchar_lock, flags);
         return -1;
     }
     unsigned int data = inb(KBD_DATA_PORT);
 
     if (data == 0xE0) {
         shift |= E0ESC;
-        spin_unlock(&keyboard_getchar_lock);
+        spin_unlock_irqrestore(&keyboard_getchar_lock, flags);
         return 0;
     }
     if (data & 0x80) {
@@ -53,7 +53,7 @@ uint8_t keyboard_get_char()
         // key_released = true;
         data = (shift & E0ESC ? data : data & 0x7F);
         shift &= ~(shiftcode[data] | E0ESC);
-        spin_unlock(&keyboard_getchar_lock);
+        spin_unlock_irqrestore(&keyboard_getchar_lock, flags);
         return 0;
     }
     if (shift & E0ESC) {
@@ -73,14 +73,14 @@ uint8_t keyboard_get_char()
         }
     }
 
-    spin_unlock(&keyboard_getchar_lock);
+    spin_unlock_irqrestore(&keyboard_getchar_lock, flags);
     return c;
 }
 
 int ps2_keyboard_init()
 {
-    spinlock_init(&keyboard_lock);
-    spinlock_init(&keyboard_getchar_lock);
+    spinlock_init(&keyboard_lock, "keyboard");
+    spinlock_init(&keyboard_getchar_lock, "keyboard_getchar");
 
     idt_register_interrupt_callback(ISR_KEYBOARD, ps2_keyboard_interrupt_handler);
 
@@ -94,7 +94,7 @@ int ps2_keyboard_init()
 
 void ps2_keyboard_interrupt_handler(int interrupt, const struct interrupt_frame *frame)
 {
-    spin_lock(&keyboard_lock);
+    const uint32_t flags = spin_lock_irqsave(&keyboard_lock);
 
     pic_acknowledge(interrupt);
 
@@ -106,10 +106,10 @@ void ps2_keyboard_interrupt_handler(int interrupt, const struct interrupt_frame
 
     auto const thread = scheduler_get_thread_sleeping_for_keyboard();
     if (thread) {
-        thread->process->signal = SIGWAKEUP;
+        thread->signal = SIGWAKEUP;
     }
 
-    spin_unlock(&keyboard_lock);
+    spin_unlock_irqrestore(&keyboard_lock, flags);
 }
 
 struct keyboard *ps2_init()
@@ -0,0 +1,490 @@
+#include <assert.h>
+#include <config.h>
+#include <disk.h>
+#include <idt.h>
+#include <io.h>
+#include <kernel.h>
+#include <kernel_heap.h>
+#include <paging.h>
+#include <pci.h>
+#include <printf.h>
+#include <scheduler.h>
+#include <serial.h>
+#include <softirq.h>
+#include <spinlock.h>
+#include <status.h>
+#include <termcolors.h>
+#include <thread.h>
+#include <virtio_blk.h>
+#include <wait_queue.h>
+#include <x86.h>
+
+// https://wiki.osdev.org/Virtio
+// Virtual I/O Device (VIRTIO) Version 1.1, legacy interface
+
+#define IRQ0 0x20
+
+// Legacy registers, in the I/O space of BAR0
+#define VIRTIO_REG_DEVICE_FEATURES 0x00
+#define VIRTIO_REG_GUEST_FEATURES 0x04
+#define VIRTIO_REG_QUEUE_ADDRESS 0x08 // Page frame number of the virtqueue
+#define VIRTIO_REG_QUEUE_SIZE 0x0C
+#define VIRTIO_REG_QUEUE_SELECT 0x0E
+#define VIRTIO_REG_QUEUE_NOTIFY 0x10
+#define VIRTIO_REG_STATUS 0x12
+#define VIRTIO_REG_ISR 0x13 // Reading it acknowledges the interrupt
+#define VIRTIO_REG_CONFIG 0x14
+
+#define VIRTIO_BLK_CONFIG_CAPACITY 0x00 // 64-bit, in 512 byte sectors
+#define VIRTIO_BLK_CONFIG_SEG_MAX 0x0C
+
+#define VIRTIO_STATUS_ACKNOWLEDGE 0x01
+#define VIRTIO_STATUS_DRIVER 0x02
+#define VIRTIO_STATUS_DRIVER_OK 0x04
+#define VIRTIO_STATUS_FAILED 0x80
+
+#define VIRTIO_ISR_QUEUE 0x01
+
+#define VIRTIO_BLK_F_SEG_MAX (1U << 2)
+#define VIRTIO_BLK_F_RO (1U << 5)
+#define VIRTIO_BLK_F_FLUSH (1U << 9)
+
+#define VIRTIO_BLK_T_IN 0
+#define VIRTIO_BLK_T_OUT 1
+#define VIRTIO_BLK_T_FLUSH 4
+#define VIRTIO_BLK_S_OK 0
+
+#define VIRTQ_DESC_F_NEXT 0x1
+#define VIRTQ_DESC_F_WRITE 0x2 // The device writes to the buffer
+#define VIRTQ_ALIGN 4096
+
+#define VIRTIO_BLK_SECTOR_SIZE 512
+#define VIRTIO_BLK_MAX_SECTORS 256
+#define VIRTIO_BLK_MAX_DEVICES 4
+
+struct virtq_desc {
+    uint64_t address;
+    uint32_t length;
+    uint16_t flags;
+    uint16_t next;
+};
+
+/// @brief Descriptor chains offered to the device
+struct virtq_avail {
+    uint16_t flags;
+    uint16_t index;
+    uint16_t ring[];
+};
+
+struct virtq_used_elem {
+    /// Head of the finished descriptor chain
+    uint32_t id;
+    uint32_t length;
+};
+
+/// @brief Descriptor chains the device is done with
+struct virtq_used {
+    uint16_t flags;
+    uint16_t index;
+    struct virtq_used_elem ring[];
+};
+
+struct virtio_blk_header {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((aligned(16)));
+
+/// @brief A request on the virtqueue. It lives on the stack of the thread that submitted it
+struct virtio_blk_request {
+    /// Read by the device, 16 byte aligned so it never crosses a page
+    struct virtio_blk_header header;
+    uint8_t *buffer;
+    uint32_t size;
+    bool write;
+    /// Written by the device
+    volatile uint8_t status;
+    bool done;
+    int result;
+};
+
+struct virtio_blk {
+    struct pci_device *pci;
+    uint16_t io_base;
+    uint32_t features;
+    int max_sectors;
+    uint16_t queue_size;
+    struct virtq_desc *descriptors;
+    volatile struct virtq_avail *avail;
+    volatile struct virtq_used *used;
+    /// Unused descriptors are chained through their next field
+    uint16_t free_head;
+    uint16_t free_count;
+    /// Used ring entries seen so far
+    uint16_t last_used;
+    /// Indexed by the head descriptor of the request
+    struct virtio_blk_request **requests;
+    spinlock_t lock;
+    /// Submitters sleep here keyed by their request, and keyed by the device while waiting for descriptors
+    struct wait_queue waiters;
+};
+
+static struct virtio_blk *virtio_blk_devices[VIRTIO_BLK_MAX_DEVICES];
+static int virtio_blk_count;
+
+static const struct disk_operations virtio_blk_disk_operations;
+
+static uint32_t virtio_physical(const void *address)
+{
+    return (uint32_t)paging_get_physical_address(kernel_page_directory, (void *)address);
+}
+
+static uint32_t virtq_align(const uint32_t size)
+{
+    return (size + VIRTQ_ALIGN - 1) & ~(VIRTQ_ALIGN - 1);
+}
+
+/// @brief Bytes taken by a legacy virtqueue: descriptors and available ring, then the used ring on its own page
+static uint32_t virtq_size(const uint16_t queue_size)
+{
+    return virtq_align(sizeof(struct virtq_desc) * queue_size + sizeof(uint16_t) * (3 + queue_size)) +
+        virtq_align(sizeof(uint16_t) * 3 + sizeof(struct virtq_used_elem) * queue_size);
+}
+
+/// @brief Descriptors the request needs: the header, one per page of the buffer at most, and the status
+static int virtio_blk_descriptors_needed(const struct virtio_blk_request *request)
+{
+    if (!request->size) {
+        return 2;
+    }
+
+    const uint32_t offset = (uint32_t)request->buffer % PAGING_PAGE_SIZE;
+    return 2 + (offset + request->size + PAGING_PAGE_SIZE - 1) / PAGING_PAGE_SIZE;
+}
+
+/// @warning device->lock must be held
+static uint16_t virtio_blk_take_descriptor(struct virtio_blk *device, const uint64_t address, const uint32_t length,
+                                           const uint16_t flags)
+{
+    ASSERT(device->free_count > 0, "Out of descriptors");
+
+    const uint16_t index = device->free_head;
+    device->free_head    = device->descriptors[index].next;
+    device->free_count--;
+
+    device->descriptors[index] = (struct virtq_desc){.address = address, .length = length, .flags = flags};
+    return index;
+}
+
+/// @brief Chain the header, the buffer and the status of the request, merging physically contiguous pages
+/// @return the head of the chain
+/// @warning device->lock must be held
+static uint16_t virtio_blk_build_chain(struct virtio_blk *device, struct virtio_blk_request *request)
+{
+    const uint16_t head = virtio_blk_take_descriptor(
+        device, virtio_physical(&request->header), sizeof(request->header), VIRTQ_DESC_F_NEXT);
+    uint16_t last = head;
+
+    // The device writes into the buffer of a read
+    const uint16_t data_flags = VIRTQ_DESC_F_NEXT | (request->write ? 0 : VIRTQ_DESC_F_WRITE);
+    auto address              = (uint32_t)request->buffer;
+    uint32_t remaining        = request->size;
+    uint32_t run_start        = 0;
+    uint32_t run_length       = 0;
+
+    while (remaining > 0) {
+        const uint32_t physical  = virtio_physical((void *)address);
+        const uint32_t page_left = PAGING_PAGE_SIZE - address % PAGING_PAGE_SIZE;
+        const uint32_t size      = remaining < page_left ? remaining : page_left;
+
+        if (run_length && run_start + run_length == physical) {
+            run_length += size;
+        } else {
+            if (run_length) {
+                const uint16_t next = virtio_blk_take_descriptor(device, run_start, run_length, data_flags);
+                device->descriptors[last].next = next;
+                last                           = next;
+            }
+            run_start  = physical;
+            run_length = size;
+        }
+
+        address += size;
+        remaining -= size;
+    }
+
+    if (run_length) {
+        const uint16_t next            = virtio_blk_take_descriptor(device, run_start, run_length, data_flags);
+        device->descriptors[last].next = next;
+        last                           = next;
+    }
+
+    const uint16_t status =
+        virtio_blk_take_descriptor(device, virtio_physical((const void *)&request->status), 1, VIRTQ_DESC_F_WRITE);
+    device->descriptors[last].next = status;
+
+    return head;
+}
+
+/// @brief Finish the requests the device put on the used ring and wake their submitters
+/// @warning device->lock must be held
+static void virtio_blk_complete(struct virtio_blk *device)
+{
+    bool freed = false;
+
+    while (device->last_used != device->used->index) {
+        const struct virtq_used_elem elem = device->used->ring[device->last_used % device->queue_size];
+        device->last_used++;
+
+        struct virtio_blk_request *request = device->requests[elem.id];
+        device->requests[elem.id]          = nullptr;
+
+        // Give the chain back to the free list
+        uint16_t index = elem.id;
+        for (;;) {
+            const uint16_t flags = device->descriptors[index].flags;
+            const uint16_t next  = device->descriptors[index].next;
+
+            device->descriptors[index].next = device->free_head;
+            device->free_head               = index;
+            device->free_count++;
+
+            if (!(flags & VIRTQ_DESC_F_NEXT)) {
+                break;
+            }
+            index = next;
+        }
+        freed = true;
+
+        if (request->status != VIRTIO_BLK_S_OK) {
+            warningf("virtio-blk request at sector %llu failed, status %u\n", request->header.sector, request->status);
+            request->result = -EIO;
+        }
+        request->done = true;
+        wait_queue_wake_keyed(&device->waiters, (uintptr_t)request, 1);
+    }
+
+    if (freed) {
+        wait_queue_wake_keyed(&device->waiters, (uintptr_t)device, device->queue_size);
+    }
+}
+
+static void virtio_blk_poll(struct virtio_blk *device)
+{
+    const uint32_t flags = spin_lock_irqsave(&device->lock);
+    virtio_blk_complete(device);
+    spin_unlock_irqrestore(&device->lock, flags);
+    pause();
+}
+
+/// @brief Put the request on the virtqueue once there are enough free descriptors, and wait for the device
+static int virtio_blk_submit(struct virtio_blk *device, struct virtio_blk_request *request)
+{
+    auto const thread = scheduler_get_current_thread();
+    // Before the scheduler starts, there is nobody to put to sleep
+    const bool can_sleep = thread && !softirq_is_running();
+    const int needed     = virtio_blk_descriptors_needed(request);
+
+    ASSERT(needed <= device->queue_size, "Request larger than the virtqueue");
+
+    request->status = 0xFF;
+    request->done   = false;
+    request->result = ALL_OK;
+
+    uint32_t flags = spin_lock_irqsave(&device->lock);
+    while (device->free_count < needed) {
+        spin_unlock_irqrestore(&device->lock, flags);
+        if (can_sleep) {
+            wait_queue_sleep_keyed(&device->waiters, (uintptr_t)device);
+        } else {
+            virtio_blk_poll(device);
+        }
+        flags = spin_lock_irqsave(&device->lock);
+    }
+
+    const uint16_t head    = virtio_blk_build_chain(device, request);
+    device->requests[head] = request;
+
+    device->avail->ring[device->avail->index % device->queue_size] = head;
+    // The device must see the ring entry before the new index
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    device->avail->index++;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    outw(device->io_base + VIRTIO_REG_QUEUE_NOTIFY, 0);
+    spin_unlock_irqrestore(&device->lock, flags);
+
+    if (!can_sleep) {
+        while (!request->done) {
+            virtio_blk_poll(device);
+        }
+        return request->result;
+    }
+
+    // The request lives on this stack, the thread must not be torn down before the device is done with it
+    thread->uninterruptible++;
+    while (!request->done) {
+        // Interrupts are off, the completion cannot slip in between the check and the sleep
+        wait_queue_sleep_keyed(&device->waiters, (uintptr_t)request);
+    }
+    thread->uninterruptible--;
+
+    return request->result;
+}
+
+static int virtio_blk_transfer(struct virtio_blk *device, uint32_t lba, int total, uint8_t *buffer, const bool write)
+{
+    if (write && device->features & VIRTIO_BLK_F_RO) {
+        return -ERDONLY;
+    }
+
+    while (total > 0) {
+        const int count = total < device->max_sectors ? total : device->max_sectors;
+
+        struct virtio_blk_request request = {
+            .header = {.type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN, .sector = lba},
+            .buffer = buffer,
+            .size   = count * VIRTIO_BLK_SECTOR_SIZE,
+            .write  = write,
+        };
+
+        const int res = virtio_blk_submit(device, &request);
+        if (res != ALL_OK) {
+            return res;
+        }
+
+        lba += count;
+        total -= count;
+        buffer += count * VIRTIO_BLK_SECTOR_SIZE;
+    }
+
+    return ALL_OK;
+}
+
+static void virtio_blk_interrupt_handler(const int interrupt, const struct interrupt_frame *frame)
+{
+    for (int i = 0; i < virtio_blk_count; i++) {
+        struct virtio_blk *device = virtio_blk_devices[i];
+        if (IRQ0 + device->pci->header.irq != interrupt) {
+            continue;
+        }
+
+        // Reading the ISR acknowledges the interrupt
+        if (!(inb(device->io_base + VIRTIO_REG_ISR) & VIRTIO_ISR_QUEUE)) {
+            continue;
+        }
+
+        spin_lock(&device->lock);
+        virtio_blk_complete(device);
+        spin_unlock(&device->lock);
+    }
+}
+
+static int virtio_blk_disk_read(const struct disk *disk, const uint32_t lba, const int total, void *buffer)
+{
+    return virtio_blk_transfer(disk->private, lba, total, buffer, false);
+}
+
+static int virtio_blk_disk_write(const struct disk *disk, const uint32_t lba, const int total, void *buffer)
+{
+    return virtio_blk_transfer(disk->private, lba, total, buffer, true);
+}
+
+/// @brief Without VIRTIO_BLK_F_FLUSH the device has no volatile cache, writes are on the medium once done
+static int virtio_blk_disk_flush(const struct disk *disk)
+{
+    struct virtio_blk *device = disk->private;
+    if (!(device->features & VIRTIO_BLK_F_FLUSH)) {
+        return ALL_OK;
+    }
+
+    struct virtio_blk_request request = {.header = {.type = VIRTIO_BLK_T_FLUSH}};
+    return virtio_blk_submit(device, &request);
+}
+
+static const struct disk_operations virtio_blk_disk_operations = {
+    .read  = virtio_blk_disk_read,
+    .write = virtio_blk_disk_write,
+    .flush = virtio_blk_disk_flush,
+};
+
+/// @brief Negotiate features, set up the request virtqueue and register the device as a disk
+void virtio_blk_init(struct pci_device *pci)
+{
+    // Modern-only devices have no I/O BAR
+    const uint32_t bar = pci->header.bars[0];
+    if ((bar & 0x1) != PCI_BAR_IO || virtio_blk_count == VIRTIO_BLK_MAX_DEVICES) {
+        return;
+    }
+
+    struct virtio_blk *device = kzalloc(sizeof(struct virtio_blk));
+    device->pci               = pci;
+    device->io_base           = bar & 0xFFFC;
+    spinlock_init(&device->lock, "virtio-blk");
+    wait_queue_init(&device->waiters);
+
+    const uint16_t io_base = device->io_base;
+    pci_enable_bus_mastering(pci);
+
+    outb(io_base + VIRTIO_REG_STATUS, 0);
+    outb(io_base + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+    outb(io_base + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    device->features =
+        inl(io_base + VIRTIO_REG_DEVICE_FEATURES) & (VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_RO | VIRTIO_BLK_F_FLUSH);
+    outl(io_base + VIRTIO_REG_GUEST_FEATURES, device->features);
+
+    outw(io_base + VIRTIO_REG_QUEUE_SELECT, 0);
+    device->queue_size = inw(io_base + VIRTIO_REG_QUEUE_SIZE);
+    if (device->queue_size < 3) {
+        warningf("virtio-blk: no usable request queue\n");
+        outb(io_base + VIRTIO_REG_STATUS, VIRTIO_STATUS_FAILED);
+        kfree(device);
+        return;
+    }
+
+    // Heap blocks are page aligned, as the legacy interface wants
+    uint8_t *queue      = kzalloc(virtq_size(device->queue_size));
+    device->descriptors = (struct virtq_desc *)queue;
+    device->avail       = (struct virtq_avail *)(queue + sizeof(struct virtq_desc) * device->queue_size);
+    device->used        = (struct virtq_used *)(queue + virtq_align(sizeof(struct virtq_desc) * device->queue_size +
+                                                                  sizeof(uint16_t) * (3 + device->queue_size)));
+    device->requests    = kzalloc(device->queue_size * sizeof(struct virtio_blk_request *));
+
+    for (uint16_t i = 0; i < device->queue_size; i++) {
+        device->descriptors[i].next = i + 1;
+    }
+    device->free_head  = 0;
+    device->free_count = device->queue_size;
+
+    // Each page of a buffer may take a segment of its own
+    device->max_sectors = VIRTIO_BLK_MAX_SECTORS;
+    int segments        = device->queue_size - 2;
+    if (device->features & VIRTIO_BLK_F_SEG_MAX) {
+        const int seg_max = (int)inl(io_base + VIRTIO_REG_CONFIG + VIRTIO_BLK_CONFIG_SEG_MAX);
+        segments          = seg_max && seg_max < segments ? seg_max : segments;
+    }
+    const int sectors_per_page = PAGING_PAGE_SIZE / VIRTIO_BLK_SECTOR_SIZE;
+    if ((segments - 1) * sectors_per_page < device->max_sectors) {
+        device->max_sectors = (segments - 1) * sectors_per_page;
+    }
+    ASSERT(device->max_sectors > 0, "virtio-blk queue too small");
+
+    outl(io_base + VIRTIO_REG_QUEUE_ADDRESS, virtio_physical(queue) / VIRTQ_ALIGN);
+
+    virtio_blk_devices[virtio_blk_count++] = device;
+    idt_register_interrupt_callback(IRQ0 + pci->header.irq, virtio_blk_interrupt_handler);
+
+    outb(io_base + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+
+    const uint32_t capacity_low  = inl(io_base + VIRTIO_REG_CONFIG + VIRTIO_BLK_CONFIG_CAPACITY);
+    const uint32_t capacity_high = inl(io_base + VIRTIO_REG_CONFIG + VIRTIO_BLK_CONFIG_CAPACITY + 4);
+
+    printf("[ " KBGRN "OK" KWHT " ] ");
+    printf("virtio-blk: queue size %u, %d sectors per request\n", device->queue_size, device->max_sectors);
+
+    disk_register("virtio-blk",
+                  &virtio_blk_disk_operations,
+                  device,
+                  VIRTIO_BLK_SECTOR_SIZE,
+                  capacity_high ? 0xFFFF'FFFF : capacity_low);
+}
@@ -0,0 +1,173 @@
+#include <assert.h>
+#include <config.h>
+#include <dcache.h>
+#include <memory.h>
+#include <printf.h>
+#include <spinlock.h>
+#include <string.h>
+#include <termcolors.h>
+
+// Names resolved in directories, so that looking up the same path again does not read the directories. Names that
+// do not exist are cached too. Names are compared without case, like the FAT 8.3 names they mostly are.
+
+static struct dentry dentries[DCACHE_ENTRIES];
+static struct list hash_table[DCACHE_HASH_BUCKETS];
+/// Every dentry, the front is recycled first
+static struct list lru;
+/// Protects the hash table, the LRU list and the stats
+static spinlock_t dcache_lock = SPINLOCK_INITIALIZER("dcache");
+static struct dcache_stats stats;
+
+static uint32_t dcache_hash(const uint32_t device, const uint32_t parent, const char *name)
+{
+    // FNV-1a over the lower case name
+    uint32_t hash = 0x811C'9DC5U ^ (parent * 0x9E37'79B1U) ^ device;
+    for (; *name; name++) {
+        hash ^= (uint8_t)tolower(*name);
+        hash *= 0x0100'0193U;
+    }
+
+    return hash % DCACHE_HASH_BUCKETS;
+}
+
+void dcache_init()
+{
+    for (int i = 0; i < DCACHE_HASH_BUCKETS; i++) {
+        list_init(&hash_table[i]);
+    }
+    list_init(&lru);
+
+    for (int i = 0; i < DCACHE_ENTRIES; i++) {
+        list_push_back(&lru, &dentries[i].lru_elem);
+    }
+}
+
+/// @warning The dcache lock must be held
+static struct dentry *dcache_find(const uint32_t device, const uint32_t parent, const char *name)
+{
+    struct list *bucket = &hash_table[dcache_hash(device, parent, name)];
+    for (auto elem = list_begin(bucket); elem != list_end(bucket); elem = list_next(elem)) {
+        auto const dentry = list_entry(elem, struct dentry, hash_elem);
+        if (dentry->device == device && dentry->parent == parent &&
+            istrncmp(dentry->name, name, DCACHE_NAME_LENGTH) == 0) {
+            return dentry;
+        }
+    }
+
+    return nullptr;
+}
+
+/// @brief Look the name up in the directory
+/// @param data filled with what the name resolved to on a hit
+enum DCACHE_RESULT dcache_lookup(const uint32_t device, const uint32_t parent, const char *name, void *data,
+                                 const size_t size)
+{
+    ASSERT(size <= DCACHE_DATA_SIZE);
+
+    spin_lock(&dcache_lock);
+
+    struct dentry *dentry = dcache_find(device, parent, name);
+    if (!dentry) {
+        stats.misses++;
+        spin_unlock(&dcache_lock);
+        return DCACHE_MISS;
+    }
+
+    list_remove(&dentry->lru_elem);
+    list_push_back(&lru, &dentry->lru_elem);
+
+    const bool negative = dentry->negative;
+    if (negative) {
+        stats.negative_hits++;
+    } else {
+        stats.hits++;
+        memcpy(data, dentry->data, size);
+    }
+
+    spin_unlock(&dcache_lock);
+    return negative ? DCACHE_NEGATIVE : DCACHE_HIT;
+}
+
+/// @brief Remember what the name resolved to in the directory
+/// @param data nullptr if the name does not exist
+void dcache_add(const uint32_t device, const uint32_t parent, const char *name, const void *data, const size_t size)
+{
+    ASSERT(size <= DCACHE_DATA_SIZE);
+    if (strlen(name) >= DCACHE_NAME_LENGTH) {
+        return;
+    }
+
+    spin_lock(&dcache_lock);
+
+    struct dentry *dentry = dcache_find(device, parent, name);
+    if (!dentry) {
+        dentry = list_entry(list_front(&lru), struct dentry, lru_elem);
+        if (dentry->used) {
+            list_remove(&dentry->hash_elem);
+            stats.evictions++;
+        }
+
+        dentry->device = device;
+        dentry->parent = parent;
+        dentry->used   = true;
+        strncpy(dentry->name, name, DCACHE_NAME_LENGTH);
+        list_push_back(&hash_table[dcache_hash(device, parent, name)], &dentry->hash_elem);
+    }
+
+    dentry->negative = data == nullptr;
+    memset(dentry->data, 0, DCACHE_DATA_SIZE);
+    if (data) {
+        memcpy(dentry->data, data, size);
+    }
+
+    list_remove(&dentry->lru_elem);
+    list_push_back(&lru, &dentry->lru_elem);
+
+    spin_unlock(&dcache_lock);
+}
+
+/// @brief Forget the name, after it was created, changed or removed in the directory
+void dcache_invalidate(const uint32_t device, const uint32_t parent, const char *name)
+{
+    spin_lock(&dcache_lock);
+
+    struct dentry *dentry = dcache_find(device, parent, name);
+    if (dentry) {
+        list_remove(&dentry->hash_elem);
+        dentry->used = false;
+        // Recycled first
+        list_remove(&dentry->lru_elem);
+        list_push_front(&lru, &dentry->lru_elem);
+    }
+
+    spin_unlock(&dcache_lock);
+}
+
+void dcache_get_stats(struct dcache_stats *stats_out)
+{
+    spin_lock(&dcache_lock);
+    *stats_out = stats;
+    spin_unlock(&dcache_lock);
+}
+
+void dcache_print_stats(void)
+{
+    struct dcache_stats snapshot;
+    dcache_get_stats(&snapshot);
+
+    const uint32_t lookups = snapshot.hits + snapshot.negative_hits + snapshot.misses;
+    printf(KBBLU "\n %-12s%-12s%-12s%-12s%-12s%-12s\n" KWHT,
+           "Dentries",
+           "Hits",
+           "Negative",
+           "Misses",
+           "Hit rate",
+           "Evictions");
+    printf(" %-12u%-12lu%-12lu%-12lu%-11lu%%%-12lu\n",
+           DCACHE_ENTRIES,
+           snapshot.hits,
+           snapshot.negative_hits,
+           snapshot.misses,
+           lookups ? (snapshot.hits + snapshot.negative_hits) * 100 / lookups : 0,
+           snapshot.evictions);
+}
@@ -0,0 +1,87 @@
+#include <kernel.h>
+#include <memfs.h>
+#include <memory.h>
+#include <root_inode.h>
+#include <serial.h>
+#include <serial_tty.h>
+#include <status.h>
+
+// /dev/ttyS0 writes straight to COM1, so user programs can report to the host (e.g. benchmark results when
+// QEMU runs headless with -serial stdio)
+
+extern struct inode_operations memfs_directory_inode_ops;
+
+static void *serial_tty_open(const struct path_root *path_root, FILE_MODE mode, enum INODE_TYPE *type_out,
+                             uint32_t *size_out)
+{
+    *type_out = INODE_DEVICE;
+    return nullptr;
+}
+
+static int serial_tty_read(const void *descriptor, size_t size, off_t offset, char *out)
+{
+    return 0;
+}
+
+static int serial_tty_write(const void *descriptor, const char *buffer, const size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        serial_put(buffer[i]);
+    }
+
+    return (int)size;
+}
+
+static int serial_tty_stat(void *descriptor, struct stat *stat)
+{
+    stat->st_mode = S_IFCHR | S_IWUSR | S_IWGRP | S_IWOTH;
+    return 0;
+}
+
+static int serial_tty_close(void *descriptor)
+{
+    return 0;
+}
+
+static int serial_tty_ioctl(void *descriptor, int request, void *arg)
+{
+    return 0;
+}
+
+static int serial_tty_seek(void *descriptor, uint32_t offset, enum FILE_SEEK_MODE seek_mode)
+{
+    return 0;
+}
+
+struct inode_operations serial_tty_device_fops = {
+    .open  = serial_tty_open,
+    .read  = serial_tty_read,
+    .write = serial_tty_write,
+    .stat  = serial_tty_stat,
+    .seek  = serial_tty_seek,
+    .close = serial_tty_close,
+    .ioctl = serial_tty_ioctl,
+};
+
+int serial_tty_init(void)
+{
+    struct inode *dev_dir = nullptr;
+
+    int res = root_inode_lookup("dev", &dev_dir);
+    if (res != 0) {
+        root_inode_mkdir("dev", &memfs_directory_inode_ops);
+        res = root_inode_lookup("dev", &dev_dir);
+        if (ISERR(res) || !dev_dir) {
+            return res;
+        }
+        dev_dir->fs_type = FS_TYPE_RAMFS;
+        vfs_add_mount_point("/dev", -1, dev_dir);
+    }
+
+    struct inode *serial_device = nullptr;
+    if (dev_dir->ops->lookup(dev_dir, "ttyS0", &serial_device) == ALL_OK) {
+        return ALL_OK;
+    }
+
+    return dev_dir->ops->create_device(dev_dir, "ttyS0", &serial_tty_device_fops);
+}
@@ -61,12 +61,25 @@ static bool tty_input_buffer_is_empty(void)
     return tty_input_buffer.head == tty_input_buffer.tail;
 }
 
+/// @brief Block the current process until the keyboard handler wakes it up
 static void wait_for_input()
 {
+    auto const thread = scheduler_get_current_thread();
+    if (!thread) {
+        // No process to put to sleep (e.g. during boot), just wait for the next interrupt
+        asm volatile("sti; hlt; cli");
+        return;
+    }
+
     if (tty_input_buffer_is_empty()) {
-        scheduler_get_current_process()->state        = SLEEPING;
-        scheduler_get_current_process()->sleep_reason = SLEEP_REASON_STDIN;
-        sti();
+        thread->sleep_until  = -1;
+        thread->sleep_reason = SLEEP_REASON_STDIN;
+        thread->state        = SLEEPING;
+
+        cli();
+        schedule();
+
+        thread->sleep_reason = SLEEP_REASON_NONE;
     }
 }
 
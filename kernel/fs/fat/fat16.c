@@ -1,7 +1,10 @@
+#include <bcache.h>
 #include <config.h>
+#include <dcache.h>
 #include <debug.h>
 #include <disk.h>
 #include <fat16.h>
+#include <fcntl.h>
 #include <inode.h>
 #include <kernel.h>
 #include <kernel_heap.h>
@@ -9,12 +12,13 @@
 #include <memory.h>
 #include <path_parser.h>
 #include <serial.h>
-#include <spinlock.h>
+#include <sleeplock.h>
 #include <status.h>
 #include <stream.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <time.h>
+#include <workqueue.h>
 
 
 #define FAT16_SIGNATURE 0x29
@@ -102,6 +106,7 @@ struct fat_item {
 };
 
 struct fat_private {
+    const struct disk *disk;
     struct fat_h header;
     struct fat_directory root_directory;
     struct disk_stream *cluster_read_stream;
@@ -111,16 +116,41 @@ struct fat_private {
     struct disk_stream *directory_stream;
 };
 
+/// @brief Clusters of a file to read into the buffer cache, in the background
+struct fat_readahead_request {
+    struct work work;
+    const struct disk *disk;
+    int cluster;
+    uint32_t clusters;
+    /// Queued or running, the request cannot be reused yet
+    bool busy;
+};
+
 #define FAT_ENTRIES_PER_SECTOR (512 / sizeof(struct fat_directory_entry))
 
-static uint8_t *fat_table         = nullptr;
-spinlock_t fat16_table_lock       = 0;
-spinlock_t fat16_set_entry_lock   = 0;
-spinlock_t fat16_table_flush_lock = 0;
+// The first FAT, loaded at mount time. Entries are read and changed here, the disk only sees the changes when the
+// table is flushed
+static uint8_t *fat_table = nullptr;
+// One bit per sector of the FAT, set when the sector changed since the last flush
+static uint8_t *fat_table_dirty = nullptr;
+// One bit per cluster, set when the cluster is in use or reserved. Built from the FAT at mount time
+static uint8_t *fat_used_clusters = nullptr;
+// Clusters that have an entry in the FAT, including the two reserved ones
+static uint32_t fat_cluster_count;
+// Where the search for free clusters resumes, right after the last clusters handed out
+static uint32_t fat_next_free;
+// Held across disk transfers
+static struct sleeplock fat16_table_flush_lock;
+static struct workqueue *fat16_readahead_queue;
+static struct fat_readahead_request readahead_requests[FAT16_READAHEAD_REQUESTS];
 
 int fat16_resolve(struct disk *disk);
 void *fat16_open(const struct path_root *path, FILE_MODE mode, enum INODE_TYPE *type_out, uint32_t *size_out);
 int fat16_read(const void *descriptor, size_t size, off_t nmemb, char *out);
+int fat16_fadvise(void *descriptor, uint32_t offset, uint32_t length, int advice);
+int fat16_fsync(void *descriptor);
+static int fat16_sync(const struct disk *disk);
+static void fat16_readahead_work(struct work *work);
 int fat16_write(const void *descriptor, const char *data, size_t size);
 int fat16_seek(void *private, uint32_t offset, enum FILE_SEEK_MODE seek_mode);
 int fat16_stat(void *descriptor, struct stat *stat);
@@ -134,12 +164,14 @@ int fat16_read_entry(struct file *descriptor, struct dir_entry *entry);
 uint16_t fat16_allocate_new_entry(const struct disk *disk, const uint16_t clusters_needed);
 
 struct inode_operations fat16_file_inode_ops = {
-    .open  = fat16_open,
-    .read  = fat16_read,
-    .write = fat16_write,
-    .seek  = fat16_seek,
-    .stat  = fat16_stat,
-    .close = fat16_close,
+    .open    = fat16_open,
+    .read    = fat16_read,
+    .write   = fat16_write,
+    .seek    = fat16_seek,
+    .stat    = fat16_stat,
+    .close   = fat16_close,
+    .fadvise = fat16_fadvise,
+    .fsync   = fat16_fsync,
 };
 
 struct inode_operations fat16_directory_inode_ops = {
@@ -149,6 +181,8 @@ struct inode_operations fat16_directory_inode_ops = {
     .seek       = fat16_seek,
     .stat       = fat16_stat,
     .close      = fat16_close,
+    .fadvise    = fat16_fadvise,
+    .fsync      = fat16_fsync,
     .mkdir      = fat16_create_directory,
     .lookup     = memfs_lookup,
     .read_entry = fat16_read_entry,
@@ -160,8 +194,19 @@ struct file_system *fat16_init()
 {
     fat16_fs = kzalloc(sizeof(struct file_system));
 
+    sleeplock_init(&fat16_table_flush_lock, "fat16_table_flush");
+
+    fat16_readahead_queue = workqueue_create("readahead");
+    if (ISERR(fat16_readahead_queue)) {
+        panic("Failed to create the readahead workqueue\n");
+    }
+    for (int i = 0; i < FAT16_READAHEAD_REQUESTS; i++) {
+        work_init(&readahead_requests[i].work, fat16_readahead_work);
+    }
+
     fat16_fs->type    = FS_TYPE_FAT16;
     fat16_fs->resolve = fat16_resolve;
+    fat16_fs->sync    = fat16_sync;
     fat16_fs->ops     = &fat16_directory_inode_ops;
 
     strncpy(fat16_fs->name, "FAT16", 20);
@@ -183,6 +228,7 @@ static uint16_t get_fat_start_sector(const struct fat_private *fat_private)
 static void fat16_init_private(const struct disk *disk, struct fat_private *fat_private)
 {
     memset(&fat_private->header, 0, sizeof(struct fat_h));
+    fat_private->disk = disk;
 
     fat_private->cluster_read_stream  = disk_stream_create(disk->id);
     fat_private->cluster_write_stream = disk_stream_create(disk->id);
@@ -208,36 +254,39 @@ static int fat16_sector_to_absolute(const struct disk *disk, const int sector)
     return sector * disk->sector_size;
 }
 
-/// @brief Load the first FAT into memory
+/// @brief The sector right after the entries of the directory, in sectors like sector_position
+static uint32_t fat16_directory_end_sector(const struct disk *disk, const struct fat_directory *directory)
+{
+    const uint32_t size = directory->entry_count * sizeof(struct fat_directory_entry);
+    return directory->sector_position + (size + disk->sector_size - 1) / disk->sector_size;
+}
+
+/// @brief Load the first FAT into memory, it is the source of truth from then on
 int fat16_load_table(const struct fat_private *fat_private)
 {
+    const uint16_t first_fat_start_sector = fat_private->header.primary_header.reserved_sectors;
+    const uint16_t sector_size            = fat_private->header.primary_header.bytes_per_sector;
+    const uint16_t fat_sectors            = fat_private->header.primary_header.sectors_per_fat;
+
     if (fat_table == nullptr) {
-        fat_table = kzalloc(fat_private->header.primary_header.sectors_per_fat *
-                            fat_private->header.primary_header.bytes_per_sector);
-        if (fat_table == nullptr) {
+        fat_table       = kzalloc(fat_sectors * sector_size);
+        fat_table_dirty = kzalloc((fat_sectors + 7) / 8);
+        if (fat_table == nullptr || fat_table_dirty == nullptr) {
             panic("Failed to allocate memory for FAT table\n");
             return -ENOMEM;
         }
     }
 
-    const uint16_t first_fat_start_sector = fat_private->header.primary_header.reserved_sectors;
-    const uint16_t sector_size            = fat_private->header.primary_header.bytes_per_sector;
-    const uint16_t fat_sectors            = fat_private->header.primary_header.sectors_per_fat;
-
-    spin_lock(&fat16_table_lock);
-
-    for (uint16_t i = 0; i < fat_sectors; i++) {
-        if (disk_read_sector(first_fat_start_sector + i, fat_table + (i * sector_size)) < 0) {
-            panic("Failed to read FAT\n");
-            return -EIO;
-        }
+    if (disk_read_block(fat_private->disk, first_fat_start_sector, fat_sectors, fat_table) < 0) {
+        warningf("Failed to read FAT\n");
+        return -EIO;
     }
+    memset(fat_table_dirty, 0, (fat_sectors + 7) / 8);
 
-    spin_unlock(&fat16_table_lock);
     return ALL_OK;
 }
 
-/// @brief Write the FAT back to disk
+/// @brief Write the sectors of the FAT that changed since the last flush to every copy of the FAT
 void fat16_flush_table(const struct fat_private *fat_private)
 {
     ASSERT(fat_table);
@@ -245,47 +294,136 @@ void fat16_flush_table(const struct fat_private *fat_private)
     const uint16_t start_sector = fat_private->header.primary_header.reserved_sectors;
     const uint16_t sector_size  = fat_private->header.primary_header.bytes_per_sector;
     const uint16_t fat_sectors  = fat_private->header.primary_header.sectors_per_fat;
+    const uint8_t fat_copies    = fat_private->header.primary_header.fat_copies;
 
-    spin_lock(&fat16_table_flush_lock);
-
-    // TODO: Flush all FATs, not just the first one
+    sleeplock_acquire(&fat16_table_flush_lock);
 
     for (uint16_t i = 0; i < fat_sectors; i++) {
-        if (disk_write_sector(start_sector + i, fat_table + i * sector_size) < 0) {
-            panic("Failed to write FAT table\n");
+        if (!(fat_table_dirty[i / 8] & (1 << (i % 8)))) {
+            continue;
+        }
+        // Cleared before the writes, an entry changed while they sleep marks the sector dirty again
+        fat_table_dirty[i / 8] &= ~(1 << (i % 8));
+
+        for (uint8_t copy = 0; copy < fat_copies; copy++) {
+            const uint32_t sector = start_sector + copy * fat_sectors + i;
+            if (disk_write_sector(fat_private->disk, sector, fat_table + i * sector_size) < 0) {
+                panic("Failed to write FAT table\n");
+            }
         }
     }
 
-    spin_unlock(&fat16_table_flush_lock);
+    sleeplock_release(&fat16_table_flush_lock);
+}
+
+/// @brief Flush the FAT when the disk is synced, so that chains reach the disk with the data in them
+static int fat16_sync(const struct disk *disk)
+{
+    // The disk may be synced while the file system is still being mounted
+    if (disk->fs_private && fat_table) {
+        fat16_flush_table(disk->fs_private);
+    }
+
+    return ALL_OK;
 }
 
+/// @brief Change an entry of the FAT in memory, fat16_flush_table() puts it on the disk
 void fat16_set_fat_entry(const uint32_t cluster, const uint16_t value)
 {
-    const uint32_t fat_offset             = cluster * FAT16_FAT_ENTRY_SIZE;
+    ASSERT(fat_table);
+
     const struct disk *disk               = disk_get(0);
     const struct fat_private *fat_private = disk->fs_private;
+    const uint32_t fat_offset             = cluster * FAT16_FAT_ENTRY_SIZE;
+    const uint32_t sector                 = fat_offset / fat_private->header.primary_header.bytes_per_sector;
 
-    spin_lock(&fat16_set_entry_lock);
-
-    // Inefficient, but I don't care for now
-    fat16_load_table(fat_private);
     *(uint16_t *)(fat_table + fat_offset) = value;
-    fat16_flush_table(fat_private);
+    fat_table_dirty[sector / 8] |= 1 << (sector % 8);
+}
 
-    spin_unlock(&fat16_set_entry_lock);
+static bool fat16_is_cluster_used(const uint32_t cluster)
+{
+    return fat_used_clusters[cluster / 8] & (1 << (cluster % 8));
+}
+
+static void fat16_mark_cluster_used(const uint32_t cluster)
+{
+    fat_used_clusters[cluster / 8] |= 1 << (cluster % 8);
 }
 
-uint32_t fat16_get_free_cluster(const struct disk *disk)
+/// @brief Find the free clusters in the FAT loaded in memory
+int fat16_build_free_map(const struct fat_private *fat_private)
 {
-    // First 2 (2 * FAT_ENTRY_SIZE) entries are reserved
-    for (int i = 5; i < 65536; i++) {
-        if (fat16_get_fat_entry(disk, i) == FAT16_FREE) {
-            fat16_set_fat_entry(i, FAT16_EOC2);
-            return i;
+    const struct fat_header *header = &fat_private->header.primary_header;
+    const uint32_t total_sectors    = header->total_sectors != 0 ? header->total_sectors : header->total_sectors_large;
+    const uint32_t data_start       = header->reserved_sectors + header->fat_copies * header->sectors_per_fat +
+        header->root_entries * sizeof(struct fat_directory_entry) / header->bytes_per_sector;
+
+    fat_cluster_count           = (total_sectors - data_start) / header->sectors_per_cluster + 2;
+    const uint32_t fat_capacity = header->sectors_per_fat * header->bytes_per_sector / FAT16_FAT_ENTRY_SIZE;
+    if (fat_cluster_count > fat_capacity) {
+        fat_cluster_count = fat_capacity;
+    }
+    if (fat_cluster_count > FAT16_FAT_BAD_SECTOR) {
+        fat_cluster_count = FAT16_FAT_BAD_SECTOR;
+    }
+
+    if (fat_used_clusters == nullptr) {
+        fat_used_clusters = kzalloc((FAT16_FAT_BAD_SECTOR + 7) / 8);
+        if (fat_used_clusters == nullptr) {
+            panic("Failed to allocate memory for the free cluster map\n");
+            return -ENOMEM;
         }
     }
 
-    return -1;
+    // The first two entries are reserved
+    fat16_mark_cluster_used(0);
+    fat16_mark_cluster_used(1);
+    for (uint32_t cluster = 2; cluster < fat_cluster_count; cluster++) {
+        if (fat16_get_fat_entry(fat_private->disk, (int)cluster) != FAT16_FREE) {
+            fat16_mark_cluster_used(cluster);
+        }
+    }
+    fat_next_free = 2;
+
+    return ALL_OK;
+}
+
+/// @brief Take a run of contiguous free clusters, from the first free one at or after the last allocation. The run
+/// is chained in the FAT and ends with an end of chain marker
+/// @param count clusters wanted, set to the length of the run, which can be shorter
+/// @return the first cluster of the run, or 0 if the disk is full
+static uint16_t fat16_allocate_run(uint32_t *count)
+{
+    const uint32_t data_clusters = fat_cluster_count - 2;
+
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < data_clusters; i++) {
+        const uint32_t cluster = 2 + (fat_next_free - 2 + i) % data_clusters;
+        if (!fat16_is_cluster_used(cluster)) {
+            first = cluster;
+            break;
+        }
+    }
+    if (first == 0) {
+        *count = 0;
+        return 0;
+    }
+
+    uint32_t length = 1;
+    while (length < *count && first + length < fat_cluster_count && !fat16_is_cluster_used(first + length)) {
+        length++;
+    }
+
+    for (uint32_t i = 0; i < length; i++) {
+        const uint32_t cluster = first + i;
+        fat16_mark_cluster_used(cluster);
+        fat16_set_fat_entry(cluster, i + 1 < length ? cluster + 1 : FAT16_EOC2);
+    }
+
+    fat_next_free = first + length < fat_cluster_count ? first + length : 2;
+    *count        = length;
+    return first;
 }
 
 int fat16_get_total_items_for_directory(const struct disk *disk, const uint32_t directory_start_sector)
@@ -464,6 +602,13 @@ int fat16_resolve(struct disk *disk)
         goto out;
     }
 
+    if (fat16_load_table(fat_private) != ALL_OK) {
+        panic("Failed to load the FAT\n");
+        res = -EIO;
+        goto out;
+    }
+    fat16_build_free_map(fat_private);
+
     if (fat16_load_root_directory(disk) != ALL_OK) {
         panic("Failed to get root directory\n");
         res = -EIO;
@@ -562,28 +707,9 @@ struct fat_directory_entry *fat16_clone_fat_directory_entry(const struct fat_dir
 
 static int fat16_get_fat_entry(const struct disk *disk, const int cluster)
 {
-    uint16_t result = ALL_OK;
-
-    const struct fat_private *fs_private = disk->fs_private;
-
-    const uint32_t fat_offset = cluster * 2;
-    const uint32_t fat_sector = fs_private->header.primary_header.reserved_sectors +
-        (fat_offset / fs_private->header.primary_header.bytes_per_sector);
-    const uint32_t fat_entry_offset = fat_offset % fs_private->header.primary_header.bytes_per_sector;
-
-    uint8_t buffer[512];
-
-    int res = disk_read_sector(fat_sector, buffer);
-    result  = *(uint16_t *)&buffer[fat_entry_offset];
-    if (res < 0) {
-        warningf("Failed to read FAT table\n");
-        goto out;
-    }
-
-    res = result;
+    ASSERT(fat_table);
 
-out:
-    return res;
+    return *(uint16_t *)(fat_table + cluster * FAT16_FAT_ENTRY_SIZE);
 }
 
 static int fat16_get_cluster_for_offset(const struct disk *disk, const int start_cluster, const uint32_t offset)
@@ -633,6 +759,151 @@ out:
     return res;
 }
 
+static bool fat16_is_data_cluster(const int cluster)
+{
+    return cluster >= 2 && cluster < 0xFFF0;
+}
+
+static void fat16_drop_extents(struct fat_file_descriptor *descriptor)
+{
+    if (descriptor->extents.extents) {
+        kfree(descriptor->extents.extents);
+    }
+    descriptor->extents = (struct fat_extent_cache){};
+}
+
+/// @brief Read the cluster chain of the file from the FAT into its extent cache
+static int fat16_load_extents(struct fat_file_descriptor *descriptor)
+{
+    const struct fat_directory_entry *entry = descriptor->item->item;
+    const struct disk *disk                 = descriptor->disk;
+
+    fat16_drop_extents(descriptor);
+    if (!fat16_is_data_cluster(entry->first_cluster)) {
+        return ALL_OK;
+    }
+
+    // The FAT is in memory, walking the chain twice is cheaper than growing the array
+    int count = 0;
+    for (int cluster = entry->first_cluster; fat16_is_data_cluster(cluster);) {
+        const int next = fat16_get_fat_entry(disk, cluster);
+        if (next != cluster + 1) {
+            count++;
+        }
+        cluster = next;
+    }
+
+    struct fat_extent *extents = kzalloc(count * sizeof(struct fat_extent));
+    if (!extents) {
+        warningf("Failed to allocate memory for the extents\n");
+        return -ENOMEM;
+    }
+
+    uint32_t file_cluster = 0;
+    int cluster           = entry->first_cluster;
+    for (int i = 0; i < count; i++) {
+        extents[i].file_cluster = file_cluster;
+        extents[i].cluster      = cluster;
+        int next;
+        while (true) {
+            extents[i].count++;
+            next = fat16_get_fat_entry(disk, cluster);
+            if (next != cluster + 1) {
+                break;
+            }
+            cluster = next;
+        }
+        file_cluster += extents[i].count;
+        cluster = next;
+    }
+
+    descriptor->extents.extents  = extents;
+    descriptor->extents.count    = count;
+    descriptor->extents.clusters = file_cluster;
+
+    return ALL_OK;
+}
+
+/// @brief Find the extent that holds the cluster of the file at the offset
+/// @return the extent, or nullptr if the offset is past the end of the chain
+static const struct fat_extent *fat16_find_extent(struct fat_file_descriptor *descriptor, const uint32_t offset)
+{
+    const struct fat_private *private = descriptor->disk->fs_private;
+    const uint32_t cluster_size = private->header.primary_header.sectors_per_cluster * descriptor->disk->sector_size;
+    const uint32_t file_cluster = offset / cluster_size;
+
+    // Another descriptor of the file may have extended the chain since it was loaded
+    if (file_cluster >= descriptor->extents.clusters && fat16_load_extents(descriptor) < 0) {
+        return nullptr;
+    }
+    if (file_cluster >= descriptor->extents.clusters) {
+        return nullptr;
+    }
+
+    int low  = 0;
+    int high = descriptor->extents.count - 1;
+    while (low < high) {
+        const int middle = (low + high + 1) / 2;
+        if (descriptor->extents.extents[middle].file_cluster <= file_cluster) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    return &descriptor->extents.extents[low];
+}
+
+/// @brief The cluster of the file at the offset
+static int fat16_get_file_cluster(struct fat_file_descriptor *descriptor, const uint32_t offset)
+{
+    const struct fat_private *private = descriptor->disk->fs_private;
+    const uint32_t cluster_size = private->header.primary_header.sectors_per_cluster * descriptor->disk->sector_size;
+
+    const struct fat_extent *extent = fat16_find_extent(descriptor, offset);
+    if (!extent) {
+        return -EIO;
+    }
+
+    return (int)(extent->cluster + offset / cluster_size - extent->file_cluster);
+}
+
+/// @brief Read from the file, an extent at a time
+static int fat16_read_file(struct fat_file_descriptor *descriptor, uint32_t offset, uint32_t total, void *out)
+{
+    const struct disk *disk           = descriptor->disk;
+    const struct fat_private *private = disk->fs_private;
+    struct disk_stream *stream        = private->cluster_read_stream;
+    const uint32_t cluster_size       = private->header.primary_header.sectors_per_cluster * disk->sector_size;
+
+    while (total > 0) {
+        const struct fat_extent *extent = fat16_find_extent(descriptor, offset);
+        if (!extent) {
+            return -EIO;
+        }
+
+        const uint32_t extent_offset = offset - extent->file_cluster * cluster_size;
+        const uint32_t extent_left   = extent->count * cluster_size - extent_offset;
+        const uint32_t to_read       = total > extent_left ? extent_left : total;
+        const uint32_t position      = fat16_cluster_to_sector(private, (int)extent->cluster) * disk->sector_size;
+
+        int res = disk_stream_seek(stream, position + extent_offset);
+        if (res != ALL_OK) {
+            return res;
+        }
+        res = disk_stream_read(stream, out, to_read);
+        if (res != ALL_OK) {
+            return res;
+        }
+
+        offset += to_read;
+        total -= to_read;
+        out = (char *)out + to_read;
+    }
+
+    return ALL_OK;
+}
+
 static int fat16_read_internal(const struct disk *disk, const int cluster, const uint32_t offset, uint32_t total,
                                void *out)
 {
@@ -673,6 +944,150 @@ out:
     return res;
 }
 
+/// @brief Read the clusters of the request into the buffer cache. Clusters that follow each other on the disk are
+/// read together
+static void fat16_readahead_work(struct work *work)
+{
+    auto const request = (struct fat_readahead_request *)work;
+
+    const struct disk *disk           = request->disk;
+    const struct fat_private *private = disk->fs_private;
+    const uint8_t sectors_per_cluster = private->header.primary_header.sectors_per_cluster;
+    int cluster                       = request->cluster;
+    uint32_t left                     = request->clusters;
+
+    while (left > 0 && fat16_is_data_cluster(cluster)) {
+        const int first = cluster;
+        uint32_t count  = 0;
+        int next;
+
+        while (true) {
+            count++;
+            left--;
+            next = fat16_get_fat_entry(disk, cluster);
+            if (left == 0 || next != cluster + 1) {
+                break;
+            }
+            cluster = next;
+        }
+
+        if (bcache_prefetch(disk, fat16_cluster_to_sector(private, first), (int)(count * sectors_per_cluster)) < 0) {
+            break;
+        }
+        cluster = next;
+    }
+
+    request->busy = false;
+}
+
+/// @brief Queue the clusters of a file to be read ahead
+/// @return false when every readahead request is already in flight
+static bool fat16_readahead_queue_clusters(struct fat_file_descriptor *descriptor, const uint32_t offset,
+                                           const uint32_t clusters)
+{
+    struct fat_readahead_request *request = nullptr;
+    for (int i = 0; i < FAT16_READAHEAD_REQUESTS; i++) {
+        if (!readahead_requests[i].busy) {
+            request = &readahead_requests[i];
+            break;
+        }
+    }
+    if (!request) {
+        return false;
+    }
+
+    const int cluster = fat16_get_file_cluster(descriptor, offset);
+    if (cluster < 0) {
+        return false;
+    }
+
+    request->busy     = true;
+    request->disk     = descriptor->disk;
+    request->cluster  = cluster;
+    request->clusters = clusters;
+    workqueue_queue(fat16_readahead_queue, &request->work);
+
+    return true;
+}
+
+/// @brief Largest window the file has earned: FAT16_READAHEAD_MAX while what was read ahead gets used, down to
+/// FAT16_READAHEAD_MIN when it is skipped
+static uint32_t fat16_readahead_ceiling(const struct fat_readahead *readahead)
+{
+    const uint32_t total = readahead->hits + readahead->misses;
+    if (readahead->advice == POSIX_FADV_SEQUENTIAL || total == 0) {
+        return FAT16_READAHEAD_MAX;
+    }
+
+    return FAT16_READAHEAD_MIN + (FAT16_READAHEAD_MAX - FAT16_READAHEAD_MIN) * readahead->hits / total;
+}
+
+/// @brief Called before every read. Once the file is read sequentially, keep a window of clusters read ahead of
+/// the reader, doubling it while the reader keeps using it
+static void fat16_readahead(struct fat_file_descriptor *descriptor, const uint32_t offset, const uint32_t size)
+{
+    struct fat_readahead *readahead         = &descriptor->readahead;
+    const struct fat_directory_entry *entry = descriptor->item->item;
+    const struct fat_private *private       = descriptor->disk->fs_private;
+    const uint32_t cluster_size = private->header.primary_header.sectors_per_cluster * descriptor->disk->sector_size;
+
+    if (readahead->advice == POSIX_FADV_RANDOM) {
+        return;
+    }
+
+    const uint32_t read_end = offset + size;
+    if (offset != readahead->next_offset) {
+        // A seek, whatever was read ahead past the previous read is wasted
+        if (readahead->end > readahead->next_offset) {
+            readahead->misses += readahead->end - readahead->next_offset;
+        }
+        readahead->end         = 0;
+        readahead->window      = 0;
+        readahead->next_offset = read_end;
+        return;
+    }
+    readahead->next_offset = read_end;
+
+    if (readahead->end > offset) {
+        readahead->hits += (readahead->end < read_end ? readahead->end : read_end) - offset;
+    }
+    // Keep the counts recent, what the file did long ago does not matter much
+    if (readahead->hits + readahead->misses > 1024 * 1024) {
+        readahead->hits /= 2;
+        readahead->misses /= 2;
+    }
+
+    const uint32_t ceiling = fat16_readahead_ceiling(readahead);
+    if (readahead->window == 0) {
+        readahead->window = readahead->advice == POSIX_FADV_SEQUENTIAL ? ceiling : FAT16_READAHEAD_MIN;
+    } else {
+        readahead->window = readahead->window * 2 < ceiling ? readahead->window * 2 : ceiling;
+    }
+
+    // Read ahead again once the reader is into the second half of what was read ahead
+    const uint32_t window_bytes = readahead->window * cluster_size;
+    if (readahead->end >= read_end + window_bytes / 2) {
+        return;
+    }
+
+    uint32_t start = read_end - read_end % cluster_size;
+    if (readahead->end > start) {
+        start = readahead->end;
+    }
+    uint32_t end = start + window_bytes;
+    if (end > entry->size) {
+        end = entry->size;
+    }
+    if (end <= start) {
+        return;
+    }
+
+    const uint32_t clusters = (end - start + cluster_size - 1) / cluster_size;
+    if (fat16_readahead_queue_clusters(descriptor, start, clusters)) {
+        readahead->end = end;
+    }
+}
+
 void fat16_free_directory(struct fat_directory *directory)
 {
     if (!directory) {
@@ -773,8 +1188,7 @@ struct fat_item *fat16_new_fat_item_for_directory_entry(const struct disk *disk,
         f_item->directory                  = fat16_load_fat_directory(disk, entry);
         f_item->type                       = FAT_ITEM_TYPE_DIRECTORY;
         f_item->directory->sector_position = (int)fat16_cluster_to_sector(disk->fs_private, entry->first_cluster);
-        f_item->directory->ending_sector_position =
-            f_item->directory->sector_position + (f_item->directory->entry_count * sizeof(struct fat_directory_entry));
+        f_item->directory->ending_sector_position = fat16_directory_end_sector(disk, f_item->directory);
         return f_item;
     }
 
@@ -782,49 +1196,63 @@ struct fat_item *fat16_new_fat_item_for_directory_entry(const struct disk *disk,
     return f_item;
 }
 
-struct fat_item *fat16_find_item_in_directory(const struct disk *disk, const struct fat_directory *directory,
-                                              const char *name)
+/// @brief Find the name in the directory, through the dentry cache. Names that are not in the cache are looked up in
+/// the entries of the directory, and the result is cached whether the name exists or not
+/// @param parent the entry of the directory, nullptr for the root directory
+/// @return ALL_OK with the entry of the name in out, or -ENOENT
+static int fat16_lookup(const struct disk *disk, const struct fat_directory_entry *parent, const char *name,
+                        struct fat_directory_entry *out)
 {
-    struct fat_item *f_item = {};
-    for (int i = 0; i < directory->entry_count; i++) {
-        char tmp_filename[MAX_PATH_LENGTH] = {0};
-        fat16_get_relative_filename(&directory->entries[i], tmp_filename, sizeof(tmp_filename));
-        if (istrncmp(tmp_filename, name, sizeof(tmp_filename)) == 0) {
-            return fat16_new_fat_item_for_directory_entry(disk, &directory->entries[i]);
+    const struct fat_private *fat_private = disk->fs_private;
+    const uint32_t parent_sector          = parent ? fat16_cluster_to_sector(fat_private, parent->first_cluster)
+                                                   : (uint32_t)fat_private->root_directory.sector_position;
+
+    switch (dcache_lookup(disk->id, parent_sector, name, out, sizeof(*out))) {
+    case DCACHE_HIT:
+        return ALL_OK;
+    case DCACHE_NEGATIVE:
+        return -ENOENT;
+    case DCACHE_MISS:
+        break;
+    }
+
+    struct fat_directory *loaded          = parent ? fat16_load_fat_directory(disk, parent) : nullptr;
+    const struct fat_directory *directory = parent ? loaded : &fat_private->root_directory;
+
+    int res = -ENOENT;
+    for (int i = 0; directory && i < directory->entry_count; i++) {
+        char filename[MAX_PATH_LENGTH] = {0};
+        fat16_get_relative_filename(&directory->entries[i], filename, sizeof(filename));
+        if (istrncmp(filename, name, sizeof(filename)) == 0) {
+            *out = directory->entries[i];
+            res  = ALL_OK;
+            break;
         }
     }
+    fat16_free_directory(loaded);
 
-    return f_item;
+    dcache_add(disk->id, parent_sector, name, res == ALL_OK ? out : nullptr, sizeof(*out));
+    return res;
 }
 
 struct fat_item *fat16_get_directory_entry(const struct disk *disk, const struct path_part *path)
 {
     dbgprintf("Getting directory entry for: %s\n", path->part);
-    const struct fat_private *fat_private = disk->fs_private;
-    struct fat_item *current_item         = {};
-    struct fat_item *root_item = fat16_find_item_in_directory(disk, &fat_private->root_directory, path->name);
-
-    if (!root_item) {
-        warningf("Failed to find item: %s\n", path->name);
-        goto out;
-    }
 
-    const struct path_part *next_part = path->next;
-    current_item                      = root_item;
-    while (next_part != nullptr) {
-        if (current_item->type != FAT_ITEM_TYPE_DIRECTORY) {
-            current_item = nullptr;
-            break;
+    struct fat_directory_entry entry  = {};
+    struct fat_directory_entry parent = {};
+    for (const struct path_part *part = path; part != nullptr; part = part->next) {
+        if (part != path && !(parent.attributes & FAT_FILE_SUBDIRECTORY)) {
+            return nullptr;
         }
-
-        struct fat_item *tmp_item = fat16_find_item_in_directory(disk, current_item->directory, next_part->name);
-        fat16_fat_item_free(current_item);
-        current_item = tmp_item;
-        next_part    = next_part->next;
+        if (fat16_lookup(disk, part == path ? nullptr : &parent, part->name, &entry) < 0) {
+            warningf("Failed to find item: %s\n", part->name);
+            return nullptr;
+        }
+        parent = entry;
     }
 
-out:
-    return current_item;
+    return fat16_new_fat_item_for_directory_entry(disk, &entry);
 }
 
 void *fat16_open(const struct path_root *path, const FILE_MODE mode, enum INODE_TYPE *type_out, uint32_t *size_out)
@@ -896,6 +1324,8 @@ error_out:
     return ERROR(error_code);
 }
 
+/// @brief Rewrite the directory entry on the disk, found by the name of entry. The first cluster comes from entry, a
+/// file created empty only gets one when it is first written
 int fat16_change_entry(const struct fat_directory *directory, const struct fat_directory_entry *entry,
                        const char *new_name, const char *new_ext, const uint8_t attributes, const uint32_t file_size)
 {
@@ -903,11 +1333,13 @@ int fat16_change_entry(const struct fat_directory *directory, const struct fat_d
     const uint32_t first_dir_sector = directory->sector_position;
     const uint32_t last_dir_sector  = directory->ending_sector_position;
 
+    const struct disk *disk         = disk_get(0);
+
     char cur_fullname[12] = {0};
     fat16_get_relative_filename(entry, cur_fullname, sizeof(cur_fullname));
 
     for (uint32_t dir_sector = first_dir_sector; dir_sector <= last_dir_sector; dir_sector++) {
-        if (disk_read_sector(dir_sector, buffer) < 0) {
+        if (disk_read_sector(disk, dir_sector, buffer) < 0) {
             panic("Error reading block\n");
             return -1;
         }
@@ -930,11 +1362,12 @@ int fat16_change_entry(const struct fat_directory *directory, const struct fat_d
                     memcpy(dir_entry->ext, new_ext, 3);
                 }
 
-                dir_entry->attributes = attributes;
-                dir_entry->size       = file_size;
+                dir_entry->attributes    = attributes;
+                dir_entry->size          = file_size;
+                dir_entry->first_cluster = entry->first_cluster;
 
-                disk_write_sector(dir_sector, buffer);
-                const struct disk *disk               = disk_get(0);
+                disk_write_sector(disk, dir_sector, buffer);
+                dcache_invalidate(disk->id, directory->sector_position, cur_fullname);
                 const struct fat_private *fat_private = disk->fs_private;
                 if (fat16_is_root_directory(directory, fat_private)) {
                     fat16_load_root_directory(disk);
@@ -953,9 +1386,10 @@ int fat16_add_entry(const struct fat_directory *directory, const char *name, con
     uint8_t buffer[512]             = {0};
     const uint32_t first_dir_sector = directory->sector_position;
     const uint32_t last_dir_sector  = directory->ending_sector_position;
+    const struct disk *disk         = disk_get(0);
 
     for (uint32_t dir_sector = first_dir_sector; dir_sector <= last_dir_sector; dir_sector++) {
-        if (disk_read_sector(dir_sector, buffer) < 0) {
+        if (disk_read_sector(disk, dir_sector, buffer) < 0) {
             panic("Error reading block\n");
             return -EIO;
         }
@@ -975,7 +1409,7 @@ int fat16_add_entry(const struct fat_directory *directory, const char *name, con
                 dir_entry->first_cluster = file_cluster;
                 dir_entry->size          = file_size;
 
-                disk_write_sector(dir_sector, buffer);
+                disk_write_sector(disk, dir_sector, buffer);
                 return ALL_OK;
             }
         }
@@ -983,6 +1417,8 @@ int fat16_add_entry(const struct fat_directory *directory, const char *name, con
     return -EIO;
 }
 
+/// @brief Write the data along the cluster chain, extending the chain if it is too short. Clusters that follow each
+/// other on the disk are written together
 void fat16_write_data_to_clusters(uint8_t *data, const uint16_t starting_cluster, const uint32_t size)
 {
     const struct disk *disk               = disk_get(0);
@@ -995,23 +1431,36 @@ void fat16_write_data_to_clusters(uint8_t *data, const uint16_t starting_cluster
     uint32_t data_offset     = 0;
 
     while (current_cluster < FAT16_EOC && data_offset < size) {
-        const uint32_t first_cluster_sector = fat16_cluster_to_sector(fat_private, current_cluster);
-        uint32_t bytes_to_write             = bytes_per_cluster;
-        if ((size - data_offset) < bytes_per_cluster) {
-            bytes_to_write = size - data_offset;
+        // Follow the chain for as long as it is contiguous and there is data for it
+        const uint16_t first_cluster = current_cluster;
+        uint32_t run_bytes           = bytes_per_cluster;
+        uint16_t next_cluster        = fat16_get_fat_entry(disk, current_cluster);
+        while (next_cluster == current_cluster + 1 && data_offset + run_bytes < size) {
+            current_cluster = next_cluster;
+            run_bytes += bytes_per_cluster;
+            next_cluster = fat16_get_fat_entry(disk, current_cluster);
+        }
+        if (run_bytes > size - data_offset) {
+            run_bytes = size - data_offset;
         }
 
-        // Write an entire cluster
-        disk_write_block(first_cluster_sector, sectors_per_cluster, (void *)(data + data_offset));
-        data_offset += bytes_to_write;
-
-        // Get the next cluster in the chain
-        const uint16_t next_cluster = fat16_get_fat_entry(disk, current_cluster);
+        const uint32_t first_sector = fat16_cluster_to_sector(fat_private, first_cluster);
+        const uint32_t sectors      = run_bytes / bytes_per_sector;
+        if (sectors > 0) {
+            disk_write_block(disk, first_sector, (int)sectors, data + data_offset);
+        }
+        // The data ends inside the last sector, do not read past it
+        if (run_bytes % bytes_per_sector != 0) {
+            uint8_t sector[512] = {0};
+            memcpy(sector, data + data_offset + sectors * bytes_per_sector, run_bytes % bytes_per_sector);
+            disk_write_sector(disk, first_sector + sectors, sector);
+        }
+        data_offset += run_bytes;
 
-        // If we reached the end of the chain, but we need more space, allocate a new cluster
-        // TODO: Allocate all the clusters needed at once
+        // If we reached the end of the chain, but we need more space, allocate the rest of it at once
         if (next_cluster >= FAT16_EOC && data_offset < size) {
-            const uint16_t new_cluster = fat16_allocate_new_entry(disk, 1);
+            const uint16_t clusters_needed = (size - data_offset + bytes_per_cluster - 1) / bytes_per_cluster;
+            const uint16_t new_cluster     = fat16_allocate_new_entry(disk, clusters_needed);
             fat16_set_fat_entry(current_cluster, new_cluster);
             current_cluster = new_cluster;
         } else {
@@ -1020,27 +1469,31 @@ void fat16_write_data_to_clusters(uint8_t *data, const uint16_t starting_cluster
     }
 }
 
+/// @brief Allocate a cluster chain, made of as few runs of contiguous clusters as the free space allows
+/// @return the first cluster of the chain
 uint16_t fat16_allocate_new_entry(const struct disk *disk, const uint16_t clusters_needed)
 {
-    uint16_t previous_cluster = 0;
-    uint16_t first_cluster    = 0;
-
-    for (uint32_t i = 0; i < clusters_needed; i++) {
-        const uint16_t next_cluster = (int)fat16_get_free_cluster(disk);
-        if (next_cluster > FAT16_EOC) {
+    uint16_t first_cluster = 0;
+    uint16_t last_cluster  = 0;
+    uint32_t left          = clusters_needed;
+
+    while (left > 0) {
+        uint32_t count     = left;
+        const uint16_t run  = fat16_allocate_run(&count);
+        if (run == 0) {
             panic("No free cluster found\n");
             return -EIO;
         }
 
-        if (previous_cluster != 0) {
-            // Link the next cluster in the chain
-            fat16_set_fat_entry(previous_cluster, next_cluster);
+        if (last_cluster != 0) {
+            // Link the run to the end of the chain
+            fat16_set_fat_entry(last_cluster, run);
         } else {
-            // This is the first cluster in the chain
-            first_cluster = next_cluster;
+            first_cluster = run;
         }
 
-        previous_cluster = next_cluster;
+        last_cluster = run + count - 1;
+        left -= count;
     }
 
     return first_cluster;
@@ -1082,7 +1535,7 @@ void fat16_initialize_directory(const struct disk *disk, const uint16_t cluster,
     const struct fat_private *fat_private = disk->fs_private;
     const uint32_t sector                 = fat16_cluster_to_sector(fat_private, cluster);
 
-    disk_write_sector(sector, buffer);
+    disk_write_sector(disk, sector, buffer);
 }
 
 
@@ -1094,13 +1547,18 @@ int fat16_create_directory(const char *path)
 
     struct fat_directory parent_dir = {};
     fat16_get_directory(root, &parent_dir);
-    const struct path_part *dir_part = path_parser_get_last_part(root);
-    fat16_add_entry(&parent_dir, dir_part->name, nullptr, FAT_FILE_SUBDIRECTORY, first_cluster, 0);
 
     const struct fat_private *fat_private = disk->fs_private;
     const uint16_t parent_cluster         = fat16_sector_to_cluster(fat_private, parent_dir.sector_position);
     // Initialize the new directory with '.' and '..' entries
     fat16_initialize_directory(disk, first_cluster, parent_cluster, first_cluster);
+    // The directory and its clusters must be on the disk before the parent points at them
+    disk_sync(disk);
+
+    const struct path_part *dir_part = path_parser_get_last_part(root);
+    fat16_add_entry(&parent_dir, dir_part->name, nullptr, FAT_FILE_SUBDIRECTORY, first_cluster, 0);
+    // The name may be cached as missing
+    dcache_invalidate(disk->id, parent_dir.sector_position, dir_part->name);
 
     // // Reload the root directory if the directory was created in the root directory
     if (fat16_is_root_directory(&parent_dir, fat_private)) {
@@ -1138,16 +1596,19 @@ int fat16_create_file(const char *path, void *data, const int size)
     const char *name = strtok(file_name, ".");
     const char *ext  = strtok(nullptr, ".");
 
-    res = fat16_add_entry(&parent_dir, name, ext, FAT_FILE_ARCHIVE, first_cluster, size);
-    if (res < 0) {
-        return res;
-    }
-
     if (size > 0 && data != nullptr) {
         fat16_write_data_to_clusters(data, first_cluster, size);
     }
 
-    fat16_flush_table(fat_private);
+    // The data and the cluster chain must be on the disk before the directory entry points at them
+    disk_sync(disk);
+
+    res = fat16_add_entry(&parent_dir, name, ext, FAT_FILE_ARCHIVE, first_cluster, size);
+    // The name may be cached as missing
+    dcache_invalidate(disk->id, parent_dir.sector_position, file_part->name);
+    if (res < 0) {
+        return res;
+    }
 
     // Reload the root directory if the file was created in the root directory
     if (fat16_is_root_directory(&parent_dir, fat_private)) {
@@ -1157,55 +1618,140 @@ int fat16_create_file(const char *path, void *data, const int size)
     return ALL_OK;
 }
 
+/// @brief Make the cluster chain of the file long enough to hold its first size bytes
+static int fat16_grow_chain(struct fat_file_descriptor *descriptor, const uint32_t size)
+{
+    const struct disk *disk           = descriptor->disk;
+    const struct fat_private *private = disk->fs_private;
+    struct fat_directory_entry *entry = descriptor->item->item;
+    const uint32_t cluster_size       = private->header.primary_header.sectors_per_cluster * disk->sector_size;
+    const uint32_t needed             = (size + cluster_size - 1) / cluster_size;
+
+    // An empty file needs no cluster
+    if (size == 0) {
+        return ALL_OK;
+    }
+
+    // Another descriptor of the file may have extended the chain since it was loaded
+    if (!descriptor->extents.extents || descriptor->extents.clusters < needed) {
+        const int res = fat16_load_extents(descriptor);
+        if (res < 0) {
+            return res;
+        }
+    }
+    if (descriptor->extents.clusters >= needed) {
+        return ALL_OK;
+    }
+
+    const uint16_t new_cluster = fat16_allocate_new_entry(disk, needed - descriptor->extents.clusters);
+    if (descriptor->extents.count == 0) {
+        entry->first_cluster    = new_cluster;
+        descriptor->entry_dirty = true;
+    } else {
+        const struct fat_extent *last = &descriptor->extents.extents[descriptor->extents.count - 1];
+        fat16_set_fat_entry(last->cluster + last->count - 1, new_cluster);
+    }
+
+    return fat16_load_extents(descriptor);
+}
+
+/// @brief Write to the file at its position, an extent at a time. Only the clusters in the written range are
+/// touched, and clusters are allocated only for the part past the end of the chain
 int fat16_write(const void *descriptor, const char *data, const size_t size)
 {
     // TODO: lock
-    // TODO: use stream to write data
     const struct file *desc              = descriptor;
     struct fat_file_descriptor *fat_desc = desc->fs_data;
     struct fat_directory_entry *entry    = fat_desc->item->item;
+    const struct disk *disk              = fat_desc->disk;
+    const struct fat_private *private    = disk->fs_private;
+    struct disk_stream *stream           = private->cluster_write_stream;
+    const uint32_t cluster_size          = private->header.primary_header.sectors_per_cluster * disk->sector_size;
 
-    if (entry->size - fat_desc->position < size) {
-        entry->size = fat_desc->position + size;
+    int res = fat16_grow_chain(fat_desc, fat_desc->position + size);
+    if (res < 0) {
+        return res;
     }
 
-    // Save the current write position
-    const uint32_t write_position = fat_desc->position;
-    // Set the position to the beginning of the file so we can read the existing data
-    fat_desc->position = 0;
+    uint32_t offset = fat_desc->position;
+    uint32_t left   = size;
+    while (left > 0) {
+        const struct fat_extent *extent = fat16_find_extent(fat_desc, offset);
+        if (!extent) {
+            return -EIO;
+        }
 
-    char existing_data[entry->size + 1] = {};
-    fat16_read(descriptor, entry->size, 1, (char *)existing_data);
-    // Restore the write position
-    fat_desc->position = write_position;
-    memcpy(existing_data + fat_desc->position, data, size);
+        const uint32_t extent_offset = offset - extent->file_cluster * cluster_size;
+        const uint32_t extent_left   = extent->count * cluster_size - extent_offset;
+        const uint32_t to_write      = left > extent_left ? extent_left : left;
+        const uint32_t position      = fat16_cluster_to_sector(private, (int)extent->cluster) * disk->sector_size;
 
-    const struct path_root *path_root = path_parser_parse(desc->path, nullptr);
-    struct fat_directory directory    = {};
-    fat16_get_directory(path_root, &directory);
+        res = disk_stream_seek(stream, position + extent_offset);
+        if (res != ALL_OK) {
+            return res;
+        }
+        res = disk_stream_write(stream, data, to_write);
+        if (res != ALL_OK) {
+            return res;
+        }
 
-    // Update the entry with the new size
-    fat16_change_entry(&directory, entry, (char *)entry->name, (char *)entry->ext, entry->attributes, entry->size);
+        offset += to_write;
+        left -= to_write;
+        data += to_write;
+    }
 
-    // Write the file's content
-    fat16_write_data_to_clusters((uint8_t *)existing_data, entry->first_cluster, entry->size);
-    fat_desc->position = entry->size - 1;
+    fat_desc->position = offset;
+    if (offset > entry->size) {
+        entry->size           = offset;
+        fat_desc->entry_dirty = true;
+    }
 
     return ALL_OK;
 }
 
+/// @brief Put the chain and the data of the file on the disk, then its directory entry if the size changed
+static int fat16_write_back_entry(const struct file *desc)
+{
+    struct fat_file_descriptor *fat_desc = desc->fs_data;
+    const struct disk *disk              = fat_desc->disk;
+
+    // The new size must not reach the disk before the data and the clusters it covers
+    int res = disk_sync(disk);
+    if (res < 0 || !fat_desc->entry_dirty) {
+        return res;
+    }
+
+    const struct fat_directory_entry *entry = fat_desc->item->item;
+    const struct path_root *path_root       = path_parser_parse(desc->path, nullptr);
+    struct fat_directory directory          = {};
+    res                                     = fat16_get_directory(path_root, &directory);
+    if (res < 0) {
+        return res;
+    }
+
+    res = fat16_change_entry(
+        &directory, entry, (char *)entry->name, (char *)entry->ext, entry->attributes, entry->size);
+    if (res == ALL_OK) {
+        fat_desc->entry_dirty = false;
+    }
+
+    return res;
+}
+
 int fat16_read(const void *descriptor, const size_t size, const off_t nmemb, char *out)
 {
     int res = 0;
 
-    auto const desc                            = (struct file *)descriptor;
-    const struct fat_file_descriptor *fat_desc = desc->fs_data;
-    const struct fat_directory_entry *entry    = fat_desc->item->item;
-    const struct disk *disk                    = fat_desc->disk;
-    uint32_t offset                            = fat_desc->position;
+    auto const desc                      = (struct file *)descriptor;
+    struct fat_file_descriptor *fat_desc = desc->fs_data;
+    uint32_t offset                      = fat_desc->position;
+
+    if (fat_desc->item->type == FAT_ITEM_TYPE_FILE) {
+        fat16_readahead(fat_desc, offset, size * nmemb);
+    }
 
     for (off_t i = 0; i < nmemb; i++) {
-        res = fat16_read_internal(disk, entry->first_cluster, offset, size, out);
+        res = fat16_read_file(fat_desc, offset, size, out);
         if (ISERR(res)) {
             warningf("Failed to read from file\n");
             return res;
@@ -1215,11 +1761,73 @@ int fat16_read(const void *descriptor, const size_t size, const off_t nmemb, cha
         offset += size;
     }
 
-    res = (int)nmemb * (int)size;
+    fat_desc->position = offset;
+    res                = (int)nmemb * (int)size;
 
     return res;
 }
 
+/// @brief Tune the readahead of the file to how it is going to be read
+int fat16_fadvise(void *descriptor, const uint32_t offset, const uint32_t length, const int advice)
+{
+    auto const desc                      = (struct file *)descriptor;
+    struct fat_file_descriptor *fat_desc = desc->fs_data;
+    if (fat_desc->item->type != FAT_ITEM_TYPE_FILE) {
+        return ALL_OK;
+    }
+
+    struct fat_readahead *readahead         = &fat_desc->readahead;
+    const struct fat_directory_entry *entry = fat_desc->item->item;
+    const struct fat_private *private       = fat_desc->disk->fs_private;
+    const uint32_t cluster_size = private->header.primary_header.sectors_per_cluster * fat_desc->disk->sector_size;
+
+    switch (advice) {
+    case POSIX_FADV_NORMAL:
+    case POSIX_FADV_RANDOM:
+    case POSIX_FADV_SEQUENTIAL:
+        readahead->advice = advice;
+        readahead->window = 0;
+        break;
+    case POSIX_FADV_WILLNEED: {
+        if (offset >= entry->size) {
+            break;
+        }
+        uint32_t end = length == 0 || length > entry->size - offset ? entry->size : offset + length;
+        // Reading more than half of the cache ahead would push out what was read ahead first
+        const uint32_t max_bytes = BCACHE_BUFFERS / 2 * BCACHE_SECTOR_SIZE;
+        if (end - offset > max_bytes) {
+            end = offset + max_bytes;
+        }
+
+        const uint32_t start    = offset - offset % cluster_size;
+        const uint32_t clusters = (end - start + cluster_size - 1) / cluster_size;
+        if (!fat16_readahead_queue_clusters(fat_desc, start, clusters)) {
+            return -EAGAIN;
+        }
+        break;
+    }
+    default:
+        return -EINVARG;
+    }
+
+    return ALL_OK;
+}
+
+/// @brief Put what was written to the file on the disk. The disk has no per-file tracking, so all of it is synced
+int fat16_fsync(void *descriptor)
+{
+    auto const desc                            = (struct file *)descriptor;
+    const struct fat_file_descriptor *fat_desc = desc->fs_data;
+
+    const int res = fat16_write_back_entry(desc);
+    if (res < 0) {
+        return res;
+    }
+
+    // The directory entry
+    return disk_sync(fat_desc->disk);
+}
+
 int fat16_seek(void *private, const uint32_t offset, const enum FILE_SEEK_MODE seek_mode)
 {
     int res = 0;
@@ -1322,14 +1930,22 @@ static void fat16_free_file_descriptor(struct fat_file_descriptor *descriptor)
     }
 
     fat16_fat_item_free(descriptor->item);
+    fat16_drop_extents(descriptor);
     kfree(descriptor);
 }
 
 int fat16_close(void *descriptor)
 {
-    auto const desc = (struct file *)descriptor;
+    auto const desc                            = (struct file *)descriptor;
+    const struct fat_file_descriptor *fat_desc = desc->fs_data;
+
+    int res = ALL_OK;
+    if (fat_desc->item->type == FAT_ITEM_TYPE_FILE && fat_desc->entry_dirty) {
+        res = fat16_write_back_entry(desc);
+    }
+
     fat16_free_file_descriptor(desc->fs_data);
-    return ALL_OK;
+    return res;
 }
 
 int fat16_get_directory(const struct path_root *path_root, struct fat_directory *fat_directory)
@@ -1345,36 +1961,37 @@ int fat16_get_directory(const struct path_root *path_root, struct fat_directory
         return ALL_OK;
     }
 
-    auto path_part                = path_root->first;
-    struct fat_item *current_item = fat16_find_item_in_directory(disk, &fat_private->root_directory, path_part->name);
-    // If the first part of the path is not found in the root directory, then we also return the root directory
-    if (current_item == nullptr || current_item->type == FAT_ITEM_TYPE_FILE) {
+    // Walk down the directories of the path, the last one that exists is the one asked for
+    struct fat_directory_entry directory_entry = {};
+    bool found                                 = false;
+    for (auto path_part = path_root->first; path_part != nullptr; path_part = path_part->next) {
+        struct fat_directory_entry entry = {};
+        if (fat16_lookup(disk, found ? &directory_entry : nullptr, path_part->name, &entry) < 0 ||
+            !(entry.attributes & FAT_FILE_SUBDIRECTORY)) {
+            break;
+        }
+        directory_entry = entry;
+        found           = true;
+    }
+
+    // If the first part of the path is not a directory in the root directory, then we return the root directory
+    if (!found) {
         fat16_load_root_directory(disk);
         const struct fat_directory *root_directory = &fat_private->root_directory;
         *fat_directory                             = *root_directory;
         return ALL_OK;
     }
-    path_part = path_part->next;
-
-    while (path_part != nullptr && current_item != nullptr) {
-        struct fat_item *next_item = fat16_find_item_in_directory(disk, current_item->directory, path_part->name);
-        if (next_item == nullptr || next_item->type != FAT_ITEM_TYPE_DIRECTORY) {
-            fat16_fat_item_free(current_item);
-            break;
-        }
-        fat16_fat_item_free(current_item);
-        current_item = next_item;
-        path_part    = path_part->next;
-    }
 
-    if (current_item == nullptr) {
+    struct fat_directory *directory = fat16_load_fat_directory(disk, &directory_entry);
+    if (directory == nullptr) {
         return -ENOENT;
     }
+    directory->sector_position        = (int)fat16_cluster_to_sector(fat_private, directory_entry.first_cluster);
+    directory->ending_sector_position = fat16_directory_end_sector(disk, directory);
 
-    ASSERT(current_item);
-    ASSERT(current_item->directory);
-
-    *fat_directory = *current_item->directory;
+    // The entries now belong to the caller
+    *fat_directory = *directory;
+    kfree(directory);
 
     return ALL_OK;
 }
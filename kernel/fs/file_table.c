@@ -0,0 +1,174 @@
+#include <assert.h>
+#include <file_table.h>
+#include <kernel.h>
+#include <kernel_heap.h>
+#include <memory.h>
+#include <status.h>
+#include <vfs.h>
+
+#define FILE_TABLE_WORD_BITS 32
+
+struct file_table *file_table_create(void)
+{
+    struct file_table *table = kzalloc(sizeof(struct file_table));
+    if (!table) {
+        return nullptr;
+    }
+
+    table->refcount = 1;
+    table->size     = FILE_TABLE_INLINE_SLOTS;
+    table->files    = table->inline_files;
+    table->used     = table->inline_used;
+
+    return table;
+}
+
+/// @brief Take another reference to the table, used by fork()
+struct file_table *file_table_share(struct file_table *table)
+{
+    table->refcount++;
+    return table;
+}
+
+static void file_table_free(struct file_table *table)
+{
+    if (table->files != table->inline_files) {
+        kfree(table->files);
+        kfree(table->used);
+    }
+    kfree(table);
+}
+
+/// @brief Double the table, up to MAX_FILE_DESCRIPTORS descriptors
+static int file_table_grow(struct file_table *table)
+{
+    if (table->size >= MAX_FILE_DESCRIPTORS) {
+        return -EBUFFULL;
+    }
+
+    const int size   = table->size * 2 > MAX_FILE_DESCRIPTORS ? MAX_FILE_DESCRIPTORS : table->size * 2;
+    auto const files = (struct file **)kzalloc(size * sizeof(struct file *));
+    auto const used  = (uint32_t *)kzalloc(size / FILE_TABLE_WORD_BITS * sizeof(uint32_t));
+    if (!files || !used) {
+        if (files) {
+            kfree(files);
+        }
+        if (used) {
+            kfree(used);
+        }
+        return -ENOMEM;
+    }
+
+    memcpy(files, table->files, table->size * sizeof(struct file *));
+    memcpy(used, table->used, table->size / FILE_TABLE_WORD_BITS * sizeof(uint32_t));
+    if (table->files != table->inline_files) {
+        kfree(table->files);
+        kfree(table->used);
+    }
+
+    table->files = files;
+    table->used  = used;
+    table->size  = size;
+
+    return ALL_OK;
+}
+
+/// @brief Get a table the caller can change. A shared table is copied, and the files in it are shared by both
+/// copies, so they keep one offset like after a POSIX fork().
+/// @param table the table of the caller, or nullptr if it has none yet
+struct file_table *file_table_unshare(struct file_table *table)
+{
+    if (!table) {
+        return file_table_create();
+    }
+    if (table->refcount == 1) {
+        return table;
+    }
+
+    struct file_table *copy = file_table_create();
+    if (!copy) {
+        return nullptr;
+    }
+    while (copy->size < table->size) {
+        if (file_table_grow(copy) < 0) {
+            file_table_free(copy);
+            return nullptr;
+        }
+    }
+
+    for (int i = 0; i < table->size / FILE_TABLE_WORD_BITS; i++) {
+        copy->used[i] = table->used[i];
+    }
+    for (int fd = 0; fd < table->size; fd++) {
+        copy->files[fd] = table->files[fd];
+        if (copy->files[fd]) {
+            copy->files[fd]->refcount++;
+        }
+    }
+
+    table->refcount--;
+    return copy;
+}
+
+/// @brief Drop a reference to the table, the last one closes every file in it
+int file_table_put(struct file_table *table)
+{
+    ASSERT(table->refcount > 0, "File table already released");
+    if (--table->refcount > 0) {
+        return ALL_OK;
+    }
+
+    for (int fd = 0; fd < table->size; fd++) {
+        if (table->files[fd]) {
+            vfs_file_put(table->files[fd]);
+        }
+    }
+    file_table_free(table);
+
+    return ALL_OK;
+}
+
+/// @brief Put the file in the lowest free descriptor
+/// @return the descriptor
+int file_table_install(struct file_table *table, struct file *file)
+{
+    ASSERT(table->refcount == 1, "Changing a shared file table");
+
+    while (true) {
+        for (int word = 0; word < table->size / FILE_TABLE_WORD_BITS; word++) {
+            if (table->used[word] == ~0U) {
+                continue;
+            }
+
+            const int fd = word * FILE_TABLE_WORD_BITS + __builtin_ctz(~table->used[word]);
+            table->used[word] |= 1U << (fd % FILE_TABLE_WORD_BITS);
+            table->files[fd] = file;
+            file->index      = fd;
+
+            return fd;
+        }
+
+        const int res = file_table_grow(table);
+        if (res < 0) {
+            return res;
+        }
+    }
+}
+
+struct file *file_table_get(const struct file_table *table, const int fd)
+{
+    if (fd < 0 || fd >= table->size) {
+        return nullptr;
+    }
+
+    return table->files[fd];
+}
+
+void file_table_remove(struct file_table *table, const int fd)
+{
+    ASSERT(table->refcount == 1, "Changing a shared file table");
+    ASSERT(fd >= 0 && fd < table->size, "Invalid file descriptor");
+
+    table->files[fd] = nullptr;
+    table->used[fd / FILE_TABLE_WORD_BITS] &= ~(1U << (fd % FILE_TABLE_WORD_BITS));
+}
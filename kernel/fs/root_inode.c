@@ -2,6 +2,7 @@
 #include <memfs.h>
 #include <null.h>
 #include <root_inode.h>
+#include <serial_tty.h>
 #include <string.h>
 #include <tty.h>
 #include <vfs.h>
@@ -44,6 +45,7 @@ void root_inode_init(void)
     null_init();
     tty_init();
     random_init();
+    serial_tty_init();
 }
 
 int root_inode_lookup(const char *name, struct inode **inode)
@@ -1,7 +1,9 @@
 #include <config.h>
+#include <dcache.h>
 #include <debug.h>
 #include <disk.h>
 #include <fat16.h>
+#include <fcntl.h>
 #include <kernel.h>
 #include <kernel_heap.h>
 #include <memfs.h>
@@ -98,6 +100,7 @@ void vfs_init()
     memset(mount_points, 0, sizeof(mount_points));
     memset(file_descriptors, 0, sizeof(file_descriptors));
 
+    dcache_init();
     fs_load();
 }
 
@@ -322,6 +325,55 @@ int vfs_seek(const int fd, const int offset, const enum FILE_SEEK_MODE whence)
     return desc->inode->ops->seek(desc, offset, whence);
 }
 
+/// @brief Pass the access pattern of the file to its file system. The advice is only a hint, file systems that do not
+/// read ahead ignore it
+int vfs_fadvise(const int fd, const uint32_t offset, const uint32_t length, const int advice)
+{
+    if (advice < POSIX_FADV_NORMAL || advice > POSIX_FADV_WILLNEED) {
+        return -EINVARG;
+    }
+
+    struct file *desc;
+    struct process *current_process = scheduler_get_current_process();
+    if (current_process) {
+        desc = process_get_file_descriptor(current_process, fd);
+    } else {
+        desc = sys_get_file_descriptor(fd);
+    }
+    if (!desc) {
+        warningf("Invalid file descriptor\n");
+        return -EINVARG;
+    }
+
+    if (!desc->inode->ops->fadvise) {
+        return ALL_OK;
+    }
+
+    return desc->inode->ops->fadvise(desc, offset, length, advice);
+}
+
+/// @brief Put what was written to the file on the medium. Files that do not live on a disk have nothing to do
+int vfs_fsync(const int fd)
+{
+    struct file *desc;
+    struct process *current_process = scheduler_get_current_process();
+    if (current_process) {
+        desc = process_get_file_descriptor(current_process, fd);
+    } else {
+        desc = sys_get_file_descriptor(fd);
+    }
+    if (!desc) {
+        warningf("Invalid file descriptor\n");
+        return -EINVARG;
+    }
+
+    if (!desc->inode->ops->fsync) {
+        return ALL_OK;
+    }
+
+    return desc->inode->ops->fsync(desc);
+}
+
 int vfs_read(void *ptr, const uint32_t size, const uint32_t nmemb, const int fd)
 {
     struct file *desc;
@@ -353,15 +405,36 @@ int vfs_close(const int fd)
         return -EINVARG;
     }
 
-    const int res = desc->inode->ops->close(desc);
+    if (current_process) {
+        return process_free_file_descriptor(current_process, desc);
+    }
 
+    const int res = desc->inode->ops->close(desc);
     if (res == ALL_OK) {
-        if (current_process) {
-            process_free_file_descriptor(current_process, desc);
-        } else {
-            sys_free_file_descriptor(desc);
+        sys_free_file_descriptor(desc);
+    }
+
+    return res;
+}
+
+/// @brief Drop a reference to an open file of a process, the last one closes it
+int vfs_file_put(struct file *file)
+{
+    ASSERT(file->refcount > 0, "File already closed");
+    if (--file->refcount > 0) {
+        return ALL_OK;
+    }
+
+    const int res = file->inode->ops->close(file);
+
+    // Do not free device inodes
+    if (file->inode && file->inode->type != INODE_DEVICE && file->fs_type != FS_TYPE_RAMFS) {
+        if (file->inode->data) {
+            kfree(file->inode->data);
         }
+        kfree(file->inode);
     }
+    kfree(file);
 
     return res;
 }
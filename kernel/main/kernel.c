@@ -1,11 +1,14 @@
 #include <debug.h>
 #include <disk.h>
+#include <fpu.h>
+#include <futex.h>
 #include <gdt.h>
 #include <idt.h>
 #include <io.h>
 #include <kernel.h>
 #include <kernel_heap.h>
 #include <keyboard.h>
+#include <kthread.h>
 #include <net/network.h>
 #include <paging.h>
 #include <pci.h>
@@ -19,6 +22,7 @@
 #include <syscall.h>
 #include <vfs.h>
 #include <vga_buffer.h>
+#include <workqueue.h>
 #include <x86.h>
 
 void display_grub_info(const multiboot_info_t *mbd, unsigned int magic);
@@ -69,13 +73,18 @@ void kernel_main(const multiboot_info_t *mbd, const uint32_t magic)
     idt_init();
     pic_init();
     pit_init();
+    fpu_init();
     display_grub_info(mbd, magic);
     init_symbols(mbd);
     scheduler_init();
+    futex_init();
+    kthread_init();
+    workqueue_init();
     vfs_init();
+    disk_init();
     pci_scan();
     wait_for_network();
-    disk_init();
+    disk_mount_root();
     root_inode_init();
 
     register_syscalls();
@@ -84,12 +93,13 @@ void kernel_main(const multiboot_info_t *mbd, const uint32_t magic)
 
 
     printf("\nStarting the shell");
+    // Headless runs (scripts/bench.py) wait for this line before typing into the shell
+    serial_write("Starting the shell\n");
 
     start_shell(0);
 
-    schedule();
-
-    panic("Kernel finished");
+    // The boot context becomes the idle thread
+    scheduler_idle_thread();
 }
 
 void start_shell(const int console)
@@ -138,6 +148,8 @@ void display_grub_info(const multiboot_info_t *mbd, const unsigned int magic)
 
 void system_reboot()
 {
+    disk_sync_all();
+
     uint8_t good = 0x02;
     while (good & 0x02)
         good = inb(0x64);
@@ -146,6 +158,8 @@ void system_reboot()
 
 void system_shutdown()
 {
+    disk_sync_all();
+
     outw(0x604, 0x2000);
 
     hlt();
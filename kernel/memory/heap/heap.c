@@ -255,6 +255,9 @@ void *heap_realloc(const struct heap *heap, void *ptr, const size_t size)
     const size_t aligned_size    = heap_align_value_to_upper(size);
     const uint32_t blocks_needed = aligned_size / HEAP_BLOCK_SIZE;
     void *new_ptr                = heap_malloc_blocks(heap, blocks_needed);
+    if (!new_ptr) {
+        return nullptr;
+    }
 
     const uint32_t old_blocks = heap_number_of_blocks(heap, ptr);
 
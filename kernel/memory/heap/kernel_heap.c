@@ -4,6 +4,7 @@
 #include <kernel.h>
 #include <kernel_heap.h>
 #include <memory.h>
+#include <oom.h>
 #include <serial.h>
 
 struct heap kernel_heap;
@@ -31,6 +32,10 @@ void *kmalloc(const size_t size)
 {
     allocations++;
     void *result = heap_malloc(&kernel_heap, size);
+    // Every process the OOM killer frees gives its heap blocks back, try again until it gives up
+    while (!result && oom_kill()) {
+        result = heap_malloc(&kernel_heap, size);
+    }
     dbgprintf("kmalloc(): %p\t", result);
     return result;
 }
@@ -39,8 +44,9 @@ void *kzalloc(const size_t size)
 {
     void *ptr = kmalloc(size);
     if (!ptr) {
+        // Nothing the OOM killer could free, the caller cannot cope with a failure
         warningf("Failed to allocate memory\n");
-        ASSERT(false, "Failed to allocate memory");
+        ASSERT(false, "Out of memory");
         return NULL;
     }
     memset(ptr, 0x00, size);
@@ -49,7 +55,21 @@ void *kzalloc(const size_t size)
 
 void *krealloc(void *ptr, const size_t size)
 {
-    return heap_realloc(&kernel_heap, ptr, size);
+    void *result = heap_realloc(&kernel_heap, ptr, size);
+    while (!result && oom_kill()) {
+        result = heap_realloc(&kernel_heap, ptr, size);
+    }
+    return result;
+}
+
+/// @brief Bytes of heap taken by an allocation, whole blocks included
+size_t ksize(const void *ptr)
+{
+    if (!ptr) {
+        return 0;
+    }
+
+    return heap_number_of_blocks(&kernel_heap, (void *)ptr) * HEAP_BLOCK_SIZE;
 }
 
 void kfree(void *ptr)
@@ -83,6 +83,16 @@ void paging_free_directory(struct page_directory *page_directory)
     kfree(page_directory);
 }
 
+/// @brief Kernel heap taken by the directory and its page tables
+size_t paging_directory_size(const struct page_directory *page_directory)
+{
+    // paging_create_directory allocates every page table up front, they all have the same size
+    const auto first_table = (uint32_t *)(page_directory->directory_entry[0] & 0xfffff000);
+
+    return ksize(page_directory) + ksize(page_directory->directory_entry) +
+        PAGING_ENTRIES_PER_DIRECTORY * ksize(first_table);
+}
+
 void paging_switch_directory(const struct page_directory *directory)
 {
     ASSERT(directory->directory_entry);
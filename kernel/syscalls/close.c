@@ -3,7 +3,7 @@
 #include <vfs.h>
 #include <x86.h>
 
-spinlock_t close_lock = 0;
+spinlock_t close_lock = SPINLOCK_INITIALIZER("close");
 
 void *sys_close(struct interrupt_frame *frame)
 {
@@ -7,7 +7,7 @@
 #include <syscall.h>
 #include <thread.h>
 
-spinlock_t create_process_lock = 0;
+spinlock_t create_process_lock = SPINLOCK_INITIALIZER("create_process");
 
 void *sys_create_process(struct interrupt_frame *frame)
 {
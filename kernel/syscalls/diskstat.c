@@ -0,0 +1,28 @@
+#include <block.h>
+#include <disk.h>
+#include <diskstat.h>
+#include <kernel.h>
+#include <scheduler.h>
+#include <status.h>
+#include <syscall.h>
+#include <thread.h>
+
+// int diskstat(int disk, struct disk_stat *stat)
+void *sys_diskstat(struct interrupt_frame *frame)
+{
+    const int index = get_integer_argument(1);
+    void *stat_ptr  = get_pointer_argument(0);
+
+    const struct disk *disk = disk_get(index);
+    if (!disk || !stat_ptr) {
+        return ERROR(-EINVARG);
+    }
+
+    struct disk_stat *stat = thread_virtual_to_physical_address(scheduler_get_current_thread(), stat_ptr);
+    if (!stat) {
+        return ERROR(-EFAULT);
+    }
+    block_get_stats(disk, stat);
+
+    return (void *)ALL_OK;
+}
@@ -2,13 +2,14 @@
 #include <kernel_heap.h>
 #include <printf.h>
 #include <scheduler.h>
+#include <serial.h>
 #include <spinlock.h>
 #include <string.h>
 #include <syscall.h>
 #include <thread.h>
 #include <vfs.h>
 
-spinlock_t exec_lock = 0;
+spinlock_t exec_lock = SPINLOCK_INITIALIZER("exec");
 
 
 // TODO: Simplify this
@@ -16,6 +17,9 @@ spinlock_t exec_lock = 0;
 // int exec(const char *path, const char *argv[])
 void *sys_exec(struct interrupt_frame *frame)
 {
+    // The other threads may have to be waited for, which cannot happen with the lock held
+    process_stop_threads(scheduler_get_current_process());
+
     spin_lock(&exec_lock);
 
     const void *path_ptr  = thread_peek_stack_item(scheduler_get_current_thread(), 1);
@@ -63,13 +67,18 @@ void *sys_exec(struct interrupt_frame *frame)
 
     struct process *process = scheduler_get_current_process();
     process_free_allocations(process);
+    // Every thread of the process goes away, the calling one is released once we schedule below
+    process_free_threads(process);
+    // The new image starts without the threads that were stopped for it
+    process->killed = false;
+    process_unmap_memory(process);
     process_free_program_data(process);
+    process->pointer = nullptr;
     kfree(process->stack);
     process->stack = nullptr;
     paging_free_directory(process->page_directory);
-    thread_free(process->thread);
-    process->thread = nullptr;
-    process_unmap_memory(process);
+    // The new main thread creates a fresh page directory
+    process->page_directory = nullptr;
 
     char full_path[MAX_PATH_LENGTH] = {0};
     if (istrncmp(path, "/", 1) != 0) {
@@ -81,9 +90,16 @@ void *sys_exec(struct interrupt_frame *frame)
 
     const int res = process_load_data(full_path, process);
     if (res < 0) {
-        printf("Result: %d\n", res);
+        // The old image is already gone, so there is nothing left to return to
+        warningf("Failed to load %s: %d\n", full_path, res);
+        process->exit_code = res;
+        process_zombify(process);
+        if (!process->parent) {
+            process_release(process);
+        }
         spin_unlock(&exec_lock);
-        return (void *)res;
+        schedule();
+        panic("Trying to schedule a dead thread");
     }
     void *program_stack_pointer = kzalloc(USER_STACK_SIZE);
     strncpy(process->file_name, full_path, sizeof(process->file_name));
@@ -97,10 +113,12 @@ void *sys_exec(struct interrupt_frame *frame)
 
     process_inject_arguments(process, root_argument);
 
-    scheduler_set_process(process->pid, process);
     scheduler_queue_thread(thread);
 
     spin_unlock(&exec_lock);
 
-    return nullptr;
+    // The calling thread was retired above, the new thread starts in user mode at the program entry point
+    schedule();
+
+    panic("Trying to schedule a dead thread");
 }
@@ -0,0 +1,21 @@
+#include <fcntl.h>
+#include <kernel.h>
+#include <status.h>
+#include <syscall.h>
+#include <vfs.h>
+
+// int posix_fadvise(int fd, off_t offset, off_t length, int advice)
+// A length of 0 means up to the end of the file
+void *sys_fadvise(struct interrupt_frame *frame)
+{
+    const int fd     = get_integer_argument(3);
+    const int offset = get_integer_argument(2);
+    const int length = get_integer_argument(1);
+    const int advice = get_integer_argument(0);
+
+    if (offset < 0 || length < 0) {
+        return ERROR(-EINVARG);
+    }
+
+    return (void *)vfs_fadvise(fd, offset, length, advice);
+}
@@ -1,16 +1,21 @@
+#include <kernel.h>
 #include <process.h>
 #include <scheduler.h>
 #include <spinlock.h>
 #include <syscall.h>
 
-spinlock_t fork_lock = 0;
+spinlock_t fork_lock = SPINLOCK_INITIALIZER("fork");
 
 void *sys_fork(struct interrupt_frame *frame)
 {
     spin_lock(&fork_lock);
 
-    auto const parent            = scheduler_get_current_process();
-    auto const child             = process_clone(parent);
+    auto const parent = scheduler_get_current_process();
+    auto const child  = process_clone(parent);
+    if (ISERR(child)) {
+        spin_unlock(&fork_lock);
+        return child;
+    }
     child->thread->registers.eax = 0;
 
     spin_unlock(&fork_lock);
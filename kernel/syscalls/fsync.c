@@ -0,0 +1,10 @@
+#include <syscall.h>
+#include <vfs.h>
+
+// int fsync(int fd)
+void *sys_fsync(struct interrupt_frame *frame)
+{
+    const int fd = get_integer_argument(0);
+
+    return (void *)vfs_fsync(fd);
+}
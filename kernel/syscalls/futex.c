@@ -0,0 +1,24 @@
+#include <futex.h>
+#include <kernel.h>
+#include <scheduler.h>
+#include <status.h>
+#include <syscall.h>
+
+// int futex(int *address, int operation, int value)
+void *sys_futex(struct interrupt_frame *frame)
+{
+    void *address       = get_pointer_argument(2);
+    const int operation = get_integer_argument(1);
+    const int value     = get_integer_argument(0);
+
+    auto const thread = scheduler_get_current_thread();
+
+    switch (operation) {
+    case FUTEX_WAIT:
+        return (void *)futex_wait(thread, address, value);
+    case FUTEX_WAKE:
+        return (void *)futex_wake(thread, address, value);
+    default:
+        return ERROR(-EINVARG);
+    }
+}
@@ -6,7 +6,7 @@
 #include <thread.h>
 #include <vfs.h>
 
-spinlock_t open_lock = 0;
+spinlock_t open_lock = SPINLOCK_INITIALIZER("open");
 
 void *sys_open(struct interrupt_frame *frame)
 {
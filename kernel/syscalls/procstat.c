@@ -0,0 +1,24 @@
+#include <kernel.h>
+#include <procstat.h>
+#include <scheduler.h>
+#include <status.h>
+#include <syscall.h>
+#include <thread.h>
+
+// int procstat(struct cpu_stat *cpu, struct thread_stat *threads, int max)
+void *sys_procstat(struct interrupt_frame *frame)
+{
+    void *cpu_ptr     = get_pointer_argument(2);
+    void *threads_ptr = get_pointer_argument(1);
+    const int max     = get_integer_argument(0);
+
+    if (!cpu_ptr || !threads_ptr || max < 0) {
+        return ERROR(-EINVARG);
+    }
+
+    auto const thread           = scheduler_get_current_thread();
+    struct cpu_stat *cpu        = thread_virtual_to_physical_address(thread, cpu_ptr);
+    struct thread_stat *threads = thread_virtual_to_physical_address(thread, threads_ptr);
+
+    return (void *)scheduler_get_thread_stats(cpu, threads, max);
+}
@@ -1,16 +1,25 @@
+#include <bcache.h>
+#include <block.h>
+#include <dcache.h>
+#include <kernel_heap.h>
 #include <printf.h>
 #include <scheduler.h>
+#include <softirq.h>
+#include <spinlock.h>
 #include <string.h>
 #include <syscall.h>
 #include <termcolors.h>
+#include <workqueue.h>
 
 // TODO: Re-implement this in userland using a device file
 void *sys_ps(struct interrupt_frame *frame)
 {
     struct process_info *proc_info = nullptr;
     int count                      = 0;
-    scheduler_get_processes(&proc_info, &count);
-    printf(KBBLU "\n %-5s%-15s%-12s%-12s%-12s\n" KWHT, "PID", "Name", "Priority", "State", "Exit code");
+    if (scheduler_get_processes(&proc_info, &count) < 0) {
+        return nullptr;
+    }
+    printf(KBBLU "\n %-5s%-15s%-12s%-12s%-12s%-12s\n" KWHT, "PID", "Name", "Priority", "State", "Exit code", "Memory");
     for (int i = 0; i < count; i++) {
         constexpr int col               = 15;
         const struct process_info *info = &proc_info[i];
@@ -34,8 +43,22 @@ void *sys_ps(struct interrupt_frame *frame)
             break;
         }
 
-        printf(" %-5u%-15s%-12u%-12s%-12u\n", info->pid, info->file_name, info->priority, state, info->exit_code);
+        printf(" %-5u%-15s%-12u%-12s%-12d%lu KiB\n",
+               info->pid,
+               info->file_name,
+               info->priority,
+               state,
+               info->exit_code,
+               info->memory / 1024);
     }
+    kfree(proc_info);
+
+    softirq_print_stats();
+    workqueue_print_stats();
+    spinlock_print_stats();
+    bcache_print_stats();
+    dcache_print_stats();
+    block_print_stats();
 
     return nullptr;
 }
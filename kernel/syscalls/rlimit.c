@@ -0,0 +1,45 @@
+#include <kernel.h>
+#include <resource.h>
+#include <scheduler.h>
+#include <status.h>
+#include <syscall.h>
+#include <thread.h>
+
+// int rlimit(int resource, const struct rlimit *new_limit, struct rlimit *old_limit)
+// Either pointer can be NULL, old_limit gets the limit in place before new_limit is applied
+void *sys_rlimit(struct interrupt_frame *frame)
+{
+    const int resource = get_integer_argument(2);
+    void *new_ptr      = get_pointer_argument(1);
+    void *old_ptr      = get_pointer_argument(0);
+
+    if (resource < 0 || resource >= RLIMIT_COUNT) {
+        return ERROR(-EINVARG);
+    }
+
+    auto const thread  = scheduler_get_current_thread();
+    auto const process = thread->process;
+
+    struct rlimit new_limit;
+    if (new_ptr) {
+        const struct rlimit *limit = thread_virtual_to_physical_address(thread, new_ptr);
+        if (!limit) {
+            return ERROR(-EFAULT);
+        }
+        new_limit = *limit;
+    }
+
+    if (old_ptr) {
+        struct rlimit *old_limit = thread_virtual_to_physical_address(thread, old_ptr);
+        if (!old_limit) {
+            return ERROR(-EFAULT);
+        }
+        *old_limit = process->limits[resource];
+    }
+
+    if (new_ptr) {
+        return (void *)process_set_limit(process, resource, &new_limit);
+    }
+
+    return (void *)ALL_OK;
+}
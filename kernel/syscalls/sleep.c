@@ -4,13 +4,19 @@
 
 void *sys_sleep(struct interrupt_frame *frame)
 {
-    const int time                               = get_integer_argument(0);
-    const uint32_t jiffies                       = scheduler_get_jiffies();
-    const uint32_t end                           = jiffies + time;
-    scheduler_get_current_process()->state       = SLEEPING;
-    scheduler_get_current_process()->sleep_until = end;
+    const int time         = get_integer_argument(0);
+    const uint32_t jiffies = scheduler_get_jiffies();
+    const uint32_t end     = jiffies + time;
+    auto const thread      = scheduler_get_current_thread();
 
-    schedule();
+    thread->sleep_reason = SLEEP_REASON_NONE;
+    thread->sleep_until  = end;
+    thread->state        = SLEEPING;
+
+    // The scheduler wakes us up once the time has passed
+    while (thread->state == SLEEPING) {
+        schedule();
+    }
 
     return nullptr;
 }
@@ -0,0 +1,11 @@
+#include <disk.h>
+#include <syscall.h>
+
+// void sync(void)
+// Put everything written to every disk on the medium
+void *sys_sync(struct interrupt_frame *frame)
+{
+    disk_sync_all();
+
+    return nullptr;
+}
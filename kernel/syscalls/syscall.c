@@ -36,6 +36,16 @@ void register_syscalls()
     register_syscall(SYSCALL_YIELD, sys_yield);
     register_syscall(SYSCALL_PS, sys_ps);
     register_syscall(SYSCALL_MEMSTAT, sys_memstat);
+    register_syscall(SYSCALL_THREAD_CREATE, sys_thread_create);
+    register_syscall(SYSCALL_THREAD_EXIT, sys_thread_exit);
+    register_syscall(SYSCALL_THREAD_JOIN, sys_thread_join);
+    register_syscall(SYSCALL_FUTEX, sys_futex);
+    register_syscall(SYSCALL_PROCSTAT, sys_procstat);
+    register_syscall(SYSCALL_RLIMIT, sys_rlimit);
+    register_syscall(SYSCALL_FADVISE, sys_fadvise);
+    register_syscall(SYSCALL_DISKSTAT, sys_diskstat);
+    register_syscall(SYSCALL_SYNC, sys_sync);
+    register_syscall(SYSCALL_FSYNC, sys_fsync);
 }
 
 /// @brief Get the pointer argument from the stack of the current task
@@ -0,0 +1,21 @@
+#include <kernel.h>
+#include <scheduler.h>
+#include <syscall.h>
+#include <thread.h>
+
+// int thread_create(void (*entry)(void *(*)(void *), void *), void *(*start_routine)(void *), void *arg)
+void *sys_thread_create(struct interrupt_frame *frame)
+{
+    const uint32_t entry         = (uint32_t)get_pointer_argument(2);
+    const uint32_t start_routine = (uint32_t)get_pointer_argument(1);
+    const uint32_t arg           = (uint32_t)get_pointer_argument(0);
+
+    auto const thread = thread_spawn(scheduler_get_current_process(), entry, start_routine, arg);
+    if (ISERR(thread)) {
+        return thread;
+    }
+
+    scheduler_queue_thread(thread);
+
+    return (void *)thread->tid;
+}
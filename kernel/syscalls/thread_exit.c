@@ -0,0 +1,18 @@
+#include <process.h>
+#include <scheduler.h>
+#include <syscall.h>
+#include <thread.h>
+
+// void thread_exit(int exit_code)
+[[noreturn]] void *sys_thread_exit(struct interrupt_frame *frame)
+{
+    const int exit_code = get_integer_argument(0);
+    auto const thread   = scheduler_get_current_thread();
+
+    // The last thread to exit ends the process
+    if (process_get_thread_count(thread->process) == 1) {
+        sys_exit(frame);
+    }
+
+    thread_exit(thread, exit_code);
+}
@@ -0,0 +1,23 @@
+#include <scheduler.h>
+#include <status.h>
+#include <syscall.h>
+#include <thread.h>
+
+// int thread_join(int tid, int *exit_code)
+void *sys_thread_join(struct interrupt_frame *frame)
+{
+    const int tid     = get_integer_argument(1);
+    void *virtual_ptr = get_pointer_argument(0);
+    int *exit_code    = nullptr;
+    if (virtual_ptr) {
+        exit_code = thread_virtual_to_physical_address(scheduler_get_current_thread(), virtual_ptr);
+    }
+
+    int code      = 0;
+    const int res = thread_join(scheduler_get_current_thread(), tid, &code);
+    if (res == ALL_OK && exit_code) {
+        *exit_code = code;
+    }
+
+    return (void *)res;
+}
@@ -3,7 +3,7 @@
 #include <syscall.h>
 #include <thread.h>
 
-spinlock_t wait_lock = 0;
+spinlock_t wait_lock = SPINLOCK_INITIALIZER("wait");
 
 void *sys_wait_pid(struct interrupt_frame *frame)
 {
@@ -0,0 +1,71 @@
+#include <accounting.h>
+#include <thread.h>
+#include <x86.h>
+
+// The time between two accounting points is charged to user mode or kernel mode of the running thread. The points
+// are the entries into the kernel (interrupts and syscalls), the returns to user mode and the context switches.
+// Time spent in interrupt handlers is charged to whatever thread they interrupted.
+
+/// @brief The thread trapped into the kernel from user mode
+void accounting_enter_kernel(struct thread *thread)
+{
+    const uint64_t now = rdtsc();
+
+    thread->accounting.user_cycles += now - thread->accounting.last_timestamp;
+    thread->accounting.last_timestamp = now;
+}
+
+/// @brief The thread is about to return to user mode
+void accounting_leave_kernel(struct thread *thread)
+{
+    const uint64_t now = rdtsc();
+
+    thread->accounting.kernel_cycles += now - thread->accounting.last_timestamp;
+    thread->accounting.last_timestamp = now;
+}
+
+/// @brief Charge prev for its time in the kernel and start the clock for next
+/// @param involuntary prev was preempted rather than blocking or yielding
+void accounting_switch(struct thread *prev, struct thread *next, const bool involuntary)
+{
+    const uint64_t now = rdtsc();
+
+    prev->accounting.kernel_cycles += now - prev->accounting.last_timestamp;
+    if (involuntary) {
+        prev->accounting.involuntary_switches++;
+    } else {
+        prev->accounting.voluntary_switches++;
+    }
+
+    next->accounting.last_timestamp = now;
+    if (next->accounting.runnable_since) {
+        const uint64_t latency = now - next->accounting.runnable_since;
+        next->accounting.wakeups++;
+        next->accounting.total_wakeup_latency += latency;
+        if (latency > next->accounting.max_wakeup_latency) {
+            next->accounting.max_wakeup_latency = latency;
+        }
+        next->accounting.runnable_since = 0;
+    }
+}
+
+/// @brief A sleeping or waiting thread became runnable
+void accounting_wakeup(struct thread *thread)
+{
+    thread->accounting.runnable_since = rdtsc();
+}
+
+void accounting_page_fault(struct thread *thread)
+{
+    thread->accounting.page_faults++;
+}
+
+/// @brief Kernel cycles of the thread, including the current stretch if it is the one running
+uint64_t accounting_kernel_cycles(const struct thread *thread, const bool running)
+{
+    if (!running) {
+        return thread->accounting.kernel_cycles;
+    }
+
+    return thread->accounting.kernel_cycles + (rdtsc() - thread->accounting.last_timestamp);
+}
@@ -0,0 +1,70 @@
+#include <config.h>
+#include <futex.h>
+#include <status.h>
+#include <thread.h>
+#include <wait_queue.h>
+
+/// Waiters are hashed by the physical address of the futex word, so threads of different processes
+/// sharing the same page meet on the same queue. Waiters with colliding hashes are told apart by the key.
+static struct wait_queue futex_queues[FUTEX_HASH_BUCKETS];
+
+void futex_init(void)
+{
+    for (int i = 0; i < FUTEX_HASH_BUCKETS; i++) {
+        wait_queue_init(&futex_queues[i]);
+    }
+}
+
+static struct wait_queue *futex_queue(const uintptr_t key)
+{
+    return &futex_queues[(key >> 2) % FUTEX_HASH_BUCKETS];
+}
+
+/// @brief Translate the futex address of the thread to the physical address used as the key
+static int futex_key(const struct thread *thread, void *virtual_address, uintptr_t *key)
+{
+    if (!virtual_address || (uintptr_t)virtual_address % sizeof(int) != 0) {
+        return -EINVARG;
+    }
+
+    *key = (uintptr_t)thread_virtual_to_physical_address(thread, virtual_address);
+    if (*key == 0) {
+        return -EFAULT;
+    }
+
+    return ALL_OK;
+}
+
+/// @brief Put the thread to sleep if the futex word still holds the expected value.
+/// @details Called with interrupts disabled, so nobody can change the word and wake
+/// the queue between the check and the sleep.
+/// @return ALL_OK once woken, -EAGAIN if the value had already changed
+int futex_wait(struct thread *thread, void *virtual_address, const int value)
+{
+    uintptr_t key = 0;
+    const int res = futex_key(thread, virtual_address, &key);
+    if (res < 0) {
+        return res;
+    }
+
+    if (*(volatile int *)key != value) {
+        return -EAGAIN;
+    }
+
+    wait_queue_sleep_keyed(futex_queue(key), key);
+
+    return ALL_OK;
+}
+
+/// @brief Wake up to count threads sleeping on the futex
+/// @return the number of threads woken
+int futex_wake(struct thread *thread, void *virtual_address, const int count)
+{
+    uintptr_t key = 0;
+    const int res = futex_key(thread, virtual_address, &key);
+    if (res < 0) {
+        return res;
+    }
+
+    return wait_queue_wake_keyed(futex_queue(key), key, count);
+}
@@ -0,0 +1,96 @@
+#include <assert.h>
+#include <config.h>
+#include <kernel.h>
+#include <kernel_heap.h>
+#include <kthread.h>
+#include <memory.h>
+#include <paging.h>
+#include <pid.h>
+#include <process.h>
+#include <scheduler.h>
+#include <serial.h>
+#include <status.h>
+#include <string.h>
+#include <thread.h>
+#include <x86.h>
+
+// Kernel threads never enter user mode. They run with the kernel page directory and are scheduled like any
+// other thread, so unlike interrupt handlers they can sleep.
+
+/// All the kernel threads belong to this process. It is not in the process table, so it has no pid of its own
+static struct process kernel_process;
+
+void kthread_init(void)
+{
+    memset(&kernel_process, 0, sizeof(kernel_process));
+    strncpy(kernel_process.file_name, "kernel", sizeof(kernel_process.file_name));
+    kernel_process.page_directory = kernel_page_directory;
+    kernel_process.state          = RUNNING;
+    kernel_process.pid            = PID_KERNEL;
+    process_init_lists(&kernel_process);
+}
+
+/// @brief The first function a kernel thread runs, right after the first switch to it
+[[noreturn]] static void kthread_start(struct thread *thread)
+{
+    scheduler_finish_switch();
+
+    thread->kernel_function(thread->kernel_argument);
+
+    kthread_exit();
+}
+
+/// @brief Create a kernel thread and queue it. It starts with interrupts disabled, like a syscall
+/// @param name shown in stats and debug output
+struct thread *kthread_create(const char *name, void (*function)(void *arg), void *arg)
+{
+    auto const thread = (struct thread *)kzalloc(sizeof(struct thread));
+    if (!thread) {
+        warningf("Failed to allocate kernel thread %s\n", name);
+        return ERROR(-ENOMEM);
+    }
+
+    thread->kernel_stack = kzalloc(KERNEL_STACK_SIZE);
+    if (!thread->kernel_stack) {
+        warningf("Failed to allocate kernel stack for kernel thread %s\n", name);
+        kfree(thread);
+        return ERROR(-ENOMEM);
+    }
+
+    thread->process         = &kernel_process;
+    thread->state           = RUNNING;
+    thread->sleep_until     = -1;
+    thread->slot            = -1;
+    thread->tid             = kernel_process.next_tid++;
+    thread->registers.cs    = KERNEL_CODE_SELECTOR;
+    thread->kernel_function = function;
+    thread->kernel_argument = arg;
+    thread->magic           = THREAD_MAGIC;
+    thread_init_kernel_stack(thread, kthread_start);
+
+    list_push_back(&kernel_process.threads, &thread->process_elem);
+    scheduler_queue_thread(thread);
+
+    dbgprintf("Kernel thread %s created with tid %d\n", name, thread->tid);
+
+    return thread;
+}
+
+bool kthread_is_kernel_thread(const struct thread *thread)
+{
+    return thread->process == &kernel_process;
+}
+
+/// @brief Terminate the calling kernel thread
+void kthread_exit(void)
+{
+    cli();
+
+    auto const thread = scheduler_get_current_thread();
+    ASSERT(thread && kthread_is_kernel_thread(thread), "Not a kernel thread");
+
+    thread_free(thread);
+    schedule();
+
+    panic("Trying to schedule a dead kernel thread");
+}
@@ -0,0 +1,94 @@
+#include <oom.h>
+#include <pid.h>
+#include <printf.h>
+#include <process.h>
+#include <scheduler.h>
+#include <status.h>
+#include <termcolors.h>
+
+// When the kernel heap runs out, the process holding the most memory is killed instead of panicking.
+
+struct oom_choice {
+    const struct process *current;
+    struct process *victim;
+    struct process_memory usage;
+};
+
+/// A process torn down by the OOM killer frees memory only, an allocation failing meanwhile must not recurse
+static bool oom_running;
+
+/// @brief A thread holding a sleeplock or waiting for the disk cannot be torn down, those processes are left alone
+static bool oom_can_kill(struct process *process)
+{
+    for (struct list_elem *e = list_begin(&process->threads); e != list_end(&process->threads); e = list_next(e)) {
+        auto const thread = list_entry(e, struct thread, process_elem);
+        if (thread->uninterruptible > 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void oom_consider(struct process *process, void *data)
+{
+    struct oom_choice *choice = data;
+
+    if (process->state == ZOMBIE || process->pid == PID_KERNEL) {
+        return;
+    }
+
+    if (process != choice->current && !oom_can_kill(process)) {
+        return;
+    }
+
+    struct process_memory usage;
+    process_get_memory_usage(process, &usage);
+    if (!choice->victim || usage.total > choice->usage.total) {
+        choice->victim = process;
+        choice->usage  = usage;
+    }
+}
+
+/// @brief Kill the process that holds the most memory
+/// @return true if memory was freed and the allocation is worth trying again
+bool oom_kill(void)
+{
+    if (oom_running) {
+        return false;
+    }
+    oom_running = true;
+
+    bool freed               = false;
+    struct oom_choice choice = {.current = scheduler_get_current_process()};
+    scheduler_for_each_process(oom_consider, &choice);
+
+    auto const victim = choice.victim;
+    if (!victim || victim->killed) {
+        goto out;
+    }
+
+    printf(KRED "\nOut of memory:" KWHT " killing" KBBLU " %s " KWHT "(%d), %lu KiB: stack %lu, image %lu, "
+                "allocations %lu, page tables %lu, threads %lu\n",
+           victim->file_name,
+           victim->pid,
+           choice.usage.total / 1024,
+           choice.usage.stack / 1024,
+           choice.usage.image / 1024,
+           choice.usage.allocations / 1024,
+           choice.usage.page_tables / 1024,
+           choice.usage.threads / 1024);
+
+    if (victim == choice.current) {
+        // The running process cannot be torn down in the middle of a system call, this allocation fails
+        // and the process exits on its way back to user mode
+        victim->killed = true;
+        goto out;
+    }
+
+    freed = process_kill(victim, -ENOMEM) == ALL_OK;
+
+out:
+    oom_running = false;
+    return freed;
+}
@@ -0,0 +1,104 @@
+#include <assert.h>
+#include <config.h>
+#include <pid.h>
+#include <scheduler.h>
+#include <status.h>
+
+// Process ids are handed out in a cycle over 1..PID_MAX - 1, starting after the last one given out, so a pid is only
+// reused after all the others have been tried. Freed pids also wait PID_REUSE_DELAY milliseconds in a queue before
+// they go back to the bitmap, so a quick exit and fork never hands out the pid of a process that just died.
+
+#define PID_BITS_PER_WORD 32
+#define PID_WORDS (PID_MAX / PID_BITS_PER_WORD)
+#define PID_REUSE_QUEUE_SIZE 64
+
+static uint32_t pid_bitmap[PID_WORDS] = {1 << PID_KERNEL};
+/// Where the search for the next free pid starts
+static int pid_next_hint = PID_KERNEL + 1;
+
+struct freed_pid {
+    int pid;
+    uint32_t freed_at;
+};
+
+/// FIFO of freed pids that are still held back
+static struct freed_pid reuse_queue[PID_REUSE_QUEUE_SIZE];
+static int reuse_head;
+static int reuse_count;
+
+static void pid_release(const int pid)
+{
+    pid_bitmap[pid / PID_BITS_PER_WORD] &= ~(1U << (pid % PID_BITS_PER_WORD));
+}
+
+/// @brief Put back the oldest held back pid
+static void pid_release_oldest(void)
+{
+    pid_release(reuse_queue[reuse_head].pid);
+    reuse_head = (reuse_head + 1) % PID_REUSE_QUEUE_SIZE;
+    reuse_count--;
+}
+
+/// @brief Put back the pids that have been held back long enough
+static void pid_release_expired(void)
+{
+    const uint32_t now = scheduler_get_jiffies();
+    while (reuse_count > 0 && now - reuse_queue[reuse_head].freed_at >= PID_REUSE_DELAY) {
+        pid_release_oldest();
+    }
+}
+
+/// @brief Find a clear bit at or after start
+/// @return the pid, or -1 if the bitmap is full from start on
+static int pid_find_free(const int start)
+{
+    int word       = start / PID_BITS_PER_WORD;
+    uint32_t clear = ~pid_bitmap[word] & (~0U << (start % PID_BITS_PER_WORD));
+
+    while (true) {
+        if (clear) {
+            return word * PID_BITS_PER_WORD + __builtin_ctz(clear);
+        }
+        if (++word == PID_WORDS) {
+            return -1;
+        }
+        clear = ~pid_bitmap[word];
+    }
+}
+
+int pid_alloc(void)
+{
+    pid_release_expired();
+
+    while (true) {
+        int pid = pid_find_free(pid_next_hint);
+        if (pid < 0) {
+            pid = pid_find_free(PID_KERNEL + 1);
+        }
+
+        if (pid >= 0) {
+            pid_bitmap[pid / PID_BITS_PER_WORD] |= 1U << (pid % PID_BITS_PER_WORD);
+            pid_next_hint = pid + 1 < PID_MAX ? pid + 1 : PID_KERNEL + 1;
+            return pid;
+        }
+
+        // Every pid is taken, cut the delay short rather than failing
+        if (reuse_count == 0) {
+            return -EINSTKN;
+        }
+        pid_release_oldest();
+    }
+}
+
+void pid_free(const int pid)
+{
+    ASSERT(pid > PID_KERNEL && pid < PID_MAX, "Invalid process id");
+
+    if (reuse_count == PID_REUSE_QUEUE_SIZE) {
+        pid_release_oldest();
+    }
+
+    const int tail    = (reuse_head + reuse_count) % PID_REUSE_QUEUE_SIZE;
+    reuse_queue[tail] = (struct freed_pid){.pid = pid, .freed_at = scheduler_get_jiffies()};
+    reuse_count++;
+}
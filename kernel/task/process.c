@@ -1,9 +1,11 @@
 #include <debug.h>
 #include <elf.h>
+#include <file_table.h>
 #include <kernel.h>
 #include <kernel_heap.h>
 #include <memory.h>
 #include <paging.h>
+#include <pid.h>
 #include <process.h>
 #include <rand.h>
 #include <scheduler.h>
@@ -14,106 +16,275 @@
 #include <sys/stat.h>
 #include <thread.h>
 #include <vfs.h>
+#include <x86.h>
 
-spinlock_t process_lock = 0;
+spinlock_t process_lock = SPINLOCK_INITIALIZER("process");
 
-int process_get_child_count(const struct process *process)
+void process_init_lists(struct process *process)
+{
+    list_init(&process->threads);
+    list_init(&process->children);
+    list_init(&process->zombies);
+}
+
+/// @brief Default limits of a new process, a forked child inherits the limits of its parent instead
+void process_init_limits(struct process *process)
 {
-    int count                   = 0;
-    const struct process *child = process->children;
-    while (child) {
-        count++;
-        child = child->next;
+    process->limits[RLIMIT_RSS]  = (struct rlimit){.rlim_cur = RLIM_INFINITY, .rlim_max = RLIM_INFINITY};
+    process->limits[RLIMIT_DATA] = (struct rlimit){.rlim_cur = PROCESS_DATA_LIMIT, .rlim_max = RLIM_INFINITY};
+}
+
+int process_set_limit(struct process *process, const int resource, const struct rlimit *limit)
+{
+    if (resource < 0 || resource >= RLIMIT_COUNT || limit->rlim_cur > limit->rlim_max) {
+        return -EINVARG;
     }
-    return count;
+
+    // Nobody is privileged enough to raise a hard limit
+    if (limit->rlim_max > process->limits[resource].rlim_max) {
+        return -EINVARG;
+    }
+
+    process->limits[resource] = *limit;
+    return ALL_OK;
+}
+
+/// @brief Add up the kernel heap blocks that belong to the process
+void process_get_memory_usage(struct process *process, struct process_memory *usage)
+{
+    *usage = (struct process_memory){};
+
+    usage->stack = ksize(process->stack);
+
+    if (process->file_type == PROCESS_FILE_TYPE_ELF && process->elf_file) {
+        usage->image = ksize(process->elf_file) + ksize(process->elf_file->elf_memory);
+    } else if (process->file_type == PROCESS_FILE_TYPE_BINARY) {
+        usage->image = ksize(process->pointer);
+    }
+
+    usage->allocations = process->allocated_bytes + ksize(process->allocations);
+
+    if (process->page_directory) {
+        usage->page_tables = paging_directory_size(process->page_directory);
+    }
+
+    for (struct list_elem *e = list_begin(&process->threads); e != list_end(&process->threads); e = list_next(e)) {
+        auto const thread = list_entry(e, struct thread, process_elem);
+        usage->threads += ksize(thread) + ksize(thread->kernel_stack) + ksize(thread->tls) +
+            ksize(thread->user_stack) + ksize(thread->fpu_state);
+    }
+
+    usage->total = usage->stack + usage->image + usage->allocations + usage->page_tables + usage->threads;
+}
+
+/// @brief Check that size more bytes of allocations keep the process within its limits
+static bool process_within_limits(struct process *process, const size_t size)
+{
+    // The heap hands out whole blocks
+    const uint64_t charge = ((uint64_t)size + HEAP_BLOCK_SIZE - 1) / HEAP_BLOCK_SIZE * HEAP_BLOCK_SIZE;
+
+    if (process->allocated_bytes + charge > process->limits[RLIMIT_DATA].rlim_cur) {
+        return false;
+    }
+
+    if (process->limits[RLIMIT_RSS].rlim_cur == RLIM_INFINITY) {
+        return true;
+    }
+
+    struct process_memory usage;
+    process_get_memory_usage(process, &usage);
+    return usage.total + charge <= process->limits[RLIMIT_RSS].rlim_cur;
+}
+
+int process_get_child_count(const struct process *process)
+{
+    return process->child_count;
 }
 
-struct process *find_child_process_by_state(const struct process *parent, const enum PROCESS_STATE state)
+struct process *find_child_process_by_state(struct process *parent, const enum PROCESS_STATE state)
 {
-    struct process *child = parent->children;
-    while (child) {
+    if (state == ZOMBIE) {
+        if (list_empty(&parent->zombies)) {
+            return nullptr;
+        }
+        return list_entry(list_front(&parent->zombies), struct process, zombie_elem);
+    }
+
+    for (struct list_elem *e = list_begin(&parent->children); e != list_end(&parent->children); e = list_next(e)) {
+        auto const child = list_entry(e, struct process, sibling_elem);
         if (child->state == state) {
             return child;
         }
-        child = child->next;
     }
     return nullptr;
 }
 
 struct process *find_child_process_by_pid(const struct process *parent, const int pid)
 {
-    struct process *child = parent->children;
-    while (child) {
-        if (child->pid == pid) {
-            return child;
-        }
-        child = child->next;
+    if (pid <= PID_KERNEL || pid >= PID_MAX) {
+        return nullptr;
+    }
+
+    auto const child = scheduler_get_process(pid);
+    if (child && child->parent == parent) {
+        return child;
     }
     return nullptr;
 }
 
 int process_add_child(struct process *parent, struct process *child)
 {
-    if (parent->children == nullptr) {
-        parent->children = child;
-        return ALL_OK;
+    child->parent = parent;
+    list_push_back(&parent->children, &child->sibling_elem);
+    parent->child_count++;
+
+    return ALL_OK;
+}
+
+int process_remove_child(struct process *parent, struct process *child)
+{
+    if (child->parent != parent) {
+        return -ENOENT;
     }
 
-    struct process *current = parent->children;
-    while (current->next) {
-        current = current->next;
+    list_remove(&child->sibling_elem);
+    if (child->state == ZOMBIE) {
+        list_remove(&child->zombie_elem);
     }
+    parent->child_count--;
+    child->parent = nullptr;
 
-    current->next = child;
     return ALL_OK;
 }
 
-int process_remove_child(struct process *parent, const struct process *child)
+/// @brief Free a zombie for good, its pid goes back to the allocator
+void process_release(struct process *process)
 {
-    if (parent->children == child) {
-        parent->children = child->next;
-        return ALL_OK;
+    ASSERT(process->state == ZOMBIE, "Releasing a live process");
+
+    if (process->parent) {
+        process_remove_child(process->parent, process);
     }
+    scheduler_unlink_process(process);
+    kfree(process);
+}
 
-    struct process *current = parent->children;
-    while (current->next) {
-        if (current->next == child) {
-            current->next = child->next;
-            return ALL_OK;
+/// @brief Count the threads of the process that have not exited
+int process_get_thread_count(struct process *process)
+{
+    int count = 0;
+    for (struct list_elem *e = list_begin(&process->threads); e != list_end(&process->threads); e = list_next(e)) {
+        auto const thread = list_entry(e, struct thread, process_elem);
+        if (thread->state != ZOMBIE) {
+            count++;
         }
-        current = current->next;
     }
-
-    return -ENOENT;
+    return count;
 }
 
-static int process_find_free_allocation_slot(const struct process *process)
+struct thread *process_find_thread(struct process *process, const int tid)
 {
-    for (int i = 0; i < MAX_PROGRAM_ALLOCATIONS; i++) {
-        if (process->allocations[i].ptr == NULL) {
-            return i;
+    for (struct list_elem *e = list_begin(&process->threads); e != list_end(&process->threads); e = list_next(e)) {
+        auto const thread = list_entry(e, struct thread, process_elem);
+        if (thread->tid == tid) {
+            return thread;
         }
     }
-
-    warningf("Failed to find free allocation slot for process %d\n", process->pid);
-    ASSERT(false, "Failed to find free allocation slot");
-    return -ENOMEM;
+    return nullptr;
 }
 
-static bool process_is_process_pointer(const struct process *process, const void *ptr)
+/// @brief Whether a thread of the process other than current holds a sleeplock or waits for the disk
+static bool process_has_uninterruptible_threads(struct process *process, const struct thread *current)
 {
-    for (size_t i = 0; i < MAX_PROGRAM_ALLOCATIONS; i++) {
-        if (process->allocations[i].ptr == ptr) {
+    for (struct list_elem *e = list_begin(&process->threads); e != list_end(&process->threads); e = list_next(e)) {
+        auto const thread = list_entry(e, struct thread, process_elem);
+        if (thread != current && thread->uninterruptible > 0) {
             return true;
         }
     }
-
     return false;
 }
 
-static struct process_allocation *process_get_allocation_by_address(struct process *process, const void *address)
+/// @brief Stop the other threads of the calling thread's process before it is torn down.
+/// They are marked killed and exit on their way back to user mode. A thread holding a sleeplock or waiting for the
+/// disk is waited for, its kernel stack is in use until it lets go. If another thread is already tearing the process
+/// down, the calling thread exits instead of returning.
+void process_stop_threads(struct process *process)
+{
+    auto const current = scheduler_get_current_thread();
+    ASSERT(current->process == process, "Only a thread of the process can stop the others");
+
+    if (process->exiting_thread && process->exiting_thread != current) {
+        thread_exit(current, process->exit_code);
+    }
+    process->exiting_thread = current;
+    process->killed         = true;
+
+    // Threads in a timed sleep wake up now, instead of holding the teardown back until their time is up
+    for (struct list_elem *e = list_begin(&process->threads); e != list_end(&process->threads); e = list_next(e)) {
+        auto const thread = list_entry(e, struct thread, process_elem);
+        if (thread != current && thread->state == SLEEPING && thread->sleep_reason == SLEEP_REASON_NONE) {
+            thread->sleep_until = 0;
+        }
+    }
+
+    while (process_has_uninterruptible_threads(process, current)) {
+        current->sleep_reason = SLEEP_REASON_NONE;
+        current->sleep_until  = scheduler_get_jiffies() + 1;
+        current->state        = SLEEPING;
+        while (current->state == SLEEPING) {
+            schedule();
+        }
+    }
+}
+
+/// @brief Free all the threads of the process. The calling thread is released once the scheduler switches away
+/// @warning The other threads must have been stopped with process_stop_threads(), or never entered the kernel
+void process_free_threads(struct process *process)
+{
+    ASSERT(!process_has_uninterruptible_threads(process, scheduler_get_current_thread()),
+           "Freeing a thread that holds a sleeplock or waits for the disk");
+
+    while (!list_empty(&process->threads)) {
+        thread_free(list_entry(list_front(&process->threads), struct thread, process_elem));
+    }
+    process->thread         = nullptr;
+    process->exiting_thread = nullptr;
+}
+
+/// @brief Make room for one more allocation in the allocation table
+static int process_reserve_allocation(struct process *process)
+{
+    if (process->allocation_count < process->allocation_capacity) {
+        return ALL_OK;
+    }
+
+    if (process->allocation_capacity >= MAX_PROGRAM_ALLOCATIONS) {
+        warningf("Too many allocations for process %d\n", process->pid);
+        return -ENOMEM;
+    }
+
+    // The first table fills one heap block
+    const int capacity = process->allocation_capacity
+        ? process->allocation_capacity * 2
+        : (int)(HEAP_BLOCK_SIZE / sizeof(struct process_allocation));
+    struct process_allocation *allocations =
+        process->allocations ? krealloc(process->allocations, capacity * sizeof(struct process_allocation))
+                             : kmalloc(capacity * sizeof(struct process_allocation));
+    if (!allocations) {
+        return -ENOMEM;
+    }
+
+    process->allocations         = allocations;
+    process->allocation_capacity = capacity;
+
+    return ALL_OK;
+}
+
+static struct process_allocation *process_get_allocation_by_address(const struct process *process,
+                                                                    const void *address)
 {
-    for (int i = 0; i < MAX_PROGRAM_ALLOCATIONS; i++) {
+    for (int i = 0; i < process->allocation_count; i++) {
         if (process->allocations[i].ptr == address) {
             return &process->allocations[i];
         }
@@ -124,13 +295,16 @@ static struct process_allocation *process_get_allocation_by_address(struct proce
 
 int process_free_allocations(struct process *process)
 {
-    for (int i = 0; i < MAX_PROGRAM_ALLOCATIONS; i++) {
-        if (process->allocations[i].ptr == nullptr) {
-            continue;
-        }
-        process_free(process, process->allocations[i].ptr);
+    while (process->allocation_count > 0) {
+        process_free(process, process->allocations[process->allocation_count - 1].ptr);
     }
 
+    if (process->allocations) {
+        kfree(process->allocations);
+    }
+    process->allocations         = nullptr;
+    process->allocation_capacity = 0;
+
     return 0;
 }
 
@@ -157,19 +331,9 @@ int process_free_program_data(const struct process *process)
     return res;
 }
 
-int process_free_file_descriptors(const struct process *process)
-{
-    for (int i = 0; i < MAX_FILE_DESCRIPTORS; i++) {
-        if (process->file_descriptors[i]) {
-            vfs_close(i);
-        }
-    }
-
-    return 0;
-}
-
 /// @brief Turn the process into a zombie and deallocates its resources
-/// The process remains in the process list until the parent process reads the exit code
+/// The process stays in the pid hash and in the parent's zombie queue until the parent reads the exit code.
+/// A process without a parent must be released by the caller.
 int process_zombify(struct process *process)
 {
     spin_lock(&process_lock);
@@ -179,8 +343,11 @@ int process_zombify(struct process *process)
     int res = process_free_allocations(process);
     ASSERT(res == 0, "Failed to free allocations for process");
 
-    res = process_free_file_descriptors(process);
-    ASSERT(res == 0, "Failed to free file descriptors for process");
+    if (process->files) {
+        res = file_table_put(process->files);
+        ASSERT(res == 0, "Failed to free file descriptors for process");
+        process->files = nullptr;
+    }
 
     res = process_free_program_data(process);
     ASSERT(res == 0, "Failed to free program data for process");
@@ -189,23 +356,77 @@ int process_zombify(struct process *process)
         kfree(process->stack);
     }
     process->stack = nullptr;
-    if (process->thread) {
-        thread_free(process->thread);
-    }
-    process->thread = nullptr;
+    process_free_threads(process);
     if (process->page_directory) {
         paging_free_directory(process->page_directory);
     }
     process->page_directory = nullptr;
 
-    if (strlen(process->file_name) > 0) {
-        scheduler_unlink_process(process);
+    // Nobody is left to reap the children, the ones that already exited go away now
+    while (!list_empty(&process->children)) {
+        auto const child  = list_entry(list_front(&process->children), struct process, sibling_elem);
+        const bool exited = child->state == ZOMBIE;
+        process_remove_child(process, child);
+        if (exited) {
+            process_release(child);
+        }
+    }
+
+    if (process->parent) {
+        list_push_back(&process->parent->zombies, &process->zombie_elem);
     }
 
     spin_unlock(&process_lock);
     return res;
 }
 
+/// @brief Terminate the process of the calling thread
+/// The parent reaps the zombie with waitpid(), or frees it when it exits itself
+[[noreturn]] void process_exit(struct process *process)
+{
+    ASSERT(scheduler_get_current_process() == process, "Only the running process can exit");
+
+    process_stop_threads(process);
+    process_zombify(process);
+    if (!process->parent) {
+        process_release(process);
+    }
+
+    cli();
+    schedule();
+
+    panic("Trying to schedule a dead thread");
+
+    // This must not return, otherwise we will get a general protection fault.
+    // We will only reach this point if the scheduler tries to run a dead thread.
+    // As a last resort, we will enable interrupts, halt the CPU, and wait for a rescheduling.
+    sti();
+    while (1) {
+        hlt();
+    }
+
+    __builtin_unreachable();
+}
+
+/// @brief Tear down a process that is not running, as if it had called exit()
+/// @return -EAGAIN if another process is being torn down right now
+int process_kill(struct process *process, const int exit_code)
+{
+    ASSERT(scheduler_get_current_process() != process, "Use process_exit() for the running process");
+
+    if (spin_is_locked(&process_lock)) {
+        return -EAGAIN;
+    }
+
+    process->exit_code = exit_code;
+    process_zombify(process);
+    if (!process->parent) {
+        process_release(process);
+    }
+
+    return ALL_OK;
+}
+
 int process_count_command_arguments(const struct command_argument *root_argument)
 {
     int i                                  = 0;
@@ -280,15 +501,10 @@ void process_free(struct process *process, void *ptr)
         return;
     }
 
-    for (size_t i = 0; i < MAX_PROGRAM_ALLOCATIONS; i++) {
-        if (process->allocations[i].ptr == ptr) {
-            process->allocations[i].ptr  = NULL;
-            process->allocations[i].size = 0;
-
-            break;
-        }
-    }
+    // The table is unordered, the last entry fills the hole
+    *allocation = process->allocations[--process->allocation_count];
 
+    process->allocated_bytes -= ksize(ptr);
     kfree(ptr);
 }
 
@@ -306,15 +522,20 @@ void *process_calloc(struct process *process, const size_t nmemb, const size_t s
 // Allocate memory accessible by the process
 void *process_malloc(struct process *process, const size_t size)
 {
-    void *ptr = kmalloc(size);
+    void *ptr = nullptr;
+    if (!process_within_limits(process, size)) {
+        warningf("Process %d is over its memory limit\n", process->pid);
+        goto out_error;
+    }
+
+    // A failure reaches the caller, malloc() returns NULL
+    ptr = kmalloc(size);
     if (!ptr) {
-        ASSERT(false, "Failed to allocate memory for process");
+        warningf("Failed to allocate memory for process %d\n", process->pid);
         goto out_error;
     }
 
-    const int index = process_find_free_allocation_slot(process);
-    if (index < 0) {
-        ASSERT(false, "Failed to find free allocation slot");
+    if (process_reserve_allocation(process) < 0) {
         goto out_error;
     }
 
@@ -329,8 +550,8 @@ void *process_malloc(struct process *process, const size_t size)
         goto out_error;
     }
 
-    process->allocations[index].ptr  = ptr;
-    process->allocations[index].size = size;
+    process->allocations[process->allocation_count++] = (struct process_allocation){.ptr = ptr, .size = size};
+    process->allocated_bytes += ksize(ptr);
 
     return ptr;
 
@@ -586,7 +807,6 @@ int process_load_enqueue(const char file_name[static 1], struct process **proces
 
     const int res = process_load(file_name, process);
     if (res == 0) {
-        (*process)->sleep_until = -1;
         scheduler_queue_thread((*process)->thread);
     }
 
@@ -606,6 +826,9 @@ int process_load(const char file_name[static 1], struct process **process)
     }
 
     res = process_load_for_slot(file_name, process, pid);
+    if (res < 0) {
+        pid_free(pid);
+    }
 
 out:
     return res;
@@ -634,7 +857,8 @@ int process_load_for_slot(const char file_name[static 1], struct process **proce
         res = -ENOMEM;
         goto out;
     }
-
+    process_init_lists(proc);
+    process_init_limits(proc);
 
     res = process_load_data(file_name, proc);
     if (res < 0) {
@@ -675,7 +899,7 @@ int process_load_for_slot(const char file_name[static 1], struct process **proce
     }
 
     proc->state = RUNNING;
-    memset(proc->file_descriptors, 0, sizeof(proc->file_descriptors));
+    proc->files = file_table_create();
 
     // proc->tty_fd = fopen("/dev/tty", "w");
 
@@ -710,68 +934,52 @@ int process_set_current_directory(struct process *process, const char directory[
 
 int process_wait_pid(struct process *process, const int pid)
 {
-    if (process_get_child_count(process) == 0) {
+    auto const thread = scheduler_get_current_thread();
+    ASSERT(thread->process == process);
+
+    if (pid != -1 && pid <= PID_KERNEL) {
         return -1;
     }
 
-    struct process *child = nullptr;
-
-    if (pid == -1) {
-        child = find_child_process_by_state(process, ZOMBIE);
-        if (child == nullptr) {
-            process->state    = WAITING;
-            process->wait_pid = pid;
-            schedule();
+    while (true) {
+        if (process_get_child_count(process) == 0) {
             return -1;
         }
-    }
-
-    if (pid > 0) {
-        child = find_child_process_by_pid(process, pid);
-    }
 
-    if (child == nullptr) {
-        process->state    = RUNNING;
-        process->wait_pid = 0;
-        return -1;
-    }
-
-    if (child->state == ZOMBIE) {
-        process_remove_child(process, child);
-        scheduler_unlink_process(child);
-        if (child->thread) {
-            thread_free(child->thread);
+        struct process *child = nullptr;
+        if (pid == -1) {
+            child = find_child_process_by_state(process, ZOMBIE);
+        } else {
+            child = find_child_process_by_pid(process, pid);
+            if (child == nullptr) {
+                return -1;
+            }
         }
 
-        const int status  = child->exit_code;
-        process->state    = RUNNING;
-        process->wait_pid = 0;
-        kfree(child);
-        return status;
-    }
+        if (child && child->state == ZOMBIE) {
+            const int status = child->exit_code;
+            thread->wait_pid = 0;
+            process_release(child);
+            return status;
+        }
 
-    // No child has terminated; block the parent process
-    process->state    = WAITING;
-    process->wait_pid = pid;
+        // No child has terminated; block until the scheduler sees one exit
+        thread->state    = WAITING;
+        thread->wait_pid = pid;
 
-    schedule(); // Context switch to another process
-    return -1;  // No child to wait for
+        schedule();
+    }
 }
 
 int process_copy_allocations(struct process *dest, const struct process *src)
 {
-    memset(dest->allocations, 0, sizeof(dest->allocations));
-
-    for (size_t i = 0; i < MAX_PROGRAM_ALLOCATIONS; i++) {
-        if (src->allocations[i].ptr) {
-            void *ptr = process_malloc(dest, src->allocations[i].size);
-            if (!ptr) {
-                return -ENOMEM;
-            }
-
-            memcpy(ptr, src->allocations[i].ptr, src->allocations[i].size);
-            dest->allocations[i].ptr = ptr;
+    for (int i = 0; i < src->allocation_count; i++) {
+        void *ptr = process_malloc(dest, src->allocations[i].size);
+        if (!ptr) {
+            return -ENOMEM;
         }
+
+        memcpy(ptr, src->allocations[i].ptr, src->allocations[i].size);
     }
 
     return ALL_OK;
@@ -820,15 +1028,14 @@ void process_copy_arguments(struct process *dest, const struct process *src)
     }
 }
 
-void process_copy_thread(struct process *dest, const struct process *src)
+/// @brief Copy the calling thread into the child, it becomes the main thread of the child
+void process_copy_thread(struct process *dest, const struct thread *src)
 {
-    struct thread *thread = thread_create(dest);
+    struct thread *thread = thread_clone(dest, src);
     if (ISERR(thread)) {
         panic("Failed to create thread");
     }
-    thread_copy_registers(thread, src->thread);
-    dest->thread          = thread;
-    dest->thread->process = dest;
+    dest->thread = thread;
 }
 
 struct process *process_clone(struct process *process)
@@ -844,17 +1051,20 @@ struct process *process_clone(struct process *process)
     const int pid = scheduler_get_free_pid();
     if (pid < 0) {
         kfree(clone);
-        panic("No free process slot");
-        return nullptr;
+        return ERROR(pid);
     }
 
-    clone->pid    = pid;
-    clone->parent = process;
+    clone->pid = pid;
+    process_init_lists(clone);
+    memcpy(clone->limits, process->limits, sizeof(clone->limits));
+    if (process->files) {
+        clone->files = file_table_share(process->files);
+    }
 
     // This is not super efficient
 
     process_copy_file_info(clone, process);
-    process_copy_thread(clone, process);
+    process_copy_thread(clone, scheduler_get_current_thread());
     process_copy_stack(clone, process);
     process_copy_arguments(clone, process);
     process_map_memory(clone);
@@ -878,47 +1088,49 @@ void process_command_argument_free(struct command_argument *argument)
     kfree(argument);
 }
 
-void process_free_file_descriptor(struct process *process, struct file *desc)
+/// @brief Close a descriptor of the process, the file itself is closed when no other process shares it
+int process_free_file_descriptor(struct process *process, struct file *desc)
 {
-    process->file_descriptors[desc->index] = nullptr;
-    // Do not free device inodes
-    if (desc->inode && desc->inode->type != INODE_DEVICE && desc->fs_type != FS_TYPE_RAMFS) {
-        if (desc->inode->data) {
-            kfree(desc->inode->data);
-        }
-        kfree(desc->inode);
+    auto const files = file_table_unshare(process->files);
+    if (!files) {
+        return -ENOMEM;
     }
-    kfree(desc);
+    process->files = files;
+
+    file_table_remove(files, desc->index);
+    return vfs_file_put(desc);
 }
 
 int process_new_file_descriptor(struct process *process, struct file **desc_out)
 {
-    int res = -ENOMEM;
-    for (int i = 0; i < MAX_FILE_DESCRIPTORS; i++) {
-        if (process->file_descriptors[i] == nullptr) {
-            struct file *desc = kzalloc(sizeof(struct file));
-            if (desc == nullptr) {
-                panic("Failed to allocate memory for file descriptor\n");
-                res = -ENOMEM;
-                break;
-            }
+    auto const files = file_table_unshare(process->files);
+    if (!files) {
+        return -ENOMEM;
+    }
+    process->files = files;
 
-            desc->index                  = i;
-            process->file_descriptors[i] = desc;
-            *desc_out                    = desc;
-            res                          = 0;
-            break;
-        }
+    struct file *desc = kzalloc(sizeof(struct file));
+    if (desc == nullptr) {
+        panic("Failed to allocate memory for file descriptor\n");
+        return -ENOMEM;
     }
+    desc->refcount = 1;
 
-    return res;
+    const int res = file_table_install(files, desc);
+    if (res < 0) {
+        kfree(desc);
+        return res;
+    }
+
+    *desc_out = desc;
+    return ALL_OK;
 }
 
 struct file *process_get_file_descriptor(const struct process *process, const uint32_t index)
 {
-    if (index > MAX_FILE_DESCRIPTORS - 1) {
+    if (!process->files) {
         return nullptr;
     }
 
-    return process->file_descriptors[index];
+    return file_table_get(process->files, (int)index);
 }
@@ -1,18 +1,26 @@
+#include <accounting.h>
 #include <config.h>
 #include <debug.h>
+#include <fpu.h>
+#include <gdt.h>
 #include <idt.h>
 #include <kernel_heap.h>
+#include <kthread.h>
 #include <list.h>
 #include <memory.h>
 #include <net/network.h>
+#include <paging.h>
 #include <pic.h>
+#include <pid.h>
 #include <pit.h>
 #include <process.h>
 #include <scheduler.h>
 #include <serial.h>
+#include <softirq.h>
 #include <spinlock.h>
 #include <status.h>
 #include <string.h>
+#include <tss.h>
 #include <x86.h>
 
 // How often the PIT should interrupt
@@ -21,31 +29,39 @@
 #define TIME_SLICE 100 // ms
 
 // Milliseconds since boot
-uint32_t jiffies                                = 0;
-static struct process *processes[MAX_PROCESSES] = {nullptr};
-spinlock_t scheduler_lock                       = 0;
+uint32_t jiffies          = 0;
+spinlock_t scheduler_lock = SPINLOCK_INITIALIZER("scheduler");
+/// Every process with a pid, hashed by pid. Zombies stay until they are reaped
+static struct list process_hash[PID_HASH_BUCKETS];
+static int process_count = 0;
 
 struct list thread_list;
 bool scheduler_enabled = false;
+/// Set when the running thread should give up the CPU at the next preemption point
+static bool need_reschedule = false;
+/// The next switch is a preemption, for the involuntary context switch count
+static bool preempting = false;
+/// Jiffies when the running thread got the CPU, its time slice ends TIME_SLICE later
+static uint32_t slice_start = 0;
 
 struct thread *current_thread = nullptr;
 
-void scheduler_initialize_idle_thread(uint32_t idle_thread_stack_address);
+/// The boot context becomes the idle context once the kernel is initialized. It is not in the thread list and has no
+/// process; this structure only holds its saved kernel stack pointer while a real thread runs.
+static struct thread idle_thread;
+/// A thread that freed itself while running, its kernel stack is released after the scheduler switches away from it
+static struct thread *retired_thread = nullptr;
 
 
-/// @brief The idle function that runs when no other threads are ready
-__attribute__((noreturn, naked)) void scheduler_idle_thread()
+/// @brief The idle loop that runs when no other threads are ready
+[[noreturn]] void scheduler_idle_thread()
 {
-    // Defined in assembly
-    extern uint32_t kernel_stack_top;
-
-    // The kernel stack gets reset when the idle thread runs
-    asm volatile("mov %0, %%esp" ::"r"(&kernel_stack_top));
-
-    asm volatile("sti;"
-                 "_idle_loop:;"
-                 "hlt;"
-                 "jmp _idle_loop");
+    while (true) {
+        cli();
+        schedule();
+        // sti only takes effect after the next instruction, so no interrupt can slip in before the hlt
+        asm volatile("sti; hlt");
+    }
 }
 
 struct process *scheduler_get_current_process()
@@ -57,50 +73,88 @@ struct process *scheduler_get_current_process()
     return nullptr;
 }
 
+static struct list *scheduler_process_bucket(const int pid)
+{
+    return &process_hash[pid % PID_HASH_BUCKETS];
+}
+
 struct process *scheduler_get_process(const int pid)
 {
-    if (pid < 0 || pid >= MAX_PROCESSES) {
+    if (pid < 0 || pid >= PID_MAX) {
         warningf("Invalid process id: %d\n", pid);
         ASSERT(false, "Invalid process id");
         return nullptr;
     }
 
-    return processes[pid];
+    auto const bucket = scheduler_process_bucket(pid);
+    for (struct list_elem *e = list_begin(bucket); e != list_end(bucket); e = list_next(e)) {
+        auto const process = list_entry(e, struct process, hash_elem);
+        if (process->pid == pid) {
+            return process;
+        }
+    }
+
+    return nullptr;
 }
 
 struct process *scheduler_set_process(const int pid, struct process *process)
 {
-    if (pid < 0 || pid >= MAX_PROCESSES) {
+    if (pid <= PID_KERNEL || pid >= PID_MAX) {
         warningf("Invalid process id: %d\n", pid);
         ASSERT(false, "Invalid process id");
         return nullptr;
     }
 
-    processes[pid] = process;
+    auto const existing = scheduler_get_process(pid);
+    if (existing) {
+        ASSERT(existing == process, "Process id already in use");
+        return process;
+    }
+
+    list_push_back(scheduler_process_bucket(pid), &process->hash_elem);
+    process_count++;
     return process;
 }
 
-void scheduler_unlink_process(const struct process *process)
+/// @brief Remove the process from the pid hash and give its pid back
+void scheduler_unlink_process(struct process *process)
 {
-    processes[process->pid] = nullptr;
+    if (scheduler_get_process(process->pid) != process) {
+        return;
+    }
+
+    list_remove(&process->hash_elem);
+    process_count--;
+    pid_free(process->pid);
 }
 
-void scheduler_remove_current_thread(const struct thread *thread)
+/// @brief Retire the running thread. It keeps running on its kernel stack until the next schedule(),
+/// which never returns to it and releases it once another context is running.
+void scheduler_remove_current_thread(struct thread *thread)
 {
     if (current_thread == thread) {
+        ASSERT(!retired_thread, "A thread is already being retired");
+        retired_thread = thread;
         current_thread = nullptr;
     }
 }
 
+/// @brief Called by every context right after it is switched to
+void scheduler_finish_switch()
+{
+    if (retired_thread) {
+        thread_release(retired_thread);
+        retired_thread = nullptr;
+    }
+}
+
 int scheduler_get_free_pid()
 {
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (processes[i] == nullptr) {
-            return i;
-        }
+    if (process_count >= MAX_PROCESSES) {
+        return -EINSTKN;
     }
 
-    return -EINSTKN;
+    return pid_alloc();
 }
 
 struct thread *scheduler_get_current_thread()
@@ -117,7 +171,7 @@ struct thread *scheduler_get_thread_sleeping_for_keyboard()
 
     auto thread = list_entry(list_begin(&thread_list), struct thread, elem);
     for (size_t i = 0; i < size; i++) {
-        if (thread->process->state == SLEEPING && thread->process->sleep_reason == SLEEP_REASON_STDIN) {
+        if (thread->state == SLEEPING && thread->sleep_reason == SLEEP_REASON_STDIN) {
             return thread;
         }
         thread = list_entry(list_next(&thread->elem), struct thread, elem);
@@ -135,7 +189,7 @@ struct thread *scheduler_get_runnable_thread()
 
     auto thread = list_entry(list_begin(&thread_list), struct thread, elem);
     for (size_t i = 0; i < size; i++) {
-        if (thread->process->state == RUNNING) {
+        if (thread->state == RUNNING) {
             return thread;
         }
         thread = list_entry(list_next(&thread->elem), struct thread, elem);
@@ -160,7 +214,14 @@ void scheduler_queue_thread(struct thread *thread)
 
 void scheduler_unqueue_thread(struct thread *thread)
 {
+    // Not queued
+    if (!thread->elem.next) {
+        return;
+    }
+
     list_remove(&thread->elem);
+    thread->elem.prev = nullptr;
+    thread->elem.next = nullptr;
 }
 
 void scheduler_save_current_thread(const struct interrupt_frame *interrupt_frame)
@@ -175,17 +236,49 @@ void scheduler_save_current_thread(const struct interrupt_frame *interrupt_frame
     }
 }
 
-/// @brief Set the thread as the current thread, switch to its page directory, and run it
-/// @param thread the thread to run
-/// @return ALL_OK on success, error code otherwise
+/// @brief Save the running kernel context and resume the thread on its own kernel stack
+/// @param thread the thread to run, or nullptr to run the idle context
+/// @return ALL_OK once the caller's context is scheduled again
 int scheduler_switch_thread(struct thread *thread)
 {
-    ASSERT(thread->process->state != ZOMBIE, "Trying to switch to a zombie thread");
-    ASSERT(thread_is_valid(thread));
+    ASSERT(!(read_eflags() & EFLAGS_IF), "Interrupts must be disabled");
+
+    struct thread *prev = current_thread;
+    if (!prev) {
+        prev = retired_thread ? retired_thread : &idle_thread;
+    }
+
+    struct thread *next = thread ? thread : &idle_thread;
+
+    const bool involuntary = preempting;
+    preempting             = false;
+    if (prev == next) {
+        return ALL_OK;
+    }
+
+    if (thread) {
+        ASSERT(thread->process->state != ZOMBIE, "Trying to switch to a zombie thread");
+        ASSERT(thread_is_valid(thread));
+        // The CPU loads esp0 from the TSS when the thread traps from user mode
+        set_kernel_stack(thread_kernel_stack_top(thread));
+        gdt_set_tls_base(thread->tls_address);
+    }
 
+    // Kernel stacks are identity mapped in every page directory, but kernel code expects the kernel one.
+    // Threads switch to their own directory on the way back to user mode.
+    kernel_page();
+    fpu_switch(thread);
+
+    accounting_switch(prev, next, involuntary);
+
+    // Every thread gets a full time slice, whatever was left of the previous one's
+    slice_start    = jiffies;
     current_thread = thread;
-    paging_switch_directory(thread->process->page_directory);
-    thread_switch(&thread->registers);
+    thread_context_switch(&prev->kernel_esp, next->kernel_esp);
+
+    // We are back on prev's kernel stack
+    scheduler_finish_switch();
+
     return ALL_OK;
 }
 
@@ -199,9 +292,9 @@ int scheduler_switch_current_thread_page()
 
     ASSERT(process->state != ZOMBIE, "Trying to switch to a zombie thread");
 
-    if (process->thread->registers.cs == KERNEL_CODE_SELECTOR) {
+    if (current_thread->registers.cs == KERNEL_CODE_SELECTOR) {
         set_kernel_mode_segments();
-    } else if (process->thread->registers.cs == USER_CODE_SELECTOR) {
+    } else if (current_thread->registers.cs == USER_CODE_SELECTOR) {
         set_user_mode_segments();
     } else {
         panic("Unknown code selector");
@@ -214,32 +307,58 @@ int scheduler_switch_current_thread_page()
 
 void handle_pit_interrupt(int interrupt, const struct interrupt_frame *frame)
 {
-    static uint32_t milliseconds = 0;
-
     jiffies += PIT_INTERVAL;
     if (!scheduler_enabled) {
         return;
     }
 
-    milliseconds += PIT_INTERVAL;
-    if (milliseconds >= TIME_SLICE) {
-        milliseconds = 0;
-        cli();
-        pic_acknowledge(interrupt);
-        schedule();
+    softirq_raise(SOFTIRQ_TIMER);
+}
+
+/// @brief Timer softirq, asks for a reschedule once the running thread used up its time slice
+static void scheduler_timer_softirq(void)
+{
+    if (jiffies - slice_start >= TIME_SLICE) {
+        slice_start = jiffies;
+        scheduler_request_reschedule();
     }
 }
 
+/// @brief Ask for schedule() to run when the current interrupt returns
+void scheduler_request_reschedule()
+{
+    need_reschedule = true;
+}
+
+/// @brief Called when an interrupt returns to code that had interrupts enabled. Runs the scheduler if someone
+/// asked for it, outside of any interrupt or softirq handler.
+/// @remark Must be called with interrupts disabled
+void scheduler_preempt()
+{
+    if (!need_reschedule || !scheduler_enabled || softirq_is_running()) {
+        return;
+    }
+
+    need_reschedule = false;
+    preempting      = true;
+    schedule();
+}
+
 void scheduler_init()
 {
     list_init(&thread_list);
+    for (int i = 0; i < PID_HASH_BUCKETS; i++) {
+        list_init(&process_hash[i]);
+    }
     pit_set_interval(PIT_INTERVAL);
     idt_register_interrupt_callback(0x20, handle_pit_interrupt);
+    softirq_register(SOFTIRQ_TIMER, "timer", scheduler_timer_softirq);
 }
 
 void scheduler_start()
 {
-    scheduler_enabled = true;
+    idle_thread.accounting.last_timestamp = rdtsc();
+    scheduler_enabled                     = true;
 }
 
 uint32_t scheduler_get_jiffies()
@@ -247,94 +366,165 @@ uint32_t scheduler_get_jiffies()
     return jiffies;
 }
 
+/// @brief The state shown for a process: ZOMBIE, or the state of its main thread
+static enum PROCESS_STATE scheduler_get_process_state(const struct process *process)
+{
+    if (process->state == ZOMBIE || !process->thread) {
+        return process->state;
+    }
+
+    return process->thread->state;
+}
+
 int scheduler_get_processes(struct process_info **proc_info, int *count)
 {
-    // Count the number of processes
-    *count = 0;
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (processes[i] != nullptr) {
-            (*count)++;
-        }
+    *count     = 0;
+    *proc_info = (struct process_info *)kmalloc(sizeof(struct process_info) * process_count);
+    if (!*proc_info) {
+        warningf("Failed to allocate memory for process info\n");
+        return -ENOMEM;
     }
 
-    *proc_info = (struct process_info *)kmalloc(sizeof(struct process_info) * *count);
+    for (int i = 0; i < PID_HASH_BUCKETS; i++) {
+        for (struct list_elem *e = list_begin(&process_hash[i]); e != list_end(&process_hash[i]); e = list_next(e)) {
+            auto const process = list_entry(e, struct process, hash_elem);
+            auto const info    = &(*proc_info)[(*count)++];
 
-    for (int i = 0; i < *count; i++) {
-        if (processes[i]) {
-            struct process_info info = {
-                .pid       = processes[i]->pid,
-                .priority  = processes[i]->priority,
-                .state     = processes[i]->state,
-                .exit_code = processes[i]->exit_code,
+            struct process_memory usage;
+            process_get_memory_usage(process, &usage);
+
+            *info = (struct process_info){
+                .pid       = process->pid,
+                .priority  = process->priority,
+                .state     = scheduler_get_process_state(process),
+                .exit_code = process->exit_code,
+                .memory    = usage.total,
             };
-            strncpy(info.file_name, processes[i]->file_name, MAX_PATH_LENGTH);
-            memcpy(*proc_info + i, &info, sizeof(struct process_info));
+            strncpy(info->file_name, process->file_name, MAX_PATH_LENGTH);
         }
     }
 
     return 0;
 }
 
-/// @brief Check if the process is sleeping and should wake up
-void scheduler_check_sleeping(struct process *process)
+/// @brief Call function for every process in the pid hash. The function must not add or remove processes
+void scheduler_for_each_process(void (*function)(struct process *process, void *data), void *data)
 {
-    if (process->signal == SIGWAKEUP && process->wait_pid != 0) {
-        process->state  = WAITING;
-        process->signal = NONE;
-    } else if (process->signal == SIGWAKEUP && (int)process->sleep_until == -1) {
-        process->state  = RUNNING;
-        process->signal = NONE;
-    } else if (process->sleep_until <= jiffies) {
-        process->signal      = SIGWAKEUP;
-        process->sleep_until = -1;
+    for (int i = 0; i < PID_HASH_BUCKETS; i++) {
+        for (struct list_elem *e = list_begin(&process_hash[i]); e != list_end(&process_hash[i]); e = list_next(e)) {
+            function(list_entry(e, struct process, hash_elem), data);
+        }
     }
 }
 
-int scheduler_count_children(const struct process *process)
+static char scheduler_thread_state_code(const struct thread *thread)
 {
-    int count                   = 0;
-    const struct process *child = process->children;
-    while (child) {
-        count++;
-        child = child->next;
+    switch (thread->state) {
+    case RUNNING:
+        return 'R';
+    case SLEEPING:
+        return 'S';
+    case WAITING:
+        return 'W';
+    case ZOMBIE:
+        return 'Z';
+    default:
+        return '?';
+    }
+}
+
+/// @brief Fill in the CPU accounting of the queued threads
+/// @param threads buffer for up to max threads
+/// @return the number of threads written
+int scheduler_get_thread_stats(struct cpu_stat *cpu, struct thread_stat *threads, const int max)
+{
+    cpu->timestamp   = rdtsc();
+    cpu->idle_cycles = accounting_kernel_cycles(&idle_thread, current_thread == nullptr);
+    cpu->uptime_ms   = jiffies;
+    cpu->threads     = (int)list_size(&thread_list);
+
+    int count = 0;
+    for (struct list_elem *e = list_begin(&thread_list); e != list_end(&thread_list) && count < max;
+         e = list_next(e)) {
+        auto const thread     = list_entry(e, struct thread, elem);
+        auto const accounting = &thread->accounting;
+        auto const stat       = &threads[count++];
+
+        memset(stat, 0, sizeof(struct thread_stat));
+        stat->pid           = thread->process->pid;
+        stat->tid           = thread->tid;
+        stat->kernel_thread = kthread_is_kernel_thread(thread);
+        stat->state         = scheduler_thread_state_code(thread);
+        strncpy(stat->name, thread->process->file_name, sizeof(stat->name) - 1);
+
+        stat->user_cycles          = accounting->user_cycles;
+        stat->kernel_cycles        = accounting_kernel_cycles(thread, thread == current_thread);
+        stat->voluntary_switches   = accounting->voluntary_switches;
+        stat->involuntary_switches = accounting->involuntary_switches;
+        stat->wakeups              = accounting->wakeups;
+        stat->total_wakeup_latency = accounting->total_wakeup_latency;
+        stat->max_wakeup_latency   = accounting->max_wakeup_latency;
+        stat->page_faults          = accounting->page_faults;
+
+        struct process_memory usage;
+        process_get_memory_usage(thread->process, &usage);
+        stat->memory = usage.total;
     }
 
     return count;
 }
 
-/// @brief If the process is waiting, check their children and remove any zombies
-void scheduler_check_waiting(const struct thread *next)
+/// @brief Check if the thread is sleeping and should wake up
+void scheduler_check_sleeping(struct thread *thread)
+{
+    if (thread->signal == SIGWAKEUP && thread->wait_pid != 0) {
+        thread->state  = WAITING;
+        thread->signal = NONE;
+    } else if (thread->signal == SIGWAKEUP && (int)thread->sleep_until == -1) {
+        thread->state  = RUNNING;
+        thread->signal = NONE;
+        accounting_wakeup(thread);
+    } else if (thread->sleep_until <= jiffies) {
+        thread->state       = RUNNING;
+        thread->signal      = NONE;
+        thread->sleep_until = -1;
+        accounting_wakeup(thread);
+    }
+}
+
+/// @brief If the thread is waiting, check whether the child it is waiting for has exited.
+/// The child is reaped by process_wait_pid() once the waiting thread runs again.
+void scheduler_check_waiting(struct thread *thread)
 {
-    auto const process = next->process;
+    auto const process = thread->process;
 
-    struct process *child;
     // If the wait_pid is -1, wait for any child
-    if (process->wait_pid == -1) {
-        child = find_child_process_by_state(process, ZOMBIE);
-        if (!child && scheduler_count_children(process) == 0) {
-            process->state     = RUNNING;
-            process->exit_code = 0;
-            process->wait_pid  = 0;
-        }
-    } else {
-        // Otherwise, wait for the specific child
-        child = find_child_process_by_pid(process, process->wait_pid);
-        if (!child) {
-            process->state     = RUNNING;
-            process->exit_code = 0;
-            process->wait_pid  = 0;
+    if (thread->wait_pid == -1) {
+        if (find_child_process_by_state(process, ZOMBIE) || process_get_child_count(process) == 0) {
+            thread->state = RUNNING;
+            accounting_wakeup(thread);
         }
+        return;
     }
 
-    if (child && child->state == ZOMBIE) {
-        process->state     = RUNNING;
-        process->exit_code = child->exit_code;
-        process->wait_pid  = 0;
-
-        process_remove_child(process, child);
+    // Otherwise, wait for the specific child
+    const struct process *child = find_child_process_by_pid(process, thread->wait_pid);
+    if (!child || child->state == ZOMBIE) {
+        thread->state = RUNNING;
+        accounting_wakeup(thread);
+    }
+}
 
-        kfree(child);
+/// @brief Whether any queued thread runs a user program, kernel threads do not count
+static bool scheduler_has_user_threads()
+{
+    for (struct list_elem *e = list_begin(&thread_list); e != list_end(&thread_list); e = list_next(e)) {
+        if (!kthread_is_kernel_thread(list_entry(e, struct thread, elem))) {
+            return true;
+        }
     }
+
+    return false;
 }
 
 /// Move the first thread in the thread list to the end of the queue
@@ -349,7 +539,8 @@ void scheduler_rotate_queue()
     }
 }
 
-/// @brief Gets the next thread and runs it
+/// @brief Gets the next thread and runs it. Returns when the calling thread is scheduled again.
+/// A thread that wants to block sets its state before calling schedule() and re-checks its condition afterwards.
 /// @remark Must be called with interrupts disabled
 void schedule()
 {
@@ -357,41 +548,37 @@ void schedule()
 
     scheduler_rotate_queue();
 
-    auto next = scheduler_get_next_thread();
-
-    if (!next) {
+    if (!scheduler_has_user_threads()) {
         printf("\nRestarting the shell");
         start_shell(0);
-        next = scheduler_get_next_thread();
     }
 
-    ASSERT(thread_is_valid(next));
+    // Wake up the threads whose condition is met, and run the first one that is ready.
+    // If no runnable thread is found, run the idle context.
+    struct thread *next = nullptr;
+    for (struct list_elem *e = list_begin(&thread_list); e != list_end(&thread_list); e = list_next(e)) {
+        auto const thread = list_entry(e, struct thread, elem);
+        ASSERT(thread_is_valid(thread));
 
-    struct process *process = next->process;
+        if (thread->state == SLEEPING) {
+            scheduler_check_sleeping(thread);
+        }
 
-    if (process->state == SLEEPING) {
-        scheduler_check_sleeping(process);
-    }
+        if (thread->state == WAITING) {
+            scheduler_check_waiting(thread);
+        }
 
-    if (process->state == WAITING) {
-        scheduler_check_waiting(next);
+        if (!next && thread->state == RUNNING) {
+            next = thread;
+        }
     }
 
-    // If the next thread is not running, find a runnable thread.
-    // If no runnable thread is found, run the idle thread.
-    if (next->process->state != RUNNING) {
-        next = scheduler_get_runnable_thread();
-        if (!next) {
-            scheduler_idle_thread();
-            return;
-        } else {
-            // If we found a runnable thread, put it in the front of the queue
-            list_remove(&next->elem);
-            list_push_front(&thread_list, &next->elem);
-        }
+    if (next) {
+        ASSERT(next->process->page_directory);
+        // The running thread is always in the front of the queue
+        list_remove(&next->elem);
+        list_push_front(&thread_list, &next->elem);
     }
 
-    ASSERT(next->process->page_directory);
-    // If the next thread is in the RUNNING state, switch to it.
     scheduler_switch_thread(next);
 }
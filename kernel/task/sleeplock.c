@@ -1 +1,61 @@
-#include <sleeplock.h>
\ No newline at end of file
+#include <assert.h>
+#include <scheduler.h>
+#include <sleeplock.h>
+#include <softirq.h>
+#include <x86.h>
+
+void sleeplock_init(struct sleeplock *lock, const char *name)
+{
+    lock->locked = false;
+    lock->name   = name;
+    lock->holder = nullptr;
+    spinlock_init(&lock->lk, name);
+    wait_queue_init(&lock->waiters);
+}
+
+void sleeplock_acquire(struct sleeplock *lock)
+{
+    ASSERT(!(read_eflags() & EFLAGS_IF), "Interrupts must be disabled");
+    ASSERT(!softirq_is_running(), "Sleeping in a softirq");
+
+    auto const current = scheduler_get_current_thread();
+
+    spin_lock(&lock->lk);
+    while (lock->locked) {
+        ASSERT(lock->holder != current || !current, "Sleeplock acquired twice");
+        // Interrupts are off, so the holder cannot release the lock and miss us between the unlock and the sleep
+        spin_unlock(&lock->lk);
+        wait_queue_sleep(&lock->waiters);
+        spin_lock(&lock->lk);
+    }
+
+    lock->locked = true;
+    lock->holder = current;
+    if (current) {
+        current->uninterruptible++;
+    }
+    spin_unlock(&lock->lk);
+}
+
+void sleeplock_release(struct sleeplock *lock)
+{
+    spin_lock(&lock->lk);
+    ASSERT(lock->locked, "Releasing a sleeplock that is not held");
+
+    if (lock->holder) {
+        lock->holder->uninterruptible--;
+    }
+    lock->locked = false;
+    lock->holder = nullptr;
+    wait_queue_wake(&lock->waiters, 1);
+    spin_unlock(&lock->lk);
+}
+
+bool sleeplock_holding(struct sleeplock *lock)
+{
+    spin_lock(&lock->lk);
+    const bool holding = lock->locked && lock->holder == scheduler_get_current_thread();
+    spin_unlock(&lock->lk);
+
+    return holding;
+}
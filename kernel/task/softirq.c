@@ -0,0 +1,97 @@
+#include <assert.h>
+#include <printf.h>
+#include <softirq.h>
+#include <x86.h>
+
+// Interrupt handlers only acknowledge the device and raise a softirq. The softirqs run when the interrupt
+// returns, with interrupts enabled, so a long burst of work does not keep the timer and other devices out.
+// Since they run on the stack of whatever was interrupted, softirq handlers must not sleep; work that has to
+// sleep goes to a workqueue.
+
+/// How many times the pending softirqs are picked up again in one run, the rest waits for the next interrupt
+#define SOFTIRQ_MAX_RESTART 8
+
+static SOFTIRQ_HANDLER softirq_handlers[SOFTIRQ_COUNT];
+static struct softirq_stats softirq_stats[SOFTIRQ_COUNT];
+static volatile uint32_t softirq_pending;
+static bool softirq_running;
+
+void softirq_register(const enum SOFTIRQ softirq, const char *name, const SOFTIRQ_HANDLER handler)
+{
+    ASSERT(softirq < SOFTIRQ_COUNT, "Invalid softirq");
+
+    softirq_handlers[softirq]   = handler;
+    softirq_stats[softirq].name = name;
+}
+
+/// @brief Mark the softirq as pending, it runs when the current interrupt returns
+/// @remark Must be called with interrupts disabled
+void softirq_raise(const enum SOFTIRQ softirq)
+{
+    softirq_pending |= 1U << softirq;
+    softirq_stats[softirq].raised++;
+}
+
+/// @brief Run the pending softirqs with interrupts enabled. Interrupts that arrive meanwhile only raise more
+/// softirqs, which are picked up by this same run.
+/// @remark Must be called with interrupts disabled, they are disabled again on return
+void softirq_run(void)
+{
+    ASSERT(!(read_eflags() & EFLAGS_IF), "Interrupts must be disabled");
+
+    if (softirq_running || !softirq_pending) {
+        return;
+    }
+    softirq_running = true;
+
+    for (int restart = 0; softirq_pending && restart < SOFTIRQ_MAX_RESTART; restart++) {
+        const uint32_t pending = softirq_pending;
+        softirq_pending        = 0;
+
+        sti();
+        for (int i = 0; i < SOFTIRQ_COUNT; i++) {
+            if (!(pending & (1U << i)) || !softirq_handlers[i]) {
+                continue;
+            }
+
+            const uint64_t start = rdtsc();
+            softirq_handlers[i]();
+            const uint64_t cycles = rdtsc() - start;
+
+            softirq_stats[i].runs++;
+            softirq_stats[i].total_cycles += cycles;
+            if (cycles > softirq_stats[i].max_cycles) {
+                softirq_stats[i].max_cycles = cycles;
+            }
+        }
+        cli();
+    }
+
+    softirq_running = false;
+}
+
+bool softirq_is_running(void)
+{
+    return softirq_running;
+}
+
+const struct softirq_stats *softirq_get_stats(const enum SOFTIRQ softirq)
+{
+    ASSERT(softirq < SOFTIRQ_COUNT, "Invalid softirq");
+
+    return &softirq_stats[softirq];
+}
+
+void softirq_print_stats(void)
+{
+    printf("\n %-10s%-10s%-10s%-14s%-14s\n", "Softirq", "Raised", "Runs", "Avg cycles", "Max cycles");
+    for (int i = 0; i < SOFTIRQ_COUNT; i++) {
+        const struct softirq_stats *stats = &softirq_stats[i];
+        if (!stats->name) {
+            continue;
+        }
+
+        const uint64_t average = stats->runs ? stats->total_cycles / stats->runs : 0;
+        printf(" %-10s%-10lu%-10lu%-14llu%-14llu\n", stats->name, stats->raised, stats->runs, average, stats->max_cycles);
+    }
+}
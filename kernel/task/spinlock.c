@@ -1,26 +1,131 @@
+#include <printf.h>
 #include <spinlock.h>
+#include <termcolors.h>
 #include <x86.h>
 
-void spinlock_init(spinlock_t *lock)
+#if SPINLOCK_STATS
+/// Every lock that was taken at least once
+static spinlock_t *stats_locks;
+
+static void spinlock_stats_acquired(spinlock_t *lock, const uint32_t spins)
+{
+    if (!__atomic_exchange_n(&lock->registered, true, __ATOMIC_RELAXED)) {
+        lock->stats_next = __atomic_load_n(&stats_locks, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(
+            &stats_locks, &lock->stats_next, lock, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        }
+    }
+
+    lock->stats.acquisitions++;
+    if (spins) {
+        lock->stats.contended++;
+        lock->stats.spins += spins;
+    }
+    lock->acquired_at = rdtsc();
+}
+
+static void spinlock_stats_released(spinlock_t *lock)
 {
-    *lock = 0;
+    const uint64_t held = rdtsc() - lock->acquired_at;
+    lock->stats.total_hold_cycles += held;
+    if (held > lock->stats.max_hold_cycles) {
+        lock->stats.max_hold_cycles = held;
+    }
+}
+#endif
+
+void spinlock_init(spinlock_t *lock, const char *name)
+{
+    *lock      = (spinlock_t){};
+    lock->name = name;
 }
 
 void spin_lock(spinlock_t *lock)
 {
-    while (1) {
-        if (!__atomic_load_n(lock, __ATOMIC_RELAXED)) {
-            if (!__atomic_test_and_set(lock, __ATOMIC_ACQUIRE)) {
-                return;
-            }
-        }
+    const uint16_t ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+
+    uint32_t spins = 0;
+    while (__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket) {
         pause();
+        spins++;
+    }
+
+#if SPINLOCK_STATS
+    spinlock_stats_acquired(lock, spins);
+#endif
+}
+
+/// @brief Take the lock only if nobody holds it or waits for it
+bool spin_trylock(spinlock_t *lock)
+{
+    uint16_t ticket = __atomic_load_n(&lock->owner, __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(
+            &lock->next, &ticket, (uint16_t)(ticket + 1), false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return false;
     }
+
+#if SPINLOCK_STATS
+    spinlock_stats_acquired(lock, 0);
+#endif
+
+    return true;
 }
 
 void spin_unlock(spinlock_t *lock)
 {
-    __sync_synchronize();
+#if SPINLOCK_STATS
+    spinlock_stats_released(lock);
+#endif
+
+    // Only the holder writes owner
+    __atomic_store_n(&lock->owner, (uint16_t)(lock->owner + 1), __ATOMIC_RELEASE);
+}
+
+bool spin_is_locked(spinlock_t *lock)
+{
+    return __atomic_load_n(&lock->owner, __ATOMIC_RELAXED) != __atomic_load_n(&lock->next, __ATOMIC_RELAXED);
+}
 
-    __atomic_clear(lock, __ATOMIC_RELEASE);
-}
\ No newline at end of file
+/// @brief Take a lock that is also taken by interrupt handlers
+/// @return the flags to hand back to spin_unlock_irqrestore()
+uint32_t spin_lock_irqsave(spinlock_t *lock)
+{
+    const uint32_t flags = read_eflags();
+    cli();
+    spin_lock(lock);
+
+    return flags;
+}
+
+/// @brief Release the lock and enable interrupts again if they were enabled by spin_lock_irqsave()
+void spin_unlock_irqrestore(spinlock_t *lock, const uint32_t flags)
+{
+    spin_unlock(lock);
+    if (flags & EFLAGS_IF) {
+        sti();
+    }
+}
+
+void spinlock_print_stats(void)
+{
+#if SPINLOCK_STATS
+    printf(KBBLU "\n %-24s%-12s%-12s%-12s%-14s%-14s\n" KWHT,
+           "Spinlock",
+           "Acquired",
+           "Contended",
+           "Spins",
+           "Avg hold",
+           "Max hold");
+
+    for (const spinlock_t *lock = __atomic_load_n(&stats_locks, __ATOMIC_ACQUIRE); lock; lock = lock->stats_next) {
+        const struct spinlock_stats *stats = &lock->stats;
+        printf(" %-24s%-12lu%-12lu%-12llu%-14llu%-14llu\n",
+               lock->name ? lock->name : "?",
+               stats->acquisitions,
+               stats->contended,
+               stats->spins,
+               stats->acquisitions ? stats->total_hold_cycles / stats->acquisitions : 0,
+               stats->max_hold_cycles);
+    }
+#endif
+}
@@ -53,6 +53,8 @@ thread_switch:
     mov ds, ax
     mov es, ax
     mov fs, ax
+    ; gs points to the thread local storage
+    mov ax, USER_TLS_SELECTOR
     mov gs, ax
 
     ; pass the struct as an argument to restore_general_purpose_registers
@@ -87,6 +89,29 @@ restore_general_purpose_registers:
     add esp, 4
     ret
 
+; void thread_context_switch(uint32_t *old_esp, uint32_t new_esp)
+; Saves the callee-saved registers on the current kernel stack, stores the stack pointer in *old_esp,
+; then loads new_esp and restores the registers that were saved there. The ret at the end resumes the
+; other thread where it called thread_context_switch (or at the entry point prepared by thread_init).
+global thread_context_switch
+thread_context_switch:
+    mov eax, [esp + 4]   ; old_esp
+    mov edx, [esp + 8]   ; new_esp
+
+    push ebp
+    push ebx
+    push esi
+    push edi
+
+    mov [eax], esp
+    mov esp, edx
+
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    ret
+
 ; void set_user_mode_registers()
 global set_user_mode_segments
 set_user_mode_segments:
@@ -94,19 +119,7 @@ set_user_mode_segments:
     mov ds, ax
     mov es, ax
     mov fs, ax
+    ; gs points to the thread local storage
+    mov ax, USER_TLS_SELECTOR
     mov gs, ax
     ret
-
-global acquire_lock
-acquire_lock:
-.retry:
-    mov edi, [esp + 4]
-    lock bts dword [edi],0
-    jc .retry
-    ret
-
-global release_lock
-release_lock:
-    mov edi, [esp + 4]
-    lock btr dword [edi],0
-    ret
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <debug.h>
 #include <elf.h>
+#include <fpu.h>
 #include <idt.h>
 #include <kernel.h>
 #include <kernel_heap.h>
@@ -10,20 +11,188 @@
 #include <status.h>
 #include <string.h>
 #include <thread.h>
+#include <x86.h>
 
-int thread_init(struct thread *thread, struct process *process);
+// Each slot holds the TLS block, a guard page and the user stack of a secondary thread
+#define THREAD_SLOT_SIZE (USER_TLS_SIZE + PAGING_PAGE_SIZE + USER_THREAD_STACK_SIZE)
+
+static_assert(MAX_THREADS_PER_PROCESS <= 64, "The thread slot bitmap is 64 bits wide");
+static_assert(USER_THREADS_ADDRESS + MAX_THREADS_PER_PROCESS * THREAD_SLOT_SIZE <= HEAP_ADDRESS,
+              "The thread slots overlap the kernel heap");
+
+static int thread_init(struct thread *thread, struct process *process, int slot);
+
+static uint32_t thread_slot_address(const int slot)
+{
+    return USER_THREADS_ADDRESS + slot * THREAD_SLOT_SIZE;
+}
+
+/// @brief Reserve a slot in the USER_THREADS_ADDRESS region
+/// @param slot the slot to reserve, or -1 for the lowest free one
+/// @return the reserved slot, or an error code
+static int thread_reserve_slot(struct process *process, const int slot)
+{
+    if (slot >= 0) {
+        if (process->thread_slots & (1ULL << slot)) {
+            return -EINSTKN;
+        }
+        process->thread_slots |= 1ULL << slot;
+        return slot;
+    }
+
+    for (int i = 0; i < MAX_THREADS_PER_PROCESS; i++) {
+        if (!(process->thread_slots & (1ULL << i))) {
+            process->thread_slots |= 1ULL << i;
+            return i;
+        }
+    }
+
+    return -EAGAIN;
+}
+
+/// @brief Map a block of kernel memory at the given user address, writable by the thread
+static int thread_map_user_memory(const struct thread *thread, const uint32_t address, void *physical,
+                                  const size_t size)
+{
+    return paging_map_to(thread->process->page_directory,
+                         (void *)address,
+                         physical,
+                         paging_align_address((char *)physical + size),
+                         PAGING_DIRECTORY_ENTRY_IS_PRESENT | PAGING_DIRECTORY_ENTRY_IS_WRITABLE |
+                             PAGING_DIRECTORY_ENTRY_SUPERVISOR);
+}
+
+/// @brief Restore the default read-only identity mapping of a fresh page directory
+static int thread_unmap_user_memory(const struct thread *thread, const uint32_t address, const size_t size)
+{
+    return paging_map_to(thread->process->page_directory,
+                         (void *)address,
+                         (void *)address,
+                         (void *)(address + size),
+                         PAGING_DIRECTORY_ENTRY_IS_PRESENT | PAGING_DIRECTORY_ENTRY_SUPERVISOR);
+}
+
+static void thread_write_control_block(const struct thread *thread)
+{
+    struct thread_control_block *tcb = thread->tls;
+
+    tcb->self = thread->tls_address;
+    tcb->tid  = thread->tid;
+}
+
+/// @brief Allocate the user stack of a secondary thread and map it in the thread's slot
+static int thread_allocate_user_stack(struct thread *thread)
+{
+    thread->user_stack = kzalloc(USER_THREAD_STACK_SIZE);
+    if (!thread->user_stack) {
+        warningf("Failed to allocate user stack for thread %d\n", thread->tid);
+        return -ENOMEM;
+    }
+
+    thread->user_stack_address = thread_slot_address(thread->slot) + USER_TLS_SIZE + PAGING_PAGE_SIZE;
+
+    return thread_map_user_memory(thread, thread->user_stack_address, thread->user_stack, USER_THREAD_STACK_SIZE);
+}
+
+/// @brief Free the TLS block and the user stack of the thread and give its slot back to the process
+void thread_free_user_memory(struct thread *thread)
+{
+    auto const process = thread->process;
+
+    if (thread->tls) {
+        if (process->page_directory) {
+            thread_unmap_user_memory(thread, thread->tls_address, USER_TLS_SIZE);
+        }
+        kfree(thread->tls);
+        thread->tls = nullptr;
+    }
+
+    if (thread->user_stack) {
+        if (process->page_directory) {
+            thread_unmap_user_memory(thread, thread->user_stack_address, USER_THREAD_STACK_SIZE);
+        }
+        kfree(thread->user_stack);
+        thread->user_stack = nullptr;
+    }
+
+    if (thread->slot >= 0) {
+        process->thread_slots &= ~(1ULL << thread->slot);
+        thread->slot = -1;
+    }
+}
+
+/// @brief Free the thread's kernel stack and the thread itself
+/// @warning The thread must not be queued and must not be running
+void thread_release(struct thread *thread)
+{
+    if (thread->kernel_stack) {
+        kfree(thread->kernel_stack);
+    }
+    thread->magic = 0;
+    kfree(thread);
+}
 
 int thread_free(struct thread *thread)
 {
     scheduler_unqueue_thread(thread);
-    scheduler_remove_current_thread(thread);
+    wait_queue_remove(thread);
+    fpu_release(thread);
+    list_remove(&thread->process_elem);
+    thread_free_user_memory(thread);
 
-    kfree(thread);
+    if (thread->process->thread == thread) {
+        thread->process->thread = nullptr;
+    }
+
+    // A thread cannot free the stack it is running on, the scheduler releases it after switching away
+    if (thread == scheduler_get_current_thread()) {
+        scheduler_remove_current_thread(thread);
+        return ALL_OK;
+    }
+
+    thread_release(thread);
 
     return ALL_OK;
 }
 
-struct thread *thread_create(struct process *process)
+uint32_t thread_kernel_stack_top(const struct thread *thread)
+{
+    return (uint32_t)thread->kernel_stack + KERNEL_STACK_SIZE;
+}
+
+/// @brief The first function a new thread runs on its kernel stack, it enters user mode with the thread's registers
+/// @param thread the thread that is starting
+[[noreturn]] static void thread_start(struct thread *thread)
+{
+    scheduler_finish_switch();
+
+    thread_page_thread(thread);
+    accounting_leave_kernel(thread);
+    thread_switch(&thread->registers);
+
+    __builtin_unreachable();
+}
+
+/// @brief Build the initial kernel stack so that the first thread_context_switch to the thread "returns"
+/// into entry(thread). User threads start in thread_start
+void thread_init_kernel_stack(struct thread *thread, void (*entry)(struct thread *thread))
+{
+    auto sp = (uint32_t *)thread_kernel_stack_top(thread);
+
+    *--sp = (uint32_t)thread; // entry argument
+    *--sp = 0;                // entry return address, never used
+    *--sp = (uint32_t)entry;  // thread_context_switch returns here
+    *--sp = 0;                      // ebp
+    *--sp = 0;                      // ebx
+    *--sp = 0;                      // esi
+    *--sp = 0;                      // edi
+
+    thread->kernel_esp = (uint32_t)sp;
+}
+
+/// @brief Allocate and initialize a thread
+/// @param slot the slot of the thread in the USER_THREADS_ADDRESS region, or -1 for any free slot
+static struct thread *thread_create_in_slot(struct process *process, const int slot)
 {
     int res = 0;
 
@@ -34,21 +203,138 @@ struct thread *thread_create(struct process *process)
         goto out;
     }
 
-    res = thread_init(thread, process);
+    res = thread_init(thread, process, slot);
     if (res != ALL_OK) {
         dbgprintf("Failed to initialize thread\n");
         goto out;
     }
 
 out:
+    if (ISERR(res)) {
+        if (thread) {
+            thread_free_user_memory(thread);
+            thread_release(thread);
+        }
+        return ERROR(res);
+    }
+
+    return thread;
+}
+
+/// @brief Create the main thread of the process. The process page directory is created if it does not exist yet
+struct thread *thread_create(struct process *process)
+{
+    return thread_create_in_slot(process, -1);
+}
+
+/// @brief Create a copy of a thread in a forked process, with the same registers, TLS and user stack
+struct thread *thread_clone(struct process *process, const struct thread *src)
+{
+    auto const thread = thread_create_in_slot(process, src->slot);
+    if (ISERR(thread)) {
+        return thread;
+    }
+
+    thread_copy_registers(thread, src);
+    memcpy(thread->tls, src->tls, USER_TLS_SIZE);
+    thread_write_control_block(thread);
+
+    int res = fpu_copy_state(thread, src);
+    if (ISERR(res)) {
+        thread_free(thread);
+        return ERROR(res);
+    }
+
+    if (src->user_stack) {
+        res = thread_allocate_user_stack(thread);
+        if (ISERR(res)) {
+            thread_free(thread);
+            return ERROR(res);
+        }
+        memcpy(thread->user_stack, src->user_stack, USER_THREAD_STACK_SIZE);
+    }
+
+    return thread;
+}
+
+/// @brief Create a secondary thread that shares the address space of the process.
+/// The thread starts at entry, with start_routine and arg as the arguments on its new user stack.
+struct thread *thread_spawn(struct process *process, const uint32_t entry, const uint32_t start_routine,
+                            const uint32_t arg)
+{
+    auto const thread = thread_create_in_slot(process, -1);
+    if (ISERR(thread)) {
+        return thread;
+    }
+
+    const int res = thread_allocate_user_stack(thread);
     if (ISERR(res)) {
         thread_free(thread);
         return ERROR(res);
     }
 
+    // entry(start_routine, arg)
+    auto sp = (uint32_t *)((char *)thread->user_stack + USER_THREAD_STACK_SIZE);
+    *--sp   = arg;
+    *--sp   = start_routine;
+    *--sp   = 0; // return address, entry must not return
+
+    thread->registers.eip = entry;
+    thread->registers.esp = thread->user_stack_address + USER_THREAD_STACK_SIZE - 3 * sizeof(uint32_t);
+
     return thread;
 }
 
+/// @brief Terminate the running thread. It stays in the process thread list as a zombie until it is joined.
+void thread_exit(struct thread *thread, const int exit_code)
+{
+    ASSERT(thread == scheduler_get_current_thread());
+
+    thread->exit_code = exit_code;
+    thread->state     = ZOMBIE;
+    scheduler_unqueue_thread(thread);
+    thread_free_user_memory(thread);
+
+    if (thread->joiner) {
+        thread->joiner->signal = SIGWAKEUP;
+    }
+
+    cli();
+    schedule();
+
+    panic("Trying to schedule a dead thread");
+}
+
+/// @brief Wait for a thread of the same process to exit and free it
+/// @param exit_code the value the thread passed to thread_exit()
+/// @return ALL_OK on success, error code otherwise
+int thread_join(struct thread *current, const int tid, int *exit_code)
+{
+    auto const thread = process_find_thread(current->process, tid);
+    if (!thread) {
+        return -ENOENT;
+    }
+
+    if (thread == current || (thread->joiner && thread->joiner != current)) {
+        return -EINVARG;
+    }
+
+    thread->joiner = current;
+    while (thread->state != ZOMBIE) {
+        current->sleep_until  = -1;
+        current->sleep_reason = SLEEP_REASON_JOIN;
+        current->state        = SLEEPING;
+
+        schedule();
+    }
+    current->sleep_reason = SLEEP_REASON_NONE;
+
+    *exit_code = thread->exit_code;
+    thread_free(thread);
+
+    return ALL_OK;
+}
+
 /// @brief Set the user mode segments and switch to the thread's page directory
 /// @param thread the thread to switch to
 int thread_page_thread(const struct thread *thread)
@@ -96,18 +382,52 @@ out:
     return res;
 }
 
-int thread_init(struct thread *thread, struct process *process)
+static int thread_init(struct thread *thread, struct process *process, const int slot)
 {
     memset(thread, 0, sizeof(struct thread));
-    thread->process = process;
-    thread->process->page_directory =
-        paging_create_directory(PAGING_DIRECTORY_ENTRY_IS_PRESENT | PAGING_DIRECTORY_ENTRY_SUPERVISOR);
+    thread->process     = process;
+    thread->state       = RUNNING;
+    thread->sleep_until = -1;
+    thread->slot        = -1;
 
-    if (!thread->process->page_directory) {
-        dbgprintf("Failed to create page directory for thread %x\n", &thread);
-        ASSERT(false, "Failed to create page directory");
+    thread->kernel_stack = kzalloc(KERNEL_STACK_SIZE);
+    if (!thread->kernel_stack) {
+        warningf("Failed to allocate kernel stack for thread %x\n", thread);
         return -ENOMEM;
     }
+    thread_init_kernel_stack(thread, thread_start);
+
+    // All the threads of a process share its page directory
+    if (!process->page_directory) {
+        process->page_directory =
+            paging_create_directory(PAGING_DIRECTORY_ENTRY_IS_PRESENT | PAGING_DIRECTORY_ENTRY_SUPERVISOR);
+        if (!process->page_directory) {
+            dbgprintf("Failed to create page directory for thread %x\n", &thread);
+            ASSERT(false, "Failed to create page directory");
+            return -ENOMEM;
+        }
+    }
+
+    const int reserved = thread_reserve_slot(process, slot);
+    if (reserved < 0) {
+        warningf("No free thread slot in process %d\n", process->pid);
+        return reserved;
+    }
+    thread->slot = reserved;
+
+    thread->tls = kzalloc(USER_TLS_SIZE);
+    if (!thread->tls) {
+        warningf("Failed to allocate TLS for thread %x\n", thread);
+        return -ENOMEM;
+    }
+    thread->tls_address = thread_slot_address(thread->slot);
+    const int res       = thread_map_user_memory(thread, thread->tls_address, thread->tls, USER_TLS_SIZE);
+    if (res < 0) {
+        return res;
+    }
+
+    thread->tid = process->next_tid++;
+    thread_write_control_block(thread);
 
     switch (process->file_type) {
     case PROCESS_FILE_TYPE_BINARY:
@@ -126,6 +446,8 @@ int thread_init(struct thread *thread, struct process *process)
     thread->registers.esp = USER_STACK_TOP;
     thread->magic         = THREAD_MAGIC;
 
+    list_push_back(&process->threads, &thread->process_elem);
+
     dbgprintf("Thread %x initialized\n", thread);
 
     return ALL_OK;
@@ -0,0 +1,89 @@
+#include <assert.h>
+#include <scheduler.h>
+#include <thread.h>
+#include <wait_queue.h>
+
+void wait_queue_init(struct wait_queue *queue)
+{
+    list_init(&queue->waiters);
+}
+
+/// @brief Block the current thread on the queue until wait_queue_wake() picks it
+void wait_queue_sleep(struct wait_queue *queue)
+{
+    wait_queue_sleep_keyed(queue, 0);
+}
+
+/// @brief Block the current thread on the queue until a wake with the same key picks it
+void wait_queue_sleep_keyed(struct wait_queue *queue, const uintptr_t key)
+{
+    auto const thread = scheduler_get_current_thread();
+    ASSERT(thread, "No thread to put to sleep");
+
+    struct wait_queue_entry entry = {
+        .thread = thread,
+        .key    = key,
+        .woken  = false,
+    };
+    list_push_back(&queue->waiters, &entry.elem);
+    thread->wait_entry = &entry;
+
+    while (!entry.woken) {
+        thread->sleep_until  = -1;
+        thread->sleep_reason = SLEEP_REASON_WAIT_QUEUE;
+        thread->state        = SLEEPING;
+
+        schedule();
+    }
+
+    thread->sleep_reason = SLEEP_REASON_NONE;
+    thread->wait_entry   = nullptr;
+}
+
+/// @brief Wake up to count waiters in FIFO order
+/// @return the number of threads woken
+int wait_queue_wake(struct wait_queue *queue, const int count)
+{
+    return wait_queue_wake_keyed(queue, 0, count);
+}
+
+/// @brief Wake up to count waiters sleeping with the given key, in FIFO order
+/// @return the number of threads woken
+int wait_queue_wake_keyed(struct wait_queue *queue, const uintptr_t key, const int count)
+{
+    int woken = 0;
+
+    auto elem = list_begin(&queue->waiters);
+    while (elem != list_end(&queue->waiters) && woken < count) {
+        auto const entry = list_entry(elem, struct wait_queue_entry, elem);
+        elem             = list_next(elem);
+        if (entry->key != key) {
+            continue;
+        }
+
+        list_remove(&entry->elem);
+        entry->woken          = true;
+        entry->thread->signal = SIGWAKEUP;
+        woken++;
+    }
+
+    return woken;
+}
+
+/// @brief Take a thread off the queue it sleeps on, used when the thread is freed while blocked
+void wait_queue_remove(struct thread *thread)
+{
+    if (!thread->wait_entry) {
+        return;
+    }
+
+    if (!thread->wait_entry->woken) {
+        list_remove(&thread->wait_entry->elem);
+    }
+    thread->wait_entry = nullptr;
+}
+
+bool wait_queue_empty(struct wait_queue *queue)
+{
+    return list_empty(&queue->waiters);
+}
@@ -0,0 +1,144 @@
+#include <assert.h>
+#include <kernel.h>
+#include <kernel_heap.h>
+#include <kthread.h>
+#include <memory.h>
+#include <printf.h>
+#include <scheduler.h>
+#include <serial.h>
+#include <status.h>
+#include <string.h>
+#include <thread.h>
+#include <workqueue.h>
+#include <x86.h>
+
+/// Catch-all workqueue for work that does not need a worker of its own
+struct workqueue *system_workqueue = nullptr;
+static struct list workqueues;
+
+void workqueue_init(void)
+{
+    list_init(&workqueues);
+
+    system_workqueue = workqueue_create("events");
+    if (ISERR(system_workqueue)) {
+        panic("Failed to create the system workqueue");
+    }
+}
+
+void work_init(struct work *work, const WORK_FUNCTION function)
+{
+    memset(work, 0, sizeof(struct work));
+    work->function = function;
+}
+
+/// @brief The worker thread of a workqueue. Works run with interrupts disabled like syscalls, so they can call
+/// anything a syscall can, and may sleep.
+static void workqueue_worker(void *arg)
+{
+    struct workqueue *queue = arg;
+
+    while (true) {
+        while (list_empty(&queue->works)) {
+            wait_queue_sleep(&queue->idle);
+        }
+
+        auto const work = list_entry(list_pop_front(&queue->works), struct work, elem);
+        work->pending   = false;
+        queue->stats.depth--;
+
+        const uint64_t start   = rdtsc();
+        const uint64_t latency = start - work->queued_at;
+        if (latency > queue->stats.max_latency_cycles) {
+            queue->stats.max_latency_cycles = latency;
+        }
+
+        work->function(work);
+        ASSERT(!(read_eflags() & EFLAGS_IF), "Work returned with interrupts enabled");
+
+        const uint64_t cycles = rdtsc() - start;
+        queue->stats.executed++;
+        queue->stats.total_cycles += cycles;
+        if (cycles > queue->stats.max_cycles) {
+            queue->stats.max_cycles = cycles;
+        }
+    }
+}
+
+struct workqueue *workqueue_create(const char *name)
+{
+    struct workqueue *queue = kzalloc(sizeof(struct workqueue));
+    if (!queue) {
+        return ERROR(-ENOMEM);
+    }
+
+    strncpy(queue->name, name, sizeof(queue->name) - 1);
+    list_init(&queue->works);
+    wait_queue_init(&queue->idle);
+
+    queue->worker = kthread_create(name, workqueue_worker, queue);
+    if (ISERR(queue->worker)) {
+        const int res = ERROR_I(queue->worker);
+        kfree(queue);
+        return ERROR(res);
+    }
+
+    list_push_back(&workqueues, &queue->elem);
+
+    return queue;
+}
+
+/// @brief Queue the work, it runs later in the worker thread. Safe to call from interrupt handlers
+/// @remark Must be called with interrupts disabled
+/// @return false if the work was already pending
+bool workqueue_queue(struct workqueue *queue, struct work *work)
+{
+    ASSERT(!(read_eflags() & EFLAGS_IF), "Interrupts must be disabled");
+
+    if (work->pending) {
+        return false;
+    }
+
+    work->pending   = true;
+    work->queued_at = rdtsc();
+    list_push_back(&queue->works, &work->elem);
+
+    queue->stats.queued++;
+    queue->stats.depth++;
+    if (queue->stats.depth > queue->stats.max_depth) {
+        queue->stats.max_depth = queue->stats.depth;
+    }
+
+    wait_queue_wake(&queue->idle, 1);
+    scheduler_request_reschedule();
+
+    return true;
+}
+
+void workqueue_print_stats(void)
+{
+    printf("\n %-10s%-8s%-10s%-8s%-10s%-14s%-14s%-14s\n",
+           "Workqueue",
+           "Depth",
+           "Queued",
+           "Max",
+           "Executed",
+           "Avg cycles",
+           "Max cycles",
+           "Max latency");
+    for (auto e = list_begin(&workqueues); e != list_end(&workqueues); e = list_next(e)) {
+        auto const queue                    = list_entry(e, struct workqueue, elem);
+        const struct workqueue_stats *stats = &queue->stats;
+
+        const uint64_t average = stats->executed ? stats->total_cycles / stats->executed : 0;
+        printf(" %-10s%-8lu%-10lu%-8lu%-10lu%-14llu%-14llu%-14llu\n",
+               queue->name,
+               stats->depth,
+               stats->queued,
+               stats->max_depth,
+               stats->executed,
+               average,
+               stats->max_cycles,
+               stats->max_latency_cycles);
+    }
+}
@@ -42,7 +42,7 @@ int ansi_to_vga_background[] = {
     0x70  // White (Light Grey in VGA)
 };
 
-spinlock_t vga_lock;
+spinlock_t vga_lock = SPINLOCK_INITIALIZER("vga");
 
 void enable_cursor(const uint8_t cursor_start, const uint8_t cursor_end)
 {
@@ -229,7 +229,7 @@ void vga_buffer_init()
 {
     cursor_x = 0;
     cursor_y = 0;
-    spinlock_init(&vga_lock);
+    spinlock_init(&vga_lock, "vga");
     terminal_clear();
 }
 
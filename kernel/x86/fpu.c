@@ -0,0 +1,165 @@
+#include <fpu.h>
+#include <idt.h>
+#include <kernel.h>
+#include <kernel_heap.h>
+#include <memory.h>
+#include <scheduler.h>
+#include <serial.h>
+#include <status.h>
+#include <thread.h>
+#include <x86.h>
+
+// https://wiki.osdev.org/FPU
+// https://wiki.osdev.org/SSE
+//
+// The x87/SSE registers are switched lazily. Every context switch to a thread that does not own the registers
+// sets CR0.TS, and the first FPU or SSE instruction the thread runs traps with #NM (device not available).
+// Only then the registers of the owner are saved and the ones of the thread restored. Threads that never use the
+// FPU never get a save area and never pay for the switch.
+//
+// The kernel itself only uses the x87 to print doubles, it runs on the registers of the current thread.
+
+#define NM_INTERRUPT 7
+
+/// The thread whose state is loaded in the FPU registers. nullptr when it is the idle context, or nobody
+static struct thread *fpu_owner;
+/// State after FNINIT with the default MXCSR, every thread starts with a copy of it
+static uint8_t fpu_initial_state[FPU_STATE_SIZE] __attribute__((aligned(16)));
+
+static inline void fxsave(void *state)
+{
+    asm volatile("fxsave (%0)" : : "r"(state) : "memory");
+}
+
+static inline void fxrstor(const void *state)
+{
+    asm volatile("fxrstor (%0)" : : "r"(state) : "memory");
+}
+
+/// @brief Save the registers of the owner, if it is the given thread
+static void fpu_save(const struct thread *thread)
+{
+    if (thread == fpu_owner && thread->fpu_state) {
+        clts();
+        fxsave(thread->fpu_state);
+    }
+}
+
+/// @brief Allocate the save area of a thread the first time it uses the FPU
+static int fpu_allocate_state(struct thread *thread)
+{
+    if (thread->fpu_state) {
+        return ALL_OK;
+    }
+
+    // Heap blocks are page aligned, which satisfies the 16 byte alignment of FXSAVE
+    thread->fpu_state = kzalloc(FPU_STATE_SIZE);
+    if (!thread->fpu_state) {
+        return -ENOMEM;
+    }
+    memcpy(thread->fpu_state, fpu_initial_state, FPU_STATE_SIZE);
+
+    return ALL_OK;
+}
+
+/// @brief #NM handler, hands the FPU registers over to the current thread
+static void fpu_device_not_available_handler(const int interrupt, const struct interrupt_frame *frame)
+{
+    // #NM comes through a trap gate, nothing may switch threads while the registers change hands
+    cli();
+    clts();
+
+    auto const thread = scheduler_get_current_thread();
+    if (thread == fpu_owner) {
+        return;
+    }
+
+    if (fpu_owner && fpu_owner->fpu_state) {
+        fxsave(fpu_owner->fpu_state);
+    }
+    fpu_owner = nullptr;
+
+    if (!thread) {
+        asm volatile("fninit");
+        return;
+    }
+
+    if (fpu_allocate_state(thread) < 0) {
+        warningf("Failed to allocate the FPU state for thread %d\n", thread->tid);
+        idt_exception_handler(interrupt, frame);
+        return;
+    }
+
+    fxrstor(thread->fpu_state);
+    fpu_owner = thread;
+}
+
+void fpu_init(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_EDX_FPU) || !(edx & CPUID_EDX_FXSR)) {
+        panic("The CPU does not support FXSAVE/FXRSTOR");
+    }
+
+    // Native x87 error reporting, FWAIT honors TS, and no emulation
+    write_cr0((read_cr0() | CR0_MP | CR0_NE) & ~(CR0_EM | CR0_TS));
+
+    uint32_t cr4 = read_cr4() | CR4_OSFXSR;
+    if (edx & CPUID_EDX_SSE) {
+        cr4 |= CR4_OSXMMEXCPT;
+    }
+    write_cr4(cr4);
+
+    asm volatile("fninit");
+    if (edx & CPUID_EDX_SSE) {
+        const uint32_t mxcsr = 0x1F80; // All SIMD exceptions masked, round to nearest
+        asm volatile("ldmxcsr %0" : : "m"(mxcsr));
+    }
+    fxsave(fpu_initial_state);
+
+    fpu_owner = nullptr;
+    idt_register_interrupt_callback(NM_INTERRUPT, fpu_device_not_available_handler);
+}
+
+/// @brief Called on every context switch. Arms #NM unless the next thread already owns the registers
+/// @param next the thread about to run, nullptr for the idle context
+void fpu_switch(const struct thread *next)
+{
+    if (next == fpu_owner) {
+        clts();
+    } else {
+        write_cr0(read_cr0() | CR0_TS);
+    }
+}
+
+/// @brief Give a cloned thread a copy of the FPU state of the source thread
+int fpu_copy_state(struct thread *dest, const struct thread *src)
+{
+    if (!src->fpu_state) {
+        return ALL_OK;
+    }
+
+    fpu_save(src);
+
+    const int res = fpu_allocate_state(dest);
+    if (res < 0) {
+        return res;
+    }
+    memcpy(dest->fpu_state, src->fpu_state, FPU_STATE_SIZE);
+
+    return ALL_OK;
+}
+
+/// @brief Drop the FPU state of a thread that is going away
+void fpu_release(struct thread *thread)
+{
+    if (fpu_owner == thread) {
+        fpu_owner = nullptr;
+    }
+
+    if (thread->fpu_state) {
+        kfree(thread->fpu_state);
+        thread->fpu_state = nullptr;
+    }
+}
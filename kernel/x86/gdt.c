@@ -1,14 +1,15 @@
 #include "gdt.h"
+#include "config.h"
 #include "tss.h"
 
-struct gdt_entry gdt_entries[6];
+struct gdt_entry gdt_entries[7];
 struct gdt_ptr gdt_ptr;
 
 extern uint32_t kernel_stack_top;
 
 void gdt_init()
 {
-    gdt_ptr.limit = (sizeof(struct gdt_entry) * 6) - 1;
+    gdt_ptr.limit = (sizeof(struct gdt_entry) * 7) - 1;
     gdt_ptr.base = (uint32_t)&gdt_entries;
 
     // Null segment
@@ -29,6 +30,9 @@ void gdt_init()
     // TSS segment
     write_tss(5, 0x10, (uint32_t)&kernel_stack_top);
 
+    // User thread local storage segment, the base is set on every thread switch
+    gdt_set_gate(6, 0, USER_TLS_SIZE - 1, 0xF2, 0x40);
+
     // Load the new GDT
     gdt_flush((uint32_t)&gdt_ptr);
 
@@ -48,4 +52,11 @@ void gdt_set_gate(int num, uint32_t base, uint32_t limit, uint8_t access, uint8_
 
     gdt_entries[num].granularity |= (gran & 0xF0);
     gdt_entries[num].access = access;
-}
\ No newline at end of file
+}
+
+/// @brief Point the user TLS segment at the TLS block of the thread that is about to run.
+/// The new base is picked up the next time %gs is loaded with USER_TLS_SELECTOR.
+void gdt_set_tls_base(const uint32_t base)
+{
+    gdt_set_gate(6, base, USER_TLS_SIZE - 1, 0xF2, 0x40);
+}
@@ -78,17 +78,17 @@ isr80h_wrapper:
     ; eax will contain the syscall id
     push eax
     call syscall_handler
-    mov dword[tmp_response], eax ; saves the response of the system call
     add esp, 8
 
+    ; store the response of the system call in the saved eax, so popad hands it back to the caller.
+    ; The frame lives on the thread's own kernel stack, so this is safe even if the syscall blocked.
+    mov dword [esp + 28], eax
+
     ; pops the general purpose registers from the stack
     popad
-    mov eax, [tmp_response] ; restores the response of the system call
     iretd
 
 section .data
-; stores the response of the system call
-tmp_response: dd 0
 
 %macro interrupt_array_entry 1
     dd int%1
@@ -1,6 +1,9 @@
 #include "idt.h"
+#include <accounting.h>
+#include <kthread.h>
 #include <pic.h>
 #include <scheduler.h>
+#include <softirq.h>
 #include <string.h>
 #include <x86.h>
 #include "config.h"
@@ -64,20 +67,50 @@ void no_interrupt_handler(const int interrupt, const struct interrupt_frame *fra
 
 void interrupt_handler(const int interrupt, const struct interrupt_frame *frame)
 {
-    if (interrupt_callbacks[interrupt] != nullptr) {
+    auto const thread       = scheduler_get_current_thread();
+    const bool from_user    = frame->cs == USER_CODE_SELECTOR && thread;
+    const bool has_callback = interrupt_callbacks[interrupt] != nullptr;
+    if (from_user) {
+        accounting_enter_kernel(thread);
+    }
+
+    if (has_callback) {
         kernel_page();
         scheduler_save_current_thread(frame);
         interrupt_callbacks[interrupt](interrupt, frame);
-        scheduler_switch_current_thread_page();
     }
 
     // External interrupts are special.
     //   We only handle one at a time (so interrupts must be off)
     //   and they need to be acknowledged on the PIC (see below).
-    //   An external interrupt handler cannot sleep.
+    //   An external interrupt handler cannot sleep, the heavy work is deferred to softirqs and workqueues.
     if (interrupt >= 0x20 && interrupt < 0x30) {
         pic_acknowledge(interrupt);
     }
+
+    // Deferred work and preemption only happen where the interrupted code could have been interrupted anyway,
+    // never on top of an exception raised with interrupts disabled.
+    if (frame->eflags & EFLAGS_IF) {
+        // Exceptions come through trap gates, which leave interrupts enabled
+        cli();
+        softirq_run();
+        scheduler_preempt();
+    }
+
+    // The OOM killer picked the process while it was running, or another thread is tearing it down.
+    // It must not go back to user mode
+    if (from_user && thread->process->killed) {
+        process_exit(thread->process);
+    }
+
+    // Interrupted kernel code (e.g. the idle loop) keeps running with the kernel page directory
+    if (has_callback && frame->cs == USER_CODE_SELECTOR) {
+        scheduler_switch_current_thread_page();
+    }
+
+    if (from_user) {
+        accounting_leave_kernel(thread);
+    }
 }
 
 void idt_set(const int interrupt, const INTERRUPT_HANDLER_FUNCTION handler, const enum interrupt_type type)
@@ -113,6 +146,10 @@ void idt_exception_handler(int interrupt, const struct interrupt_frame *frame)
 {
     // Page fault exception
     if (interrupt == 14) {
+        if (scheduler_get_current_thread()) {
+            accounting_page_fault(scheduler_get_current_thread());
+        }
+
         const uint32_t faulting_address = read_cr2();
         printf(KYEL "\nFaulting address:" KWHT " %#010lx\n", faulting_address);
 
@@ -146,12 +183,28 @@ void idt_exception_handler(int interrupt, const struct interrupt_frame *frame)
 
     debug_stats();
 
+    auto const thread = scheduler_get_current_thread();
+    if (thread && kthread_is_kernel_thread(thread)) {
+        panic("Exception in a kernel thread");
+    }
+
     if (scheduler_get_current_process()) {
         const int pid = scheduler_get_current_process()->pid;
         char name[MAX_PATH_LENGTH];
         strncpy(name, scheduler_get_current_process()->file_name, sizeof(name));
-        process_zombify(scheduler_get_current_process());
+        auto const process = scheduler_get_current_process();
+        cli();
+        process_stop_threads(process);
+        process_zombify(process);
+        if (!process->parent) {
+            process_release(process);
+        }
         printf("The process" KBBLU " %s " KWHT "(%d) has been terminated.\n", name, pid);
+
+        // The thread is gone, there is nothing to return to
+        cli();
+        schedule();
+        panic("Trying to schedule a dead thread");
     }
 
     sti();
@@ -223,9 +276,17 @@ void *syscall_handler(const int syscalll, struct interrupt_frame *frame)
     kernel_page();
     scheduler_save_current_thread(frame);
 
+    auto const thread = scheduler_get_current_thread();
+    accounting_enter_kernel(thread);
+
     void *res = handle_syscall(syscalll, frame);
 
+    if (thread->process->killed) {
+        process_exit(thread->process);
+    }
+
     scheduler_switch_current_thread_page();
+    accounting_leave_kernel(thread);
 
     return res;
 }
\ No newline at end of file
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""Run the bench program headless in QEMU and collect its results.
+
+The kernel is booted with the serial port on stdio. Once the shell is up, the
+command is typed through the QEMU monitor, and every JSON line the bench writes
+to /dev/ttyS0 is collected until it reports "done".
+
+    scripts/bench.py [--image disk.img] [--output bench.jsonl] [--timeout 300] [-- bench arguments]
+"""
+
+import argparse
+import json
+import os
+import select
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+BOOT_MARKER = "Starting the shell"
+EXPECTED = ["calibrate", "null_syscall", "yield_pingpong", "fork_wait", "fork_exec_wait", "sleep_accuracy",
+            "sequential_read", "copy_file", "append", "process_pressure"]
+
+KEYS = {
+    " ": "spc",
+    "-": "minus",
+    "=": "equal",
+    "/": "slash",
+    ".": "dot",
+    "_": "shift-minus",
+    "\n": "ret",
+}
+
+
+def send_keys(monitor_path, text):
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as monitor:
+        monitor.connect(monitor_path)
+        for char in text:
+            key = KEYS.get(char, char)
+            monitor.sendall(f"sendkey {key}\n".encode())
+            time.sleep(0.05)
+        time.sleep(0.2)
+
+
+def wait_for_socket(path, deadline):
+    while time.monotonic() < deadline:
+        if os.path.exists(path):
+            return True
+        time.sleep(0.1)
+    return False
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Run the kernel benchmarks in QEMU")
+    parser.add_argument("--image", default="disk.img")
+    parser.add_argument("--output", default="bench.jsonl")
+    parser.add_argument("--timeout", type=int, default=300, help="seconds for the whole run")
+    parser.add_argument("--qemu", default="qemu-system-i386")
+    parser.add_argument("bench_args", nargs="*", help="extra arguments for the bench program")
+    args = parser.parse_args()
+
+    monitor_path = os.path.join(tempfile.mkdtemp(prefix="bench-"), "monitor.sock")
+    command = [
+        args.qemu,
+        "-drive", f"file={args.image},format=raw",
+        "-m", "64",
+        "-display", "none",
+        "-serial", "stdio",
+        "-monitor", f"unix:{monitor_path},server,nowait",
+    ]
+
+    qemu = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, stdin=subprocess.DEVNULL)
+    deadline = time.monotonic() + args.timeout
+    results = []
+    booted = False
+    done = False
+    buffer = b""
+
+    try:
+        if not wait_for_socket(monitor_path, deadline):
+            print("QEMU monitor did not come up", file=sys.stderr)
+            return 1
+
+        while time.monotonic() < deadline and not done:
+            ready, _, _ = select.select([qemu.stdout], [], [], 0.5)
+            if not ready:
+                if qemu.poll() is not None:
+                    break
+                continue
+
+            chunk = os.read(qemu.stdout.fileno(), 4096)
+            if not chunk:
+                break
+            buffer += chunk
+
+            while b"\n" in buffer:
+                raw, buffer = buffer.split(b"\n", 1)
+                line = raw.decode(errors="replace").strip()
+
+                if not booted and BOOT_MARKER in line:
+                    booted = True
+                    time.sleep(1)
+                    send_keys(monitor_path, " ".join(["bench", "--shutdown"] + args.bench_args) + "\n")
+                    continue
+
+                if not line.startswith("{"):
+                    continue
+                try:
+                    result = json.loads(line)
+                except json.JSONDecodeError:
+                    print(f"Malformed result: {line}", file=sys.stderr)
+                    continue
+
+                if result.get("bench") == "done":
+                    done = True
+                    break
+                if result.get("bench") != "start":
+                    results.append(result)
+    finally:
+        try:
+            qemu.wait(timeout=5)
+        except subprocess.TimeoutExpired:
+            qemu.kill()
+            qemu.wait()
+
+    with open(args.output, "w") as output:
+        for result in results:
+            output.write(json.dumps(result) + "\n")
+
+    selected = [arg for arg in args.bench_args if not arg.startswith("--")]
+    reported = {result.get("bench") for result in results}
+    missing = [name for name in EXPECTED
+               if name not in reported and (not selected or name in selected or name == "calibrate")]
+
+    for result in results:
+        name = result.pop("bench")
+        fields = ", ".join(f"{key}={value}" for key, value in result.items())
+        print(f"{name:18} {fields}")
+
+    if not booted:
+        print("The kernel never reached the shell", file=sys.stderr)
+        return 1
+
+    if not done:
+        print("The bench did not finish", file=sys.stderr)
+    if missing:
+        print(f"Missing results: {', '.join(missing)}", file=sys.stderr)
+
+    return 0 if done and not missing else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
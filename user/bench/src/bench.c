@@ -0,0 +1,501 @@
+#include <config.h>
+#include <diskstat.h>
+#include <memory.h>
+#include <procstat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Scheduler and process lifecycle benchmarks. Every result is printed on the console and written as one JSON object
+// per line to /dev/ttyS0, where scripts/bench.py collects it.
+//
+// Usage: bench [--shutdown] [--pressure=N] [--file=PATH] [benchmark...]
+
+#define REPORT_BUFFER_SIZE 512
+
+#define NULL_SYSCALL_ITERATIONS 20'000
+#define YIELD_ITERATIONS 2'000
+#define FORK_ITERATIONS 50
+#define FORK_EXEC_ITERATIONS 20
+#define PRESSURE_HOLD_MS 10'000
+// Every process costs a full set of page tables and the kernel panics when the heap runs out,
+// so the pressure test stops well short of MAX_PROCESSES unless asked otherwise
+#define PRESSURE_DEFAULT_LIMIT 8
+#define SEQUENTIAL_READ_PASSES 4
+#define SEQUENTIAL_READ_CHUNK (64 * 1024)
+// Written by the copy test, on the root disk
+#define COPY_FILE "/cp.bin"
+// Written by the append test, one small record per write like a log
+#define APPEND_FILE "/append.log"
+#define APPEND_RECORDS 1'000
+#define APPEND_RECORD_SIZE 64
+
+static int serial_fd = -1;
+/// TSC cycles per millisecond, measured against the PIT at startup
+static uint64_t tsc_per_ms;
+static int pressure_limit = PRESSURE_DEFAULT_LIMIT;
+/// Read by the sequential read test, the bench program itself unless asked otherwise
+static const char *read_file = "/bin/bench";
+
+static inline uint64_t rdtsc(void)
+{
+    uint32_t low, high;
+    asm volatile("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+static uint32_t uptime_ms(void)
+{
+    struct cpu_stat cpu;
+    struct thread_stat unused;
+    procstat(&cpu, &unused, 0);
+
+    return cpu.uptime_ms;
+}
+
+static uint64_t cycles_to_ns(const uint64_t cycles)
+{
+    return tsc_per_ms ? cycles * 1'000'000 / tsc_per_ms : 0;
+}
+
+static void report(const char *line)
+{
+    printf("%s\n", line);
+    if (serial_fd >= 0) {
+        write(serial_fd, line, strlen(line));
+        write(serial_fd, "\n", 1);
+    }
+}
+
+/// @brief Report a benchmark that measured an average per operation
+static void report_per_op(const char *name, const uint32_t iterations, const uint64_t cycles)
+{
+    char line[REPORT_BUFFER_SIZE];
+    const uint64_t per_op = iterations ? cycles / iterations : 0;
+    snprintf(line,
+             sizeof(line),
+             "{\"bench\":\"%s\",\"iterations\":%lu,\"cycles_per_op\":%llu,\"ns_per_op\":%llu}",
+             name,
+             iterations,
+             per_op,
+             cycles_to_ns(per_op));
+    report(line);
+}
+
+/// @brief Count TSC cycles over whole PIT ticks to get the TSC frequency
+static void bench_calibrate(void)
+{
+    uint32_t start_ms = uptime_ms();
+    while (uptime_ms() == start_ms) {
+    }
+    start_ms             = uptime_ms();
+    const uint64_t start = rdtsc();
+    while (uptime_ms() - start_ms < 1000) {
+    }
+    const uint64_t cycles  = rdtsc() - start;
+    const uint32_t elapsed = uptime_ms() - start_ms;
+    tsc_per_ms             = cycles / elapsed;
+
+    char line[REPORT_BUFFER_SIZE];
+    snprintf(line, sizeof(line), "{\"bench\":\"calibrate\",\"tsc_per_ms\":%llu}", tsc_per_ms);
+    report(line);
+}
+
+/// @brief Cost of the cheapest syscall
+static void bench_null_syscall(void)
+{
+    const uint64_t start = rdtsc();
+    for (int i = 0; i < NULL_SYSCALL_ITERATIONS; i++) {
+        getpid();
+    }
+    report_per_op("null_syscall", NULL_SYSCALL_ITERATIONS, rdtsc() - start);
+}
+
+/// @brief Parent and child yield to each other, every yield is one context switch
+static void bench_yield_pingpong(void)
+{
+    const int pid = fork();
+    if (pid < 0) {
+        report("{\"bench\":\"yield_pingpong\",\"error\":\"fork failed\"}");
+        return;
+    }
+
+    if (pid == 0) {
+        for (int i = 0; i < YIELD_ITERATIONS; i++) {
+            yield();
+        }
+        exit();
+    }
+
+    const uint64_t start = rdtsc();
+    for (int i = 0; i < YIELD_ITERATIONS; i++) {
+        yield();
+    }
+    waitpid(pid, nullptr);
+    report_per_op("yield_pingpong", YIELD_ITERATIONS * 2, rdtsc() - start);
+}
+
+/// @brief fork() a child that exits right away, and wait for it
+static void bench_fork_wait(void)
+{
+    const uint64_t start = rdtsc();
+    for (int i = 0; i < FORK_ITERATIONS; i++) {
+        const int pid = fork();
+        if (pid < 0) {
+            report("{\"bench\":\"fork_wait\",\"error\":\"fork failed\"}");
+            return;
+        }
+        if (pid == 0) {
+            exit();
+        }
+        waitpid(pid, nullptr);
+    }
+    report_per_op("fork_wait", FORK_ITERATIONS, rdtsc() - start);
+}
+
+/// @brief fork() a child that execs an empty program, and wait for it
+static void bench_fork_exec_wait(void)
+{
+    const uint64_t start = rdtsc();
+    for (int i = 0; i < FORK_EXEC_ITERATIONS; i++) {
+        const int pid = fork();
+        if (pid < 0) {
+            report("{\"bench\":\"fork_exec_wait\",\"error\":\"fork failed\"}");
+            return;
+        }
+        if (pid == 0) {
+            exec("/bin/blank.elf", nullptr);
+            exit();
+        }
+        waitpid(pid, nullptr);
+    }
+    report_per_op("fork_exec_wait", FORK_EXEC_ITERATIONS, rdtsc() - start);
+}
+
+/// @brief How late sleep() wakes up
+static void bench_sleep_accuracy(void)
+{
+    static const uint32_t durations[] = {100, 200, 500, 1000};
+
+    for (size_t i = 0; i < sizeof(durations) / sizeof(durations[0]); i++) {
+        const uint64_t start = rdtsc();
+        sleep(durations[i]);
+        const uint64_t slept_us = (rdtsc() - start) * 1000 / tsc_per_ms;
+
+        char line[REPORT_BUFFER_SIZE];
+        snprintf(line,
+                 sizeof(line),
+                 "{\"bench\":\"sleep_accuracy\",\"requested_ms\":%lu,\"actual_us\":%llu,\"error_us\":%lld}",
+                 durations[i],
+                 slept_us,
+                 (int64_t)slept_us - (int64_t)durations[i] * 1000);
+        report(line);
+    }
+}
+
+/// @brief Fill the process table with sleeping children and see how fork() behaves as it fills up
+static void bench_process_pressure(void)
+{
+    static int children[MAX_PROCESSES];
+    int count                  = 0;
+    uint64_t first_cycles      = 0;
+    uint64_t last_cycles       = 0;
+    const int bucket           = pressure_limit < 10 ? 1 : pressure_limit / 10;
+    const uint64_t total_start = rdtsc();
+
+    while (count < pressure_limit) {
+        const uint64_t start = rdtsc();
+        const int pid        = fork();
+        const uint64_t took  = rdtsc() - start;
+        if (pid < 0) {
+            break;
+        }
+        if (pid == 0) {
+            sleep(PRESSURE_HOLD_MS);
+            exit();
+        }
+
+        children[count++] = pid;
+        if (count <= bucket) {
+            first_cycles += took;
+        }
+        last_cycles = took;
+    }
+    const uint64_t total_cycles = rdtsc() - total_start;
+
+    for (int i = 0; i < count; i++) {
+        waitpid(children[i], nullptr);
+    }
+
+    const uint32_t first = count < bucket ? count : bucket;
+    char line[REPORT_BUFFER_SIZE];
+    snprintf(line,
+             sizeof(line),
+             "{\"bench\":\"process_pressure\",\"limit\":%d,\"created\":%d,\"first_fork_ns\":%llu,"
+             "\"last_fork_ns\":%llu,\"avg_fork_ns\":%llu}",
+             pressure_limit,
+             count,
+             cycles_to_ns(first ? first_cycles / first : 0),
+             cycles_to_ns(last_cycles),
+             cycles_to_ns(count ? total_cycles / count : 0));
+    report(line);
+}
+
+/// @brief Read a whole file from start to end in large chunks, the disk driver moves several sectors per request
+static void bench_sequential_read(void)
+{
+    char line[REPORT_BUFFER_SIZE];
+
+    const int fd = open(read_file, O_RDONLY);
+    if (fd < 0) {
+        snprintf(line, sizeof(line), "{\"bench\":\"sequential_read\",\"error\":\"cannot open %s\"}", read_file);
+        report(line);
+        return;
+    }
+
+    struct stat st;
+    char *buffer = malloc(SEQUENTIAL_READ_CHUNK);
+    if (fstat(fd, &st) < 0 || st.st_size == 0 || !buffer) {
+        report("{\"bench\":\"sequential_read\",\"error\":\"cannot read\"}");
+        goto out;
+    }
+
+    uint64_t bytes       = 0;
+    const uint64_t start = rdtsc();
+    for (int pass = 0; pass < SEQUENTIAL_READ_PASSES; pass++) {
+        lseek(fd, 0, SEEK_SET);
+        uint32_t offset = 0;
+        while (offset < st.st_size) {
+            const uint32_t left  = st.st_size - offset;
+            const uint32_t chunk = left < SEQUENTIAL_READ_CHUNK ? left : SEQUENTIAL_READ_CHUNK;
+            if (read(buffer, chunk, 1, fd) < 0) {
+                report("{\"bench\":\"sequential_read\",\"error\":\"read failed\"}");
+                goto out;
+            }
+            offset += chunk;
+        }
+        bytes += offset;
+    }
+    const uint64_t ns = cycles_to_ns(rdtsc() - start);
+
+    snprintf(line,
+             sizeof(line),
+             "{\"bench\":\"sequential_read\",\"file\":\"%s\",\"bytes\":%llu,\"us\":%llu,\"kib_per_s\":%llu}",
+             read_file,
+             bytes,
+             ns / 1000,
+             ns ? bytes * 1'000'000'000 / 1024 / ns : 0);
+    report(line);
+
+out:
+    if (buffer) {
+        free(buffer);
+    }
+    close(fd);
+}
+
+/// @brief Copy a file the way cp does and count the commands the root disk received for it
+static void bench_copy_file(void)
+{
+    char line[REPORT_BUFFER_SIZE];
+    char *buffer = nullptr;
+    int to       = -1;
+
+    const int from = open(read_file, O_RDONLY);
+    if (from < 0) {
+        snprintf(line, sizeof(line), "{\"bench\":\"copy_file\",\"error\":\"cannot open %s\"}", read_file);
+        report(line);
+        return;
+    }
+
+    struct stat st;
+    if (fstat(from, &st) < 0 || st.st_size == 0 || !(buffer = malloc(st.st_size))) {
+        report("{\"bench\":\"copy_file\",\"error\":\"cannot read\"}");
+        goto out;
+    }
+
+    struct disk_stat before, after;
+    diskstat(0, &before);
+    const uint64_t start = rdtsc();
+
+    uint32_t offset = 0;
+    while (offset < st.st_size) {
+        const uint32_t left  = st.st_size - offset;
+        const uint32_t chunk = left < SEQUENTIAL_READ_CHUNK ? left : SEQUENTIAL_READ_CHUNK;
+        if (read(buffer + offset, chunk, 1, from) < 0) {
+            report("{\"bench\":\"copy_file\",\"error\":\"read failed\"}");
+            goto out;
+        }
+        offset += chunk;
+    }
+
+    to = open(COPY_FILE, O_CREAT | O_WRONLY);
+    if (to < 0) {
+        report("{\"bench\":\"copy_file\",\"error\":\"cannot create\"}");
+        goto out;
+    }
+    offset = 0;
+    while (offset < st.st_size) {
+        const uint32_t left  = st.st_size - offset;
+        const uint32_t chunk = left < SEQUENTIAL_READ_CHUNK ? left : SEQUENTIAL_READ_CHUNK;
+        if (write(to, buffer + offset, chunk) < 0) {
+            report("{\"bench\":\"copy_file\",\"error\":\"write failed\"}");
+            goto out;
+        }
+        offset += chunk;
+    }
+    // The copy is only done once it is on the disk
+    if (fsync(to) < 0) {
+        report("{\"bench\":\"copy_file\",\"error\":\"fsync failed\"}");
+        goto out;
+    }
+
+    const uint64_t ns = cycles_to_ns(rdtsc() - start);
+    diskstat(0, &after);
+
+    snprintf(line,
+             sizeof(line),
+             "{\"bench\":\"copy_file\",\"bytes\":%lu,\"us\":%llu,\"requests\":%lu,\"merged\":%lu,\"commands\":%lu,"
+             "\"flushes\":%lu}",
+             st.st_size,
+             ns / 1000,
+             after.requests - before.requests,
+             after.merged - before.merged,
+             after.commands - before.commands,
+             after.flushes - before.flushes);
+    report(line);
+
+out:
+    if (buffer) {
+        free(buffer);
+    }
+    if (to >= 0) {
+        close(to);
+    }
+    close(from);
+}
+
+static void bench_append(void)
+{
+    char line[REPORT_BUFFER_SIZE];
+    char record[APPEND_RECORD_SIZE];
+
+    const int fd = open(APPEND_FILE, O_CREAT | O_WRONLY);
+    if (fd < 0) {
+        report("{\"bench\":\"append\",\"error\":\"cannot create\"}");
+        return;
+    }
+
+    memset(record, 'a', sizeof(record) - 1);
+    record[sizeof(record) - 1] = '\n';
+
+    struct disk_stat before, after;
+    diskstat(0, &before);
+    const uint64_t start = rdtsc();
+
+    for (int i = 0; i < APPEND_RECORDS; i++) {
+        if (write(fd, record, sizeof(record)) < 0) {
+            report("{\"bench\":\"append\",\"error\":\"write failed\"}");
+            goto out;
+        }
+    }
+    if (fsync(fd) < 0) {
+        report("{\"bench\":\"append\",\"error\":\"fsync failed\"}");
+        goto out;
+    }
+
+    const uint64_t ns = cycles_to_ns(rdtsc() - start);
+    diskstat(0, &after);
+
+    const uint64_t bytes = (uint64_t)APPEND_RECORDS * APPEND_RECORD_SIZE;
+    snprintf(line,
+             sizeof(line),
+             "{\"bench\":\"append\",\"records\":%d,\"bytes\":%llu,\"us\":%llu,\"ns_per_record\":%llu,"
+             "\"kib_per_s\":%llu,\"sectors_written\":%lu}",
+             APPEND_RECORDS,
+             bytes,
+             ns / 1000,
+             ns / APPEND_RECORDS,
+             ns ? bytes * 1'000'000'000 / 1024 / ns : 0,
+             after.sectors_written - before.sectors_written);
+    report(line);
+
+out:
+    close(fd);
+}
+
+struct benchmark {
+    const char *name;
+    void (*function)(void);
+};
+
+// The pressure test goes last, running the kernel out of memory must not cost the other results
+static const struct benchmark benchmarks[] = {
+    {"null_syscall", bench_null_syscall},
+    {"yield_pingpong", bench_yield_pingpong},
+    {"fork_wait", bench_fork_wait},
+    {"fork_exec_wait", bench_fork_exec_wait},
+    {"sleep_accuracy", bench_sleep_accuracy},
+    {"sequential_read", bench_sequential_read},
+    {"copy_file", bench_copy_file},
+    {"append", bench_append},
+    {"process_pressure", bench_process_pressure},
+};
+
+static bool should_run(const char *name, const int argc, char **argv)
+{
+    bool filtered = false;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) == 0) {
+            continue;
+        }
+        filtered = true;
+        if (strncmp(argv[i], name, strlen(name) + 1) == 0) {
+            return true;
+        }
+    }
+
+    return !filtered;
+}
+
+int main(const int argc, char **argv)
+{
+    bool shutdown_when_done = false;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--shutdown", sizeof("--shutdown")) == 0) {
+            shutdown_when_done = true;
+        } else if (strncmp(argv[i], "--pressure=", strlen("--pressure=")) == 0) {
+            pressure_limit = atoi(argv[i] + strlen("--pressure="));
+            if (pressure_limit <= 0 || pressure_limit > MAX_PROCESSES) {
+                pressure_limit = MAX_PROCESSES;
+            }
+        } else if (strncmp(argv[i], "--file=", strlen("--file=")) == 0) {
+            read_file = argv[i] + strlen("--file=");
+        }
+    }
+
+    serial_fd = open("/dev/ttyS0", O_WRONLY);
+    printf("\n");
+
+    report("{\"bench\":\"start\"}");
+    bench_calibrate();
+
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        if (should_run(benchmarks[i].name, argc, argv)) {
+            benchmarks[i].function();
+        }
+    }
+
+    report("{\"bench\":\"done\"}");
+
+    if (serial_fd >= 0) {
+        close(serial_fd);
+    }
+
+    if (shutdown_when_done) {
+        shutdown();
+    }
+
+    return 0;
+}
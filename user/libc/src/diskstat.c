@@ -0,0 +1,7 @@
+#include <diskstat.h>
+#include <syscall.h>
+
+int diskstat(const int disk, struct disk_stat *stat)
+{
+    return syscall2(SYSCALL_DISKSTAT, disk, stat);
+}
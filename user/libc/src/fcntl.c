@@ -0,0 +1,7 @@
+#include <fcntl.h>
+#include <syscall.h>
+
+int posix_fadvise(const int fd, const off_t offset, const off_t length, const int advice)
+{
+    return syscall4(SYSCALL_FADVISE, fd, offset, length, advice);
+}
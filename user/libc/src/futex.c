@@ -0,0 +1,7 @@
+#include <futex.h>
+#include <syscall.h>
+
+int futex(int *address, const int operation, const int value)
+{
+    return syscall3(SYSCALL_FUTEX, address, operation, value);
+}
@@ -0,0 +1,7 @@
+#include <procstat.h>
+#include <syscall.h>
+
+int procstat(struct cpu_stat *cpu, struct thread_stat *threads, const int max)
+{
+    return syscall3(SYSCALL_PROCSTAT, cpu, threads, max);
+}
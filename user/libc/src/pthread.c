@@ -0,0 +1,172 @@
+#include <config.h>
+#include <futex.h>
+#include <pthread.h>
+#include <status.h>
+#include <syscall.h>
+
+// The kernel puts this at the start of every TLS block, %gs points to the block
+struct thread_control_block {
+    void *self;
+    pthread_t tid;
+};
+
+/// @brief Every new thread starts here, with the arguments passed to pthread_create()
+[[noreturn]] static void pthread_start(void *(*start_routine)(void *), void *arg)
+{
+    pthread_exit(start_routine(arg));
+}
+
+int pthread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start_routine)(void *), void *arg)
+{
+    const int tid = syscall3(SYSCALL_THREAD_CREATE, pthread_start, start_routine, arg);
+    if (tid < 0) {
+        return tid;
+    }
+
+    *thread = tid;
+    return 0;
+}
+
+void pthread_exit(void *retval)
+{
+    syscall1(SYSCALL_THREAD_EXIT, retval);
+
+    __builtin_unreachable();
+}
+
+int pthread_join(const pthread_t thread, void **retval)
+{
+    int exit_code = 0;
+    const int res = syscall2(SYSCALL_THREAD_JOIN, thread, &exit_code);
+    if (res == 0 && retval) {
+        *retval = (void *)exit_code;
+    }
+
+    return res;
+}
+
+pthread_t pthread_self(void)
+{
+    pthread_t tid;
+    asm volatile("movl %%gs:%c1, %0" : "=r"(tid) : "i"(offsetof(struct thread_control_block, tid)));
+    return tid;
+}
+
+/// @brief The thread local storage of the calling thread, right after the thread control block
+void *pthread_tls(void)
+{
+    char *self;
+    asm volatile("movl %%gs:%c1, %0" : "=r"(self) : "i"(offsetof(struct thread_control_block, self)));
+    return self + sizeof(struct thread_control_block);
+}
+
+size_t pthread_tls_size(void)
+{
+    return USER_TLS_SIZE - sizeof(struct thread_control_block);
+}
+
+int pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr)
+{
+    mutex->state = 0;
+
+    return 0;
+}
+
+int pthread_mutex_destroy(pthread_mutex_t *mutex)
+{
+    return mutex->state == 0 ? 0 : -EAGAIN;
+}
+
+int pthread_mutex_trylock(pthread_mutex_t *mutex)
+{
+    int expected = 0;
+    if (__atomic_compare_exchange_n(&mutex->state, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    return -EAGAIN;
+}
+
+/// @brief Take the mutex. Only sleeps in the kernel when another thread holds it,
+/// marking it as contended (2) so that the owner knows it has to wake someone on unlock.
+int pthread_mutex_lock(pthread_mutex_t *mutex)
+{
+    int state = 0;
+    if (__atomic_compare_exchange_n(&mutex->state, &state, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    if (state != 2) {
+        state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+    }
+    while (state != 0) {
+        futex(&mutex->state, FUTEX_WAIT, 2);
+        state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+    }
+
+    return 0;
+}
+
+int pthread_mutex_unlock(pthread_mutex_t *mutex)
+{
+    if (__atomic_fetch_sub(&mutex->state, 1, __ATOMIC_RELEASE) != 1) {
+        // Contended, hand the mutex over to one of the sleepers
+        __atomic_store_n(&mutex->state, 0, __ATOMIC_RELEASE);
+        futex(&mutex->state, FUTEX_WAKE, 1);
+    }
+
+    return 0;
+}
+
+int pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr)
+{
+    cond->sequence = 0;
+    cond->waiters  = 0;
+
+    return 0;
+}
+
+int pthread_cond_destroy(pthread_cond_t *cond)
+{
+    return cond->waiters == 0 ? 0 : -EAGAIN;
+}
+
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+    const int sequence = __atomic_load_n(&cond->sequence, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&cond->waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(mutex);
+
+    // A signal between the unlock and the wait changes the sequence, and the wait returns right away
+    futex(&cond->sequence, FUTEX_WAIT, sequence);
+
+    __atomic_fetch_sub(&cond->waiters, 1, __ATOMIC_SEQ_CST);
+    // Other waiters may be woken with us, take the mutex as contended so that they are woken in turn
+    int state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+    while (state != 0) {
+        futex(&mutex->state, FUTEX_WAIT, 2);
+        state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+    }
+
+    return 0;
+}
+
+int pthread_cond_signal(pthread_cond_t *cond)
+{
+    __atomic_fetch_add(&cond->sequence, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&cond->waiters, __ATOMIC_SEQ_CST) > 0) {
+        futex(&cond->sequence, FUTEX_WAKE, 1);
+    }
+
+    return 0;
+}
+
+int pthread_cond_broadcast(pthread_cond_t *cond)
+{
+    __atomic_fetch_add(&cond->sequence, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&cond->waiters, __ATOMIC_SEQ_CST) > 0) {
+        futex(&cond->sequence, FUTEX_WAKE, MAX_THREADS_PER_PROCESS);
+    }
+
+    return 0;
+}
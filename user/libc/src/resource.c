@@ -0,0 +1,12 @@
+#include <resource.h>
+#include <syscall.h>
+
+int getrlimit(const int resource, struct rlimit *limit)
+{
+    return syscall3(SYSCALL_RLIMIT, resource, nullptr, limit);
+}
+
+int setrlimit(const int resource, const struct rlimit *limit)
+{
+    return syscall3(SYSCALL_RLIMIT, resource, limit, nullptr);
+}
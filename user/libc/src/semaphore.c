@@ -0,0 +1,57 @@
+#include <futex.h>
+#include <semaphore.h>
+#include <status.h>
+
+int sem_init(sem_t *sem, int pshared, const unsigned int value)
+{
+    sem->value   = (int)value;
+    sem->waiters = 0;
+
+    return 0;
+}
+
+int sem_destroy(sem_t *sem)
+{
+    return sem->waiters == 0 ? 0 : -EAGAIN;
+}
+
+int sem_trywait(sem_t *sem)
+{
+    int value = __atomic_load_n(&sem->value, __ATOMIC_RELAXED);
+    while (value > 0) {
+        if (__atomic_compare_exchange_n(&sem->value, &value, value - 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return 0;
+        }
+    }
+
+    return -EAGAIN;
+}
+
+int sem_wait(sem_t *sem)
+{
+    while (sem_trywait(sem) != 0) {
+        __atomic_fetch_add(&sem->waiters, 1, __ATOMIC_SEQ_CST);
+        // Fails right away if a post slipped in after the trywait
+        futex(&sem->value, FUTEX_WAIT, 0);
+        __atomic_fetch_sub(&sem->waiters, 1, __ATOMIC_SEQ_CST);
+    }
+
+    return 0;
+}
+
+int sem_post(sem_t *sem)
+{
+    __atomic_fetch_add(&sem->value, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sem->waiters, __ATOMIC_SEQ_CST) > 0) {
+        futex(&sem->value, FUTEX_WAKE, 1);
+    }
+
+    return 0;
+}
+
+int sem_getvalue(sem_t *sem, int *value)
+{
+    *value = __atomic_load_n(&sem->value, __ATOMIC_RELAXED);
+
+    return 0;
+}
@@ -83,6 +83,16 @@ int lseek(int fd, int offset, int whence)
     return syscall3(SYSCALL_LSEEK, fd, offset, whence);
 }
 
+int fsync(int fd)
+{
+    return syscall1(SYSCALL_FSYNC, fd);
+}
+
+void sync(void)
+{
+    syscall0(SYSCALL_SYNC);
+}
+
 
 DIR *opendir(const char *path)
 {
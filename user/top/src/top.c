@@ -0,0 +1,135 @@
+#include <memory.h>
+#include <procstat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_THREADS 128
+#define REFRESH_INTERVAL 1000 // ms
+#define DEFAULT_REFRESHES 10
+
+static struct cpu_stat previous_cpu;
+static struct thread_stat previous[MAX_THREADS];
+static int previous_count;
+
+static struct cpu_stat cpu;
+static struct thread_stat threads[MAX_THREADS];
+
+static const struct thread_stat *find_previous(const struct thread_stat *thread)
+{
+    for (int i = 0; i < previous_count; i++) {
+        if (previous[i].pid == thread->pid && previous[i].tid == thread->tid &&
+            previous[i].kernel_thread == thread->kernel_thread) {
+            return &previous[i];
+        }
+    }
+
+    return nullptr;
+}
+
+/// @brief Share of the elapsed cycles, in tenths of a percent
+static uint32_t permille(const uint64_t cycles, const uint64_t elapsed)
+{
+    if (elapsed == 0) {
+        return 0;
+    }
+
+    return (uint32_t)(cycles * 1000 / elapsed);
+}
+
+static void print_stats(const int count)
+{
+    const uint64_t elapsed = cpu.timestamp - previous_cpu.timestamp;
+    const uint32_t idle    = permille(cpu.idle_cycles - previous_cpu.idle_cycles, elapsed);
+
+    clear_screen();
+    printf("top - up %lu s, %d threads, idle %lu.%lu%%\n\n",
+           cpu.uptime_ms / 1000,
+           cpu.threads,
+           idle / 10,
+           idle % 10);
+    printf(KBBLU " %-5s%-5s%-12s%-3s%-8s%-8s%-7s%-7s%-12s%-5s%-6s\n" KWHT,
+           "PID",
+           "TID",
+           "Name",
+           "S",
+           "%USR",
+           "%SYS",
+           "VCSW",
+           "ICSW",
+           "Avg wakeup",
+           "PF",
+           "KiB");
+
+    for (int i = 0; i < count; i++) {
+        const struct thread_stat *thread = &threads[i];
+        const struct thread_stat *before = find_previous(thread);
+
+        const uint64_t user   = thread->user_cycles - (before ? before->user_cycles : 0);
+        const uint64_t kernel = thread->kernel_cycles - (before ? before->kernel_cycles : 0);
+        const uint32_t usr    = permille(user, elapsed);
+        const uint32_t sys    = permille(kernel, elapsed);
+        const uint64_t wakeup = thread->wakeups ? thread->total_wakeup_latency / thread->wakeups : 0;
+
+        char name[PROCSTAT_NAME_LENGTH + 2];
+        if (thread->kernel_thread) {
+            snprintf(name, sizeof(name), "[%s]", thread->name);
+        } else {
+            // Only the program name, without the path
+            const char *base = thread->name;
+            for (const char *c = thread->name; *c; c++) {
+                if (*c == '/') {
+                    base = c + 1;
+                }
+            }
+            strncpy(name, base, sizeof(name));
+        }
+
+        printf(" %-5d%-5d%-12s%-3c%3lu.%-4lu%3lu.%-4lu%-7lu%-7lu%-12llu%-5lu%-6lu\n",
+               thread->pid,
+               thread->tid,
+               name,
+               thread->state,
+               usr / 10,
+               usr % 10,
+               sys / 10,
+               sys % 10,
+               thread->voluntary_switches,
+               thread->involuntary_switches,
+               wakeup,
+               thread->page_faults,
+               thread->memory / 1024);
+    }
+}
+
+int main(const int argc, char **argv)
+{
+    int refreshes = DEFAULT_REFRESHES;
+    if (argc > 1) {
+        refreshes = atoi(argv[1]);
+    }
+
+    previous_count = procstat(&previous_cpu, previous, MAX_THREADS);
+    if (previous_count < 0) {
+        printf("\nprocstat failed: %d\n", previous_count);
+        return 1;
+    }
+
+    for (int i = 0; i < refreshes; i++) {
+        sleep(REFRESH_INTERVAL);
+
+        const int count = procstat(&cpu, threads, MAX_THREADS);
+        if (count < 0) {
+            printf("\nprocstat failed: %d\n", count);
+            return 1;
+        }
+
+        print_stats(count);
+
+        memcpy(&previous_cpu, &cpu, sizeof(cpu));
+        memcpy(previous, threads, sizeof(struct thread_stat) * count);
+        previous_count = count;
+    }
+
+    return 0;
+}